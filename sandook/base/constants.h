@@ -27,12 +27,33 @@ static_assert(kNameStrLen == kSPDKDeviceSerialNumberLen,
 constexpr static auto kNumMaxServers = 20;
 constexpr static auto kNumMaxVolumes = 16;
 
-constexpr static auto kNumReplicas = 2;
+/* Replication factor of volumes that do not choose one, and the range of the
+ * ones they may choose.
+ */
+constexpr static auto kDefaultNumReplicas = 2;
+constexpr static auto kMinNumReplicas = 1;
+constexpr static auto kMaxNumReplicas = 3;
+static_assert(kMinNumReplicas <= kDefaultNumReplicas &&
+              kDefaultNumReplicas <= kMaxNumReplicas);
 constexpr static size_t kAllocationBatch = 2048;
-static_assert(kAllocationBatch >= kNumReplicas,
+static_assert(kAllocationBatch >= kMaxNumReplicas,
               "Allocation batch size must be at least equal to num replicas");
 constexpr static size_t kDiscardBatch = 2048;
 
+/* Blocks in a stripe of an erasure-coded volume: data blocks and parity blocks
+ * that any kECDataBlocks of can reconstruct the data blocks from.
+ */
+constexpr static auto kECDataBlocks = 4;
+constexpr static auto kECParityBlocks = 2;
+constexpr static auto kECStripeBlocks = kECDataBlocks + kECParityBlocks;
+static_assert(kECStripeBlocks <= kNumMaxServers,
+              "Blocks of a stripe must be at different servers");
+
+/* Most sectors that adjacent writes are batched into, which is also the most
+ * that one write request to a server carries.
+ */
+constexpr static auto kMaxWriteBatchSectors = 32U;
+
 constexpr static auto kSectorShift = 12;
 constexpr static auto kLinuxSectorShift = 9;
 static_assert(kSectorShift >= kLinuxSectorShift,
@@ -40,6 +61,7 @@ static_assert(kSectorShift >= kLinuxSectorShift,
 constexpr static auto kNumLinuxSectorsPerSandookSector =
     1 << (kSectorShift - kLinuxSectorShift);
 constexpr static auto kDeviceAlignment = 1 << kSectorShift;
+constexpr static auto kMiBShift = 20;
 
 constexpr static auto kCacheLineSizeBytes = CACHE_LINE_SIZE;
 constexpr static auto kMaxNumCores = NCPU;
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "sandook/base/error.h"
+
+namespace sandook {
+
+namespace detail {
+
+/* Exponent and logarithm tables of GF(2^8), generated by 2 with the polynomial
+ * x^8 + x^4 + x^3 + x^2 + 1. The exponents are repeated so that the sum of two
+ * logarithms indexes them directly.
+ */
+struct GF256Tables {
+  std::array<uint8_t, 512> exp{};
+  std::array<uint8_t, 256> log{};
+};
+
+constexpr static auto kGF256Polynomial = 0x11d;
+
+constexpr GF256Tables MakeGF256Tables() {
+  GF256Tables tables;
+  unsigned x = 1;
+  for (unsigned i = 0; i < 255; i++) {
+    tables.exp.at(i) = static_cast<uint8_t>(x);
+    tables.exp.at(i + 255) = static_cast<uint8_t>(x);
+    tables.log.at(x) = static_cast<uint8_t>(i);
+    x <<= 1;
+    if (x & 0x100) {
+      x ^= kGF256Polynomial;
+    }
+  }
+  return tables;
+}
+
+inline constexpr GF256Tables kGF256Tables = MakeGF256Tables();
+
+}  // namespace detail
+
+/* Arithmetic in GF(2^8), in which addition is XOR. */
+class GF256 {
+ public:
+  constexpr static uint8_t Mul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) {
+      return 0;
+    }
+    const auto &t = detail::kGF256Tables;
+    return t.exp.at(t.log.at(a) + t.log.at(b));
+  }
+
+  /* Returns the multiplicative inverse of a (which must not be 0). */
+  constexpr static uint8_t Inv(uint8_t a) {
+    const auto &t = detail::kGF256Tables;
+    return t.exp.at(255 - t.log.at(a));
+  }
+
+  /* Adds c times the len bytes at src into the ones at dst.
+   *
+   * With SIMD, the product of each byte is looked up (by shuffles) from the
+   * products of its two nibbles, which take 16 entries each.
+   */
+  static void MulAdd(std::byte *dst, const std::byte *src, uint8_t c,
+                     size_t len) {
+    if (c == 0) {
+      return;
+    }
+
+    size_t i = 0;
+#if defined(__AVX2__)
+    alignas(16) std::array<uint8_t, 16> lo{};
+    alignas(16) std::array<uint8_t, 16> hi{};
+    for (unsigned x = 0; x < 16; x++) {
+      lo.at(x) = Mul(c, static_cast<uint8_t>(x));
+      hi.at(x) = Mul(c, static_cast<uint8_t>(x << 4));
+    }
+    const auto lo_128 = _mm_load_si128(reinterpret_cast<__m128i *>(lo.data()));
+    const auto hi_128 = _mm_load_si128(reinterpret_cast<__m128i *>(hi.data()));
+
+#if defined(__AVX512BW__)
+    const auto lo_512 = _mm512_broadcast_i32x4(lo_128);
+    const auto hi_512 = _mm512_broadcast_i32x4(hi_128);
+    const auto mask_512 = _mm512_set1_epi8(0x0f);
+    for (; i + 64 <= len; i += 64) {
+      const auto s = _mm512_loadu_si512(src + i);
+      const auto s_lo = _mm512_and_si512(s, mask_512);
+      const auto s_hi = _mm512_and_si512(_mm512_srli_epi64(s, 4), mask_512);
+      const auto p = _mm512_xor_si512(_mm512_shuffle_epi8(lo_512, s_lo),
+                                      _mm512_shuffle_epi8(hi_512, s_hi));
+      const auto d = _mm512_loadu_si512(dst + i);
+      _mm512_storeu_si512(dst + i, _mm512_xor_si512(d, p));
+    }
+#endif
+
+    const auto lo_256 = _mm256_broadcastsi128_si256(lo_128);
+    const auto hi_256 = _mm256_broadcastsi128_si256(hi_128);
+    const auto mask_256 = _mm256_set1_epi8(0x0f);
+    for (; i + 32 <= len; i += 32) {
+      const auto s =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+      const auto s_lo = _mm256_and_si256(s, mask_256);
+      const auto s_hi = _mm256_and_si256(_mm256_srli_epi64(s, 4), mask_256);
+      const auto p = _mm256_xor_si256(_mm256_shuffle_epi8(lo_256, s_lo),
+                                      _mm256_shuffle_epi8(hi_256, s_hi));
+      auto *d_ptr = reinterpret_cast<__m256i *>(dst + i);
+      _mm256_storeu_si256(d_ptr,
+                          _mm256_xor_si256(_mm256_loadu_si256(d_ptr), p));
+    }
+#endif
+
+    for (; i < len; i++) {
+      dst[i] ^= static_cast<std::byte>(Mul(c, static_cast<uint8_t>(src[i])));
+    }
+  }
+};
+
+/* Systematic Reed-Solomon code over GF(2^8) of K data blocks and M parity
+ * blocks: the data blocks are stored as they are, and any K of the K + M
+ * blocks of a stripe reconstruct all of them.
+ *
+ * The parity is a Cauchy matrix (1 / (x_r + y_c) for x_r = K + r and y_c = c),
+ * every square submatrix of which is invertible, so the identity on top of it
+ * is a generator matrix of an MDS code.
+ */
+template <size_t K, size_t M>
+class ReedSolomon {
+ public:
+  static_assert(K > 0 && M > 0 && K + M <= 256,
+                "Blocks of a stripe must have distinct GF(2^8) elements");
+
+  constexpr static auto kNumBlocks = K + M;
+
+  using Matrix = std::array<std::array<uint8_t, K>, K>;
+
+  /* Computes the parity blocks of the data blocks (each of len bytes). */
+  static void Encode(std::span<const std::byte *const, K> data,
+                     std::span<std::byte *const, M> parity, size_t len) {
+    for (size_t r = 0; r < M; r++) {
+      std::memset(parity[r], 0, len);
+      for (size_t c = 0; c < K; c++) {
+        GF256::MulAdd(parity[r], data[c], kParity.at(r).at(c), len);
+      }
+    }
+  }
+
+  /* Reconstructs the data block idx into out (of len bytes) from the blocks of
+   * its stripe (the data blocks followed by the parity blocks), of which the
+   * missing ones are nullptr. Fails if fewer than K blocks are present.
+   */
+  static Status<void> Reconstruct(
+      std::span<const std::byte *const, kNumBlocks> blocks, size_t idx,
+      std::byte *out, size_t len) {
+    if (idx >= K) {
+      return MakeError(EINVAL);
+    }
+    if (blocks[idx] != nullptr) {
+      std::memcpy(out, blocks[idx], len);
+      return {};
+    }
+
+    /* The first K blocks present, and the rows of the generator matrix that
+     * produced them.
+     */
+    std::array<size_t, K> present{};
+    size_t n_present = 0;
+    for (size_t i = 0; i < kNumBlocks && n_present < K; i++) {
+      if (blocks[i] != nullptr) {
+        present.at(n_present++) = i;
+      }
+    }
+    if (n_present < K) {
+      return MakeError(EINVAL);
+    }
+
+    Matrix rows{};
+    for (size_t i = 0; i < K; i++) {
+      const auto b = present.at(i);
+      if (b < K) {
+        rows.at(i).at(b) = 1;
+      } else {
+        rows.at(i) = kParity.at(b - K);
+      }
+    }
+
+    /* The data is the inverse of those rows applied to the blocks present. */
+    const auto inverse = Invert(rows);
+    std::memset(out, 0, len);
+    for (size_t i = 0; i < K; i++) {
+      GF256::MulAdd(out, blocks[present.at(i)], inverse.at(idx).at(i), len);
+    }
+    return {};
+  }
+
+ private:
+  constexpr static auto kParity = [] {
+    std::array<std::array<uint8_t, K>, M> parity{};
+    for (size_t r = 0; r < M; r++) {
+      for (size_t c = 0; c < K; c++) {
+        parity.at(r).at(c) = GF256::Inv(static_cast<uint8_t>((K + r) ^ c));
+      }
+    }
+    return parity;
+  }();
+
+  /* Gauss-Jordan elimination; the matrix must be invertible. */
+  static Matrix Invert(Matrix m) {
+    Matrix inv{};
+    for (size_t i = 0; i < K; i++) {
+      inv.at(i).at(i) = 1;
+    }
+
+    for (size_t col = 0; col < K; col++) {
+      size_t pivot = col;
+      while (m.at(pivot).at(col) == 0) {
+        pivot++;
+      }
+      std::swap(m.at(pivot), m.at(col));
+      std::swap(inv.at(pivot), inv.at(col));
+
+      const auto scale = GF256::Inv(m.at(col).at(col));
+      for (size_t j = 0; j < K; j++) {
+        m.at(col).at(j) = GF256::Mul(m.at(col).at(j), scale);
+        inv.at(col).at(j) = GF256::Mul(inv.at(col).at(j), scale);
+      }
+
+      for (size_t row = 0; row < K; row++) {
+        const auto factor = m.at(row).at(col);
+        if (row == col || factor == 0) {
+          continue;
+        }
+        for (size_t j = 0; j < K; j++) {
+          m.at(row).at(j) ^= GF256::Mul(factor, m.at(col).at(j));
+          inv.at(row).at(j) ^= GF256::Mul(factor, inv.at(col).at(j));
+        }
+      }
+    }
+    return inv;
+  }
+};
+
+}  // namespace sandook
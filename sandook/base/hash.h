@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 
 namespace sandook {
@@ -10,6 +11,15 @@ inline size_t Hash(uint64_t var1, uint64_t var2) {
   return std::hash<uint64_t>{}(var1 ^ var2);
 }
 
+/* Scrambles the bits of a 64 bit variable (the finalizer of splitmix64), so
+ * that nearby values map to unrelated ones.
+ */
+inline uint64_t Mix(uint64_t var) {
+  var = (var ^ (var >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  var = (var ^ (var >> 27)) * 0x94d049bb133111ebULL;
+  return var ^ (var >> 31);
+}
+
 /* Hashes a 128 bit variable by dividing it into the two 64 bit halves.
  */
 inline size_t Hash(__uint128_t var) {
@@ -0,0 +1,86 @@
+#include "sandook/base/histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "sandook/bindings/sync.h"
+
+namespace sandook {
+
+LatencyHistogram::LatencyHistogram() {
+  for (auto &core : cores_) {
+    core.buckets.fill(0);
+  }
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t value) {
+  value = std::min(value, kMaxValue);
+  if (value < kSubBuckets) {
+    return value;
+  }
+
+  const auto shift =
+      static_cast<size_t>(std::bit_width(value)) - 1 - kSubBucketBits;
+  return ((shift + 1) << kSubBucketBits) + ((value >> shift) - kSubBuckets);
+}
+
+uint64_t LatencyHistogram::GetBucketValue(size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+
+  /* Midpoint of the bucket. */
+  const auto shift = (bucket >> kSubBucketBits) - 1;
+  const auto sub_bucket = bucket & (kSubBuckets - 1);
+  const auto low = (kSubBuckets + sub_bucket) << shift;
+  return low + ((1UL << shift) >> 1);
+}
+
+void LatencyHistogram::Record(uint64_t value) {
+  rt::Preempt p;
+  rt::PreemptGuard g(p);
+
+  cores_[p.get_cpu()].buckets[GetBucket(value)]++;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Collect() {
+  Snapshot snapshot;
+
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    uint64_t total = 0;
+    for (const auto &core : cores_) {
+      total += core.buckets[i];
+    }
+
+    snapshot.buckets_[i] = total - collected_[i];
+    snapshot.count_ += snapshot.buckets_[i];
+    collected_[i] = total;
+  }
+
+  return snapshot;
+}
+
+uint64_t LatencyHistogram::Snapshot::Quantile(double q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  /* Rank (1-indexed) of the sample at quantile q. */
+  const auto rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count_))));
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      return GetBucketValue(i);
+    }
+  }
+
+  return GetBucketValue(kNumBuckets - 1);
+}
+
+}  // namespace sandook
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "sandook/base/constants.h"
+
+namespace sandook {
+
+/* Fixed-size log-linear (HDR-style) histogram of latencies in microseconds.
+ *
+ * Values below 2^kSubBucketBits are recorded exactly; above that, every power
+ * of two is split into 2^kSubBucketBits equal-width buckets, which bounds the
+ * relative error of a quantile to 2^-kSubBucketBits. Values of at least
+ * 2^kMaxValueBits are clamped into the last bucket.
+ *
+ * Samples are recorded into per-core buckets without any synchronization.
+ * Collect() merges them into a snapshot of the samples recorded since its
+ * previous call; it must not be called concurrently with itself.
+ */
+class LatencyHistogram {
+ public:
+  constexpr static auto kSubBucketBits = 4;
+  constexpr static auto kSubBuckets = 1UZ << kSubBucketBits;
+  constexpr static auto kMaxValueBits = 24;
+  constexpr static auto kNumBuckets =
+      (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+  constexpr static uint64_t kMaxValue = (1UL << kMaxValueBits) - 1;
+
+  class Snapshot {
+   public:
+    [[nodiscard]] uint64_t count() const { return count_; }
+
+    /* Returns the (approximate) value at quantile q (in [0, 1]). */
+    [[nodiscard]] uint64_t Quantile(double q) const;
+
+   private:
+    friend class LatencyHistogram;
+
+    std::array<uint64_t, kNumBuckets> buckets_{};
+    uint64_t count_{0};
+  };
+
+  LatencyHistogram();
+
+  void Record(uint64_t value);
+
+  /* Merges the per-core histograms into a snapshot of the samples that were
+   * recorded since the last call.
+   */
+  Snapshot Collect();
+
+  [[nodiscard]] static size_t GetBucket(uint64_t value);
+  [[nodiscard]] static uint64_t GetBucketValue(size_t bucket);
+
+ private:
+  struct alignas(kCacheLineSizeBytes) {
+    std::array<uint64_t, kNumBuckets> buckets;
+  } cores_[kMaxNumCores];
+
+  /* Running totals as of the last call to Collect(). */
+  std::array<uint64_t, kNumBuckets> collected_{};
+};
+
+}  // namespace sandook
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+
+namespace sandook {
+
+/* A vector of at most N elements that are stored inline (without allocating),
+ * for small lists whose size is only known at runtime.
+ */
+template <typename T, size_t N>
+class InlineVector {
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  InlineVector() = default;
+
+  explicit InlineVector(size_t n, const T &value = T{}) : size_(n) {
+    assert(n <= N);
+    std::fill_n(items_.begin(), n, value);
+  }
+
+  InlineVector(std::initializer_list<T> items) : size_(items.size()) {
+    assert(items.size() <= N);
+    std::ranges::copy(items, items_.begin());
+  }
+
+  [[nodiscard]] constexpr static size_t capacity() { return N; }
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  T *data() { return items_.data(); }
+  [[nodiscard]] const T *data() const { return items_.data(); }
+
+  iterator begin() { return items_.data(); }
+  iterator end() { return items_.data() + size_; }
+  [[nodiscard]] const_iterator begin() const { return items_.data(); }
+  [[nodiscard]] const_iterator end() const { return items_.data() + size_; }
+
+  T &operator[](size_t i) { return items_[i]; }
+  const T &operator[](size_t i) const { return items_[i]; }
+
+  T &at(size_t i) {
+    if (i >= size_) {
+      throw std::out_of_range("InlineVector index out of range");
+    }
+    return items_[i];
+  }
+  [[nodiscard]] const T &at(size_t i) const {
+    if (i >= size_) {
+      throw std::out_of_range("InlineVector index out of range");
+    }
+    return items_[i];
+  }
+
+  T &front() { return at(0); }
+  [[nodiscard]] const T &front() const { return at(0); }
+
+  void push_back(const T &item) {
+    assert(size_ < N);
+    items_[size_++] = item;
+  }
+
+  void resize(size_t n, const T &value = T{}) {
+    assert(n <= N);
+    if (n > size_) {
+      std::fill(items_.begin() + size_, items_.begin() + n, value);
+    }
+    size_ = n;
+  }
+
+  void clear() { size_ = 0; }
+
+  friend bool operator==(const InlineVector &a, const InlineVector &b) {
+    return std::ranges::equal(a, b);
+  }
+
+ private:
+  std::array<T, N> items_{};
+  size_t size_{0};
+};
+
+}  // namespace sandook
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+namespace sandook {
+
+/* Label of a rack or failure domain that is not known. */
+constexpr static uint32_t kUnknownLocation = 0;
+
+/* Where a server or virtual disk sits in the network. */
+struct Location {
+  /* Rack, i.e., the ToR switch that it is behind (unique across domains). */
+  uint32_t rack;
+
+  /* Failure domain (e.g., power or spine) that the rack belongs to. */
+  uint32_t failure_domain;
+} __attribute__((aligned(4)));
+
+static_assert(std::is_standard_layout_v<Location> &&
+              std::is_trivial_v<Location>);
+
+/* Relative cost of moving data between two locations. What is not known about
+ * the locations is taken to cost nothing, so that it does not bias placements.
+ */
+enum NetworkCost {
+  kSameRack = 0,
+  kSameFailureDomain = 1,
+  kCrossFailureDomain = 2
+};
+
+inline NetworkCost GetNetworkCost(const Location &a, const Location &b) {
+  const bool is_rack_known =
+      a.rack != kUnknownLocation && b.rack != kUnknownLocation;
+  if (is_rack_known && a.rack == b.rack) {
+    return NetworkCost::kSameRack;
+  }
+  if (a.failure_domain != kUnknownLocation &&
+      b.failure_domain != kUnknownLocation) {
+    return (a.failure_domain == b.failure_domain)
+               ? NetworkCost::kSameFailureDomain
+               : NetworkCost::kCrossFailureDomain;
+  }
+  return is_rack_known ? NetworkCost::kSameFailureDomain
+                       : NetworkCost::kSameRack;
+}
+
+/* Returns true if the locations are known to be in the same rack. */
+inline bool IsSameRack(const Location &a, const Location &b) {
+  return a.rack != kUnknownLocation && a.rack == b.rack;
+}
+
+/* Returns true if the locations are known to be in the same failure domain,
+ * which they are if they are in the same rack.
+ */
+inline bool IsSameFailureDomain(const Location &a, const Location &b) {
+  return IsSameRack(a, b) || (a.failure_domain != kUnknownLocation &&
+                              a.failure_domain == b.failure_domain);
+}
+
+}  // namespace sandook
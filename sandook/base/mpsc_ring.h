@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "sandook/base/constants.h"
+
+namespace sandook {
+
+/* Bounded lock-free queue of N items that many threads push to and a single
+ * thread pops from.
+ *
+ * Each slot has a sequence number that tells whose turn it is: a producer may
+ * fill the slot of position pos once it is pos, and the consumer may take the
+ * item once it is pos + 1 (after which it is pos + N, for the next lap).
+ */
+template <typename T, size_t N>
+class MPSCRing {
+ public:
+  static_assert(std::has_single_bit(N), "Capacity must be a power of two");
+
+  MPSCRing() : slots_(std::make_unique<Slot[]>(N)) {
+    for (size_t i = 0; i < N; i++) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+  ~MPSCRing() = default;
+
+  /* No copying. */
+  MPSCRing(const MPSCRing &) = delete;
+  MPSCRing &operator=(const MPSCRing &) = delete;
+
+  /* No moving. */
+  MPSCRing(MPSCRing &&) = delete;
+  MPSCRing &operator=(MPSCRing &&) = delete;
+
+  [[nodiscard]] constexpr static size_t capacity() { return N; }
+
+  /* Pushes the item, or returns false if the ring is full. */
+  bool TryPush(const T &item) {
+    auto pos = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      auto &slot = slots_[pos & (N - 1)];
+      const auto seq = slot.seq.load(std::memory_order_acquire);
+      const auto diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          slot.item = item;
+          slot.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /* Pops up to items.size() items into items and returns how many it popped.
+   * Only the consumer may call this.
+   */
+  size_t PopBatch(std::span<T> items) {
+    size_t n = 0;
+    while (n < items.size()) {
+      auto &slot = slots_[head_ & (N - 1)];
+      if (slot.seq.load(std::memory_order_acquire) != head_ + 1) {
+        break;
+      }
+      items[n++] = slot.item;
+      slot.seq.store(head_ + N, std::memory_order_release);
+      head_++;
+    }
+    return n;
+  }
+
+  /* Returns true if there is no item to pop yet (pushes that are in progress
+   * do not count). Only the consumer may call this.
+   */
+  [[nodiscard]] bool empty() const {
+    const auto &slot = slots_[head_ & (N - 1)];
+    return slot.seq.load(std::memory_order_acquire) != head_ + 1;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> seq;
+    T item;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  /* Next position to push to. */
+  alignas(kCacheLineSizeBytes) std::atomic<size_t> tail_{0};
+  /* Next position to pop from. */
+  alignas(kCacheLineSizeBytes) size_t head_{0};
+};
+
+}  // namespace sandook
@@ -11,6 +11,8 @@
 
 #include "sandook/base/constants.h"
 #include "sandook/base/io_desc.h"
+#include "sandook/base/location.h"
+#include "sandook/base/qos.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/config/config.h"
@@ -55,6 +57,7 @@ struct ServerInfo {
   int port;
   char name[kNameStrLen];
   uint32_t id;
+  Location location;
 } __attribute__((aligned(4)));
 
 static_assert(std::is_standard_layout_v<ServerInfo> &&
@@ -244,6 +247,9 @@ struct RegisterServerMsg {
 
   /* Number of sectors available at this storage server. */
   uint64_t nsectors;
+
+  /* Rack and failure domain of this storage server. */
+  Location location;
 } __attribute__((aligned(4)));
 
 static_assert(std::is_standard_layout_v<RegisterServerMsg> &&
@@ -251,7 +257,7 @@ static_assert(std::is_standard_layout_v<RegisterServerMsg> &&
 
 inline std::unique_ptr<std::byte[]> CreateRegisterServerMsg(
     const std::string &ip, int port, const std::string &name,
-    uint64_t nsectors) {
+    uint64_t nsectors, Location location = {}) {
   assert(name.size() <= kNameStrLen);
   assert(ip.size() <= kIPAddrStrLen);
   auto response_size = sizeof(MsgHeader) + sizeof(RegisterServerMsg);
@@ -266,6 +272,7 @@ inline std::unique_ptr<std::byte[]> CreateRegisterServerMsg(
       reinterpret_cast<RegisterServerMsg *>(buffer.get() + sizeof(MsgHeader));
   msg->port = port;
   msg->nsectors = nsectors;
+  msg->location = location;
   void *msg_name = static_cast<void *>(msg->name);
   memset(msg_name, '\0', kNameStrLen);
   std::strncpy(static_cast<char *>(msg->ip), ip.c_str(), ip.size());
@@ -314,13 +321,25 @@ struct RegisterVolumeMsg {
 
   /* Number of sectors in the volume. */
   uint64_t nsectors;
+
+  /* QoS class of the volume. */
+  VolumeQoS qos;
+
+  /* Number of servers that each block of the volume is replicated on. */
+  uint32_t num_replicas;
+
+  /* Whether whole stripes of the volume are erasure-coded. */
+  bool is_erasure_coded;
 } __attribute__((aligned(4)));
 
 static_assert(std::is_standard_layout_v<RegisterVolumeMsg> &&
               std::is_trivial_v<RegisterVolumeMsg>);
 
 inline std::unique_ptr<std::byte[]> CreateRegisterVolumeMsg(
-    const std::string &ip, int port, uint64_t nsectors) {
+    const std::string &ip, int port, uint64_t nsectors,
+    VolumeQoS qos = {.reservation = 0, .limit = 0, .weight = 1},
+    uint32_t num_replicas = kDefaultNumReplicas,
+    bool is_erasure_coded = false) {
   assert(ip.size() <= kIPAddrStrLen);
   auto payload_size = sizeof(MsgHeader) + sizeof(RegisterVolumeMsg);
   auto buffer = std::make_unique_for_overwrite<std::byte[]>(payload_size);
@@ -334,6 +353,9 @@ inline std::unique_ptr<std::byte[]> CreateRegisterVolumeMsg(
       reinterpret_cast<RegisterVolumeMsg *>(buffer.get() + sizeof(MsgHeader));
   msg->port = port;
   msg->nsectors = nsectors;
+  msg->qos = qos;
+  msg->num_replicas = num_replicas;
+  msg->is_erasure_coded = is_erasure_coded;
   std::strncpy(static_cast<char *>(msg->ip), ip.c_str(), ip.size());
 
   return buffer;
@@ -482,12 +504,20 @@ inline std::unique_ptr<std::byte[]> CreateCommitServerModeMsg(
 struct GetServerStatsMsg {
   /* Volume ID that made this request. */
   VolumeID vol_id;
+
+  /* QoS tokens requested by the volume so far. */
+  uint64_t qos_demand;
+
+  /* Ops sent by the volume so far to each server. */
+  ServerOps server_ops;
 } __attribute__((aligned(4)));
 
 static_assert(std::is_standard_layout_v<GetServerStatsMsg> &&
               std::is_trivial_v<GetServerStatsMsg>);
 
-inline std::unique_ptr<std::byte[]> CreateGetServerStatsMsg(VolumeID vol_id) {
+inline std::unique_ptr<std::byte[]> CreateGetServerStatsMsg(
+    VolumeID vol_id, uint64_t qos_demand = 0,
+    const ServerOps &server_ops = {}) {
   auto response_size = sizeof(MsgHeader) + sizeof(GetServerStatsMsg);
   auto buffer = std::make_unique_for_overwrite<std::byte[]>(response_size);
 
@@ -499,6 +529,8 @@ inline std::unique_ptr<std::byte[]> CreateGetServerStatsMsg(VolumeID vol_id) {
   auto *msg =
       reinterpret_cast<GetServerStatsMsg *>(buffer.get() + sizeof(MsgHeader));
   msg->vol_id = vol_id;
+  msg->qos_demand = qos_demand;
+  msg->server_ops = server_ops;
 
   return buffer;
 }
@@ -510,6 +542,14 @@ struct GetServerStatsReplyMsg {
   /* Number of servers whose information is sent in 'servers'. */
   int num_servers;
   std::array<ServerStats, kNumMaxServers> servers;
+
+  /* Rate allocated to the QoS class of the volume (0 if unlimited). */
+  uint64_t qos_rate;
+
+  /* Rate limits allocated to the volume at congested servers (0 if the volume
+   * is to use its own congestion control).
+   */
+  ServerRateLimits cc_rate_limits;
 } __attribute__((aligned(4)));
 
 static_assert(std::is_standard_layout_v<GetServerStatsReplyMsg> &&
@@ -521,7 +561,8 @@ inline void AddServerStats(GetServerStatsReplyMsg *msg, ServerStats stats) {
 }
 
 inline std::unique_ptr<std::byte[]> CreateGetServerStatsReplyMsg(
-    VolumeID vol_id) {
+    VolumeID vol_id, uint64_t qos_rate,
+    const ServerRateLimits &cc_rate_limits) {
   auto response_size = sizeof(MsgHeader) + sizeof(GetServerStatsReplyMsg);
   auto buffer = std::make_unique_for_overwrite<std::byte[]>(response_size);
 
@@ -534,6 +575,8 @@ inline std::unique_ptr<std::byte[]> CreateGetServerStatsReplyMsg(
                                                          sizeof(MsgHeader));
   msg->num_servers = 0;
   msg->vol_id = vol_id;
+  msg->qos_rate = qos_rate;
+  msg->cc_rate_limits = cc_rate_limits;
 
   return buffer;
 }
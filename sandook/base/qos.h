@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/io_desc.h"
+
+namespace sandook {
+
+/* QoS class of a volume.
+ *
+ * Rates are in sectors per second, i.e., IOPS of single-sector reads, so that
+ * both the IOPS and the bandwidth of a volume are accounted for (see
+ * GetQoSCost).
+ */
+struct VolumeQoS {
+  /* Rate guaranteed to the volume (0 if none). */
+  uint64_t reservation;
+
+  /* Maximum rate of the volume (0 if unlimited). */
+  uint64_t limit;
+
+  /* Share of the capacity left over after the reservations. */
+  uint64_t weight;
+} __attribute__((aligned(4)));
+
+static_assert(std::is_standard_layout_v<VolumeQoS> &&
+              std::is_trivial_v<VolumeQoS>);
+
+/* Capacity of one disk server in units of the QoS rates. */
+constexpr static auto kQoSCapacityPerSSD =
+    static_cast<uint64_t>(kPeakReadIOPSPerSSD);
+
+/* A write occupies every server it goes to (e.g., each replica), each of which
+ * sustains fewer writes than reads.
+ */
+constexpr uint64_t GetQoSWriteCost(uint64_t num_servers) {
+  return static_cast<uint64_t>(num_servers * kPeakReadIOPSPerSSD /
+                               kPeakWriteIOPSPerSSD);
+}
+
+/* Returns the number of tokens a request takes from the rate of its volume,
+ * whose writes go to num_replicas servers. Writes of an erasure-coded volume
+ * go to kECStripeBlocks servers per kECDataBlocks sectors instead, except for
+ * the sectors that do not fill a stripe, which are replicated.
+ */
+inline uint64_t GetQoSCost(OpType op, uint64_t num_sectors,
+                           uint64_t num_replicas = kDefaultNumReplicas,
+                           bool is_erasure_coded = false) {
+  if (op != OpType::kWrite) {
+    return num_sectors;
+  }
+  if (!is_erasure_coded) {
+    return num_sectors * GetQoSWriteCost(num_replicas);
+  }
+
+  const auto num_stripes = num_sectors / kECDataBlocks;
+  const auto num_replicated = num_sectors % kECDataBlocks;
+  return (num_stripes * GetQoSWriteCost(kECStripeBlocks)) +
+         (num_replicated * GetQoSWriteCost(num_replicas));
+}
+
+}  // namespace sandook
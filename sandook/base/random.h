@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#include "sandook/base/constants.h"
+#include "sandook/bindings/sync.h"
+
+namespace sandook {
+
+/* A small and fast (non-cryptographic) random number generator (wyrand),
+ * which meets the requirements of UniformRandomBitGenerator.
+ */
+class WyRand {
+ public:
+  using result_type = uint64_t;
+
+  explicit WyRand(uint64_t seed = 0) : state_(seed) {}
+
+  constexpr static result_type min() { return 0; }
+  constexpr static result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()() {
+    state_ += 0xa0761d6478bd642fULL;
+    const auto t = static_cast<unsigned __int128>(state_) *
+                   (state_ ^ 0xe7037ed1a0b428dbULL);
+    return static_cast<result_type>(t >> 64) ^ static_cast<result_type>(t);
+  }
+
+ private:
+  uint64_t state_;
+};
+
+/* Random number generators, one per core, so that threads on different cores
+ * neither race on nor share the cache line of a generator.
+ */
+class CoreLocalRandom {
+ public:
+  CoreLocalRandom() {
+    std::random_device rand_dev;
+    for (auto &gen : gens_) {
+      gen.g = WyRand((static_cast<uint64_t>(rand_dev()) << 32) | rand_dev());
+    }
+  }
+
+  /* Calls fn with the generator of the current core. */
+  template <typename F>
+  auto Apply(F fn) {
+    rt::Preempt p;
+    rt::PreemptGuard g(p);
+
+    return fn(gens_[p.get_cpu()].g);
+  }
+
+  /* Returns a uniform number in [0, 1). */
+  double Uniform() {
+    return Apply([](WyRand &gen) {
+      /* The top 53 bits fill the mantissa of a double. */
+      constexpr static auto kScale = 1.0 / (1ULL << 53);
+      return static_cast<double>(gen() >> 11) * kScale;
+    });
+  }
+
+  /* Returns a uniform integer in [0, n). */
+  uint64_t Below(uint64_t n) {
+    return Apply([n](WyRand &gen) {
+      return static_cast<uint64_t>(
+          (static_cast<unsigned __int128>(gen()) * n) >> 64);
+    });
+  }
+
+ private:
+  struct alignas(kCacheLineSizeBytes) {
+    WyRand g;
+  } gens_[kMaxNumCores];
+};
+
+}  // namespace sandook
@@ -38,6 +38,12 @@ struct ServerStats {
   uint64_t signal_write_latency;
   bool is_rejecting_requests;
   ServerCongestionState congestion_state;
+  /* Fraction of the disk that is allocated (set by the controller). */
+  double fill_level;
+  /* Bytes written since the disk last recovered in read mode (maintained by
+   * the controller).
+   */
+  uint64_t write_debt;
 
   friend std::ostream& operator<<(std::ostream& out, const ServerStats& p) {
     out << "server_id: " << p.server_id << '\n'
@@ -60,7 +66,9 @@ struct ServerStats {
         << "signal_read_latency: " << p.signal_read_latency << '\n'
         << "signal_write_latency: " << p.signal_write_latency << '\n'
         << "is_rejecting_requests: " << p.is_rejecting_requests << '\n'
-        << "congestion_state: " << p.congestion_state << '\n';
+        << "congestion_state: " << p.congestion_state << '\n'
+        << "fill_level: " << p.fill_level << '\n'
+        << "write_debt: " << p.write_debt << '\n';
     return out;
   }
 };
@@ -74,6 +82,11 @@ constexpr static auto kInvalidServerWeight =
 using ServerModes = std::array<ServerMode, kNumMaxServers>;
 using ServerWeights = std::array<ServerWeight, kNumMaxServers>;
 using ServerSignals = std::array<ServerSignal, kNumMaxServers>;
+/* Ops sent by a volume to each server, and their rate (per second). */
+using ServerOps = std::array<uint64_t, kNumMaxServers>;
+using ServerDemands = std::array<double, kNumMaxServers>;
+/* Rate limit of a volume at each server (0 if there is none). */
+using ServerRateLimits = std::array<RateLimit, kNumMaxServers>;
 
 /* Order: mode, congestion_state, read weight, write weight. */
 using DataPlaneServerStats =
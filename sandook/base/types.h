@@ -7,6 +7,7 @@
 #include <tuple>
 
 #include "sandook/base/constants.h"
+#include "sandook/base/inline_vector.h"
 
 namespace sandook {
 
@@ -40,12 +41,13 @@ using ServerAllocationList = std::array<ServerID, kAllocationBatch>;
 using ServerAllocationBlockInfoList =
     std::array<ServerBlockInfo, kAllocationBatch>;
 
-using ServerReplicaList = std::array<ServerID, kNumReplicas>;
+/* One entry per replica, as many as the replication factor of the volume. */
+using ServerReplicaList = InlineVector<ServerID, kMaxNumReplicas>;
 
 /* bool represent dirty bit. */
 using ServerReplicaBlockInfo = std::pair<ServerBlockInfo, bool>;
 using ServerReplicaBlockInfoList =
-    std::array<ServerReplicaBlockInfo, kNumReplicas>;
+    InlineVector<ServerReplicaBlockInfo, kMaxNumReplicas>;
 
 /* IsTraffic, <NumReadServers, NumWriteServers>
  * The first element is a bool which is true if there is any traffic in the
@@ -14,9 +14,15 @@ extern "C" {
 
 namespace sandook::rt {
 
+// A contiguous range of storage blocks.
+using StorageRange = storage_range;
+
 // TODO(zainruan): this should be per-device.
 class Storage {
  public:
+  // Maximum number of ranges that can be deallocated with one command.
+  static constexpr size_t kMaxDeallocateRanges = STORAGE_MAX_DEALLOCATE_RANGES;
+
   // Write contiguous storage blocks.
   static Status<void> Write(std::span<const std::byte> src,
                             uint64_t start_lba) {
@@ -47,6 +53,15 @@ class Storage {
     return {};
   }
 
+  // Discard multiple ranges of storage blocks with a single command.
+  static Status<void> Deallocate(std::span<const StorageRange> ranges) {
+    auto ret = storage_deallocate_ranges(ranges.data(), ranges.size());
+    if (ret != 0) {
+      return MakeError(-ret);
+    }
+    return {};
+  }
+
   // Returns the size of each block.
   static uint32_t get_block_size() { return storage_block_size(); }
 
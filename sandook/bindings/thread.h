@@ -73,6 +73,9 @@ void Spawn(Callable&& func, Args&&... args)
   thread_ready(th);
 }
 
+// Called from a running thread to let other threads run.
+inline void Yield() { thread_yield(); }
+
 // A RAII thread object, similar to a std::jthread.
 class Thread {
  public:
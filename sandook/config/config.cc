@@ -3,6 +3,8 @@
 #include <jsoncpp/json/json.h>  // NOLINT
 #include <jsoncpp/json/value.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
@@ -12,6 +14,8 @@
 #include <string>
 
 #include "sandook/base/constants.h"
+#include "sandook/base/location.h"
+#include "sandook/base/qos.h"
 #include "sandook/base/types.h"
 
 namespace sandook {
@@ -44,6 +48,8 @@ const Config::VirtualDiskType Config::kVirtualDiskType = [](auto &root) {
   }
   throw std::runtime_error("Unknown virtual disk type");
 }(root);
+const uint32_t Config::kVirtualDiskWriteBatchWindowUs =
+    root["kVirtualDiskWriteBatchWindowUs"].asUInt();
 const std::string Config::kVirtualDiskIP =
     Config::kVirtualDiskType == Config::VirtualDiskType::kRemote
         ? root["kVirtualDiskIP"].asString()
@@ -62,6 +68,43 @@ const ServerID Config::kVirtualDiskServerAffinity =
             return affinity;
           }(root)
         : kInvalidServerID;
+const VolumeQoS Config::kVirtualDiskQoS = [](auto &root) {
+  const auto weight = root["kVirtualDiskQoSWeight"].asUInt64();
+  const VolumeQoS qos{
+      .reservation = root["kVirtualDiskQoSReservation"].asUInt64(),
+      .limit = root["kVirtualDiskQoSLimit"].asUInt64(),
+      .weight = std::max<uint64_t>(weight, 1)};
+  if (qos.limit != 0 && qos.reservation > qos.limit) {
+    throw std::runtime_error("Invalid QoS: reservation is above the limit");
+  }
+  return qos;
+}(root);
+const uint32_t Config::kVirtualDiskNumReplicas =
+    Config::kVirtualDiskType == Config::VirtualDiskType::kRemote
+        ? [](auto &root) {
+            const auto n = root["kVirtualDiskNumReplicas"].asUInt();
+            if (n < kMinNumReplicas || n > kMaxNumReplicas) {
+              throw std::runtime_error("Invalid number of replicas");
+            }
+            return n;
+          }(root)
+        : kDefaultNumReplicas;
+const uint32_t Config::kVirtualDiskWriteAckReplicas =
+    Config::kVirtualDiskType == Config::VirtualDiskType::kRemote
+        ? [](auto &root) {
+            const auto n = root["kVirtualDiskWriteAckReplicas"].asUInt();
+            if (n > Config::kVirtualDiskNumReplicas) {
+              throw std::runtime_error("Invalid number of write ack replicas");
+            }
+            return n;
+          }(root)
+        : 0;
+const uint32_t Config::kVirtualDiskWriteAckWindow =
+    root["kVirtualDiskWriteAckWindow"].asUInt();
+const bool Config::kVirtualDiskErasureCoding =
+    Config::kVirtualDiskType == Config::VirtualDiskType::kRemote
+        ? root["kVirtualDiskErasureCoding"].asBool()
+        : false;
 
 const std::string Config::kControllerIP = root["kControllerIP"].asString();
 const int Config::kControllerPort = root["kControllerPort"].asInt();
@@ -74,10 +117,17 @@ const std::filesystem::path Config::kSSDModelsDirPath = [](auto &root) {
 }(root);
 const bool Config::kDiskServerRejections =
     root["kDiskServerRejections"].asBool();
+const bool Config::kDiskModelInterpolateMix =
+    root["kDiskModelInterpolateMix"].asBool();
+const bool Config::kDiskModelOnlineLearning =
+    root["kDiskModelOnlineLearning"].asBool();
 
 const std::string Config::kStorageServerIP =
     root["kStorageServerIP"].asString();
 const int Config::kStorageServerPort = root["kStorageServerPort"].asInt();
+/* Read cache is disabled if no size is configured. */
+const uint64_t Config::kDiskServerReadCacheSizeMB =
+    root["kDiskServerReadCacheSizeMB"].asUInt64();
 
 const Config::ControlPlaneSchedulerType Config::kControlPlaneSchedulerType =
     [](auto &root) {
@@ -107,6 +157,45 @@ const Config::ControlPlaneSchedulerType Config::kControlPlaneSchedulerType =
       throw std::runtime_error("Unknown control plane scheduler type");
     }(root);
 
+const Config::ProfileGuidedSolverType Config::kProfileGuidedSolverType =
+    [](auto &root) {
+      if (strcmp(root["kProfileGuidedSolverType"].asCString(), "Iterative") ==
+          0) {
+        return Config::ProfileGuidedSolverType::kIterative;
+      }
+      if (strcmp(root["kProfileGuidedSolverType"].asCString(), "Bisection") ==
+          0) {
+        return Config::ProfileGuidedSolverType::kBisection;
+      }
+      throw std::runtime_error("Unknown profile guided solver type");
+    }(root);
+
+const Config::RWIsolationAllocatorType Config::kRWIsolationAllocatorType =
+    [](auto &root) {
+      if (strcmp(root["kRWIsolationAllocatorType"].asCString(), "Reactive") ==
+          0) {
+        return Config::RWIsolationAllocatorType::kReactive;
+      }
+      if (strcmp(root["kRWIsolationAllocatorType"].asCString(),
+                 "Predictive") == 0) {
+        return Config::RWIsolationAllocatorType::kPredictive;
+      }
+      throw std::runtime_error("Unknown RW isolation allocator type");
+    }(root);
+
+const Config::CongestionControlType Config::kCongestionControlType =
+    [](auto &root) {
+      if (strcmp(root["kCongestionControlType"].asCString(), "LocalAIMD") ==
+          0) {
+        return Config::CongestionControlType::kLocalAIMD;
+      }
+      if (strcmp(root["kCongestionControlType"].asCString(),
+                 "Coordinated") == 0) {
+        return Config::CongestionControlType::kCoordinated;
+      }
+      throw std::runtime_error("Unknown congestion control type");
+    }(root);
+
 const Config::DataPlaneSchedulerType Config::kDataPlaneSchedulerType =
     [](auto &root) {
       if (strcmp(root["kDataPlaneSchedulerType"].asCString(),
@@ -125,6 +214,10 @@ const Config::DataPlaneSchedulerType Config::kDataPlaneSchedulerType =
                  "WeightedReadHashWrite") == 0) {
         return Config::DataPlaneSchedulerType::kWeightedReadHashWrite;
       }
+      if (strcmp(root["kDataPlaneSchedulerType"].asCString(),
+                 "P2CReadWeightedWrite") == 0) {
+        return Config::DataPlaneSchedulerType::kP2CReadWeightedWrite;
+      }
       throw std::runtime_error("Unknown data plane scheduler type");
     }(root);
 
@@ -141,4 +234,8 @@ const Config::DiskServerBackend Config::kDiskServerBackend = [](auto &root) {
   throw std::runtime_error("Unknown disk server backend");
 }(root);
 
+const Location Config::kLocation = {
+    .rack = root["kRack"].asUInt(),
+    .failure_domain = root["kFailureDomain"].asUInt()};
+
 }  // namespace sandook
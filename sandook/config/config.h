@@ -2,9 +2,12 @@
 
 #include <jsoncpp/json/value.h>
 
+#include <cstdint>
 #include <filesystem>
 #include <string>
 
+#include "sandook/base/location.h"
+#include "sandook/base/qos.h"
 #include "sandook/base/types.h"
 
 namespace sandook {
@@ -24,35 +27,70 @@ class Config {
     kWeightedReadWrite = 0,
     kRandomReadWrite = 1,
     kRandomReadHashWrite = 2,
-    kWeightedReadHashWrite = 3
+    kWeightedReadHashWrite = 3,
+    kP2CReadWeightedWrite = 4
   };
 
+  enum ProfileGuidedSolverType { kIterative = 0, kBisection = 1 };
+
+  enum RWIsolationAllocatorType { kReactive = 0, kPredictive = 1 };
+
+  enum CongestionControlType { kLocalAIMD = 0, kCoordinated = 1 };
+
   enum VirtualDiskType { kRemote = 0, kLocal = 1 };
 
   enum DiskServerBackend { kPOSIX = 0, kMemory = 1, kSPDK = 2 };
 
   /* Virtual disk configurations. */
   const static VirtualDiskType kVirtualDiskType;
+  /* Time (in us) that writes are held back for to be batched with the writes
+   * adjacent to them (0 to not batch writes).
+   */
+  const static uint32_t kVirtualDiskWriteBatchWindowUs;
 
   /* Remote virtual disk configurations. */
   const static std::string kVirtualDiskIP;
   const static int kVirtualDiskPort;
   const static ServerID kVirtualDiskServerAffinity;
+  const static VolumeQoS kVirtualDiskQoS;
+  /* Replication factor of the volume. */
+  const static uint32_t kVirtualDiskNumReplicas;
+  /* Replicas that a write waits for before it is acknowledged (0 for all of
+   * them); the other replicas complete in the background.
+   */
+  const static uint32_t kVirtualDiskWriteAckReplicas;
+  /* Most writes that may be completing in the background at a time; writes
+   * beyond it wait for all of their replicas.
+   */
+  const static uint32_t kVirtualDiskWriteAckWindow;
+  /* Erasure-code the data of writes that span whole stripes (instead of
+   * replicating it).
+   */
+  const static bool kVirtualDiskErasureCoding;
 
   /* Controller configurations. */
   const static std::string kControllerIP;
   const static int kControllerPort;
   const static std::filesystem::path kSSDModelsDirPath;
   const static bool kDiskServerRejections;
+  const static bool kDiskModelInterpolateMix;
+  const static bool kDiskModelOnlineLearning;
 
   /* Storage server configurations. */
   const static std::string kStorageServerIP;
   const static int kStorageServerPort;
   const static DiskServerBackend kDiskServerBackend;
+  const static uint64_t kDiskServerReadCacheSizeMB;
 
   /* Scheduling configurations. */
   const static DataPlaneSchedulerType kDataPlaneSchedulerType;
   const static ControlPlaneSchedulerType kControlPlaneSchedulerType;
+  const static ProfileGuidedSolverType kProfileGuidedSolverType;
+  const static RWIsolationAllocatorType kRWIsolationAllocatorType;
+  const static CongestionControlType kCongestionControlType;
+
+  /* Topology configurations (of this server or virtual disk). */
+  const static Location kLocation;
 
  private:
   static const Json::Value root;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cassert>
@@ -58,6 +59,20 @@ class BlockAllocator {
     return allocs;
   }
 
+  /* Returns the fraction of the server's blocks that are allocated. */
+  [[nodiscard]] double GetFillLevel(ServerID server_id) const {
+    assert(server_id < kNumMaxServers && server_id > kInvalidServerID);
+
+    const auto &server = srv_allocs_.at(server_id);
+    if (server.allocation_map.empty()) {
+      return 0.0;
+    }
+    const auto allocated = std::min<uint64_t>(server.next_allocation.load(),
+                                              server.allocation_map.size());
+    return static_cast<double>(allocated) /
+           static_cast<double>(server.allocation_map.size());
+  }
+
  private:
   block_allocator::ServerAllocations srv_allocs_;
 };
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/error.h"
+#include "sandook/base/server_stats.h"
+#include "sandook/base/time.h"
+#include "sandook/base/types.h"
+#include "sandook/bindings/sync.h"
+
+namespace sandook::controller {
+
+/* Allocates the rates of volumes at congested servers.
+ *
+ * Without it, each volume backs off a congested server on its own (AIMD on
+ * the congestion signals it receives), so volumes that send more see more
+ * signals and all of them converge slowly and unfairly. Instead, volumes
+ * report the ops they send to each server, and the controller splits the
+ * throughput that a congested server sustains among the volumes that use it,
+ * max-min fair in proportion to their (QoS) weights. A volume is given the
+ * fraction of its demand at the server that it may send, which it applies in
+ * place of its own rate limit.
+ *
+ * While a server is congested, the allocation targets slightly less than its
+ * throughput, and once its load is stable it holds the throughput steady. The
+ * volumes' own AIMD takes over elsewhere, i.e., to ramp back up after the
+ * congestion.
+ */
+class CongestionAllocator {
+ public:
+  constexpr static auto kAllocationIntervalUs = 10 * kOneMilliSecond;
+  /* Target throughput of a congested server, relative to what it sustains. */
+  constexpr static auto kCongestedUtilization = 0.9;
+  /* Smallest fraction of its demand that a volume is allowed to send. */
+  constexpr static RateLimit kMinRateLimit = 0.001;
+
+  CongestionAllocator() = default;
+  ~CongestionAllocator() = default;
+
+  /* No copying. */
+  CongestionAllocator(const CongestionAllocator &) = delete;
+  CongestionAllocator &operator=(const CongestionAllocator &) = delete;
+
+  /* No moving. */
+  CongestionAllocator(CongestionAllocator &&) noexcept;
+  CongestionAllocator &operator=(CongestionAllocator &&) noexcept;
+
+  Status<void> AddVolume(VolumeID vol_id, uint64_t weight) {
+    if (vol_id >= kNumMaxVolumes) {
+      return MakeError(EINVAL);
+    }
+
+    rt::SpinGuard g(lock_);
+    auto &vol = vols_.at(vol_id);
+    if (vol.is_registered) {
+      return MakeError(EALREADY);
+    }
+    vol = Volume{};
+    vol.weight = static_cast<double>(std::max<uint64_t>(weight, 1));
+    vol.is_registered = true;
+    return {};
+  }
+
+  /* Records the ops sent so far by the volume to each server. Returns true
+   * (to a single caller per interval) if the rates are due to be allocated.
+   */
+  Status<bool> UpdateOps(VolumeID vol_id, const ServerOps &ops) {
+    if (vol_id >= kNumMaxVolumes) {
+      return MakeError(EINVAL);
+    }
+
+    rt::SpinGuard g(lock_);
+    auto &vol = vols_.at(vol_id);
+    if (!vol.is_registered) {
+      return MakeError(ENOENT);
+    }
+    vol.ops = ops;
+
+    const auto now = MicroTime();
+    if (now - last_allocation_us_ < kAllocationIntervalUs) {
+      return false;
+    }
+    elapsed_us_ = now - last_allocation_us_;
+    last_allocation_us_ = now;
+    return true;
+  }
+
+  /* Allocates the rates of the volumes at the congested servers, given the
+   * latest stats of the servers.
+   */
+  void Allocate(const ServerStatsList &servers) {
+    rt::SpinGuard g(lock_);
+
+    const auto elapsed = static_cast<double>(elapsed_us_) / kOneSecond;
+    for (auto &vol : vols_) {
+      if (!vol.is_registered) {
+        continue;
+      }
+      for (size_t i = 0; i < kNumMaxServers; i++) {
+        /* The volume only sent the fraction of its demand that it was
+         * allocated over the interval (if any); scale the ops back up so that
+         * the allocation does not compound its own throttling.
+         */
+        const auto rate_limit =
+            (vol.rate_limits.at(i) > 0) ? vol.rate_limits.at(i) : 1.0;
+        vol.demands.at(i) =
+            static_cast<double>(vol.ops.at(i) - vol.last_ops.at(i)) /
+            elapsed / rate_limit;
+      }
+      vol.last_ops = vol.ops;
+    }
+
+    AllocateLocked(servers);
+  }
+
+  /* Allocates the rates given the demand (ops per second, before any rate
+   * limits) of each volume at each server. This is exposed for tests; Allocate
+   * estimates the demands from the ops sent.
+   */
+  void Allocate(const ServerStatsList &servers,
+                const std::array<ServerDemands, kNumMaxVolumes> &demands) {
+    rt::SpinGuard g(lock_);
+    for (size_t i = 0; i < kNumMaxVolumes; i++) {
+      vols_.at(i).demands = demands.at(i);
+    }
+    AllocateLocked(servers);
+  }
+
+  /* Returns the rate limits of the volume at each server (0 where there is no
+   * allocation).
+   */
+  Status<ServerRateLimits> GetRateLimits(VolumeID vol_id) {
+    if (vol_id >= kNumMaxVolumes) {
+      return MakeError(EINVAL);
+    }
+
+    rt::SpinGuard g(lock_);
+    const auto &vol = vols_.at(vol_id);
+    if (!vol.is_registered) {
+      return MakeError(ENOENT);
+    }
+    return vol.rate_limits;
+  }
+
+ private:
+  struct Volume {
+    double weight{1};
+    /* Ops sent so far to each server, and at the last allocation. */
+    ServerOps ops{};
+    ServerOps last_ops{};
+    /* Ops per second sent to each server over the last interval. */
+    ServerDemands demands{};
+    ServerRateLimits rate_limits{};
+    bool is_registered{false};
+
+    /* Used by AllocateLocked. */
+    double share{0};
+  };
+
+  rt::Spin lock_;
+  std::array<Volume, kNumMaxVolumes> vols_{};
+  uint64_t last_allocation_us_{0};
+  uint64_t elapsed_us_{0};
+
+  void AllocateLocked(const ServerStatsList &servers) {
+    for (auto &vol : vols_) {
+      vol.rate_limits.fill(0);
+    }
+
+    for (const auto &srv : servers) {
+      double target = 0;
+      switch (srv.congestion_state) {
+        case ServerCongestionState::kCongested:
+          target = kCongestedUtilization;
+          break;
+
+        case ServerCongestionState::kCongestedStable:
+          target = 1.0;
+          break;
+
+        default:
+          continue;
+      }
+
+      const auto throughput = (srv.read_mops + srv.write_mops) * kMillion;
+      if (throughput <= 0) {
+        continue;
+      }
+      AllocateServer(srv.server_id, target * throughput);
+    }
+  }
+
+  /* Weighted max-min fair split of the capacity of the server among the
+   * volumes (water-filling up to their demands).
+   */
+  void AllocateServer(ServerID server_id, double capacity) {
+    for (auto &vol : vols_) {
+      vol.share = 0;
+    }
+
+    auto spare = capacity;
+    /* Every round but the last satisfies at least one more volume. */
+    for (size_t round = 0; round < kNumMaxVolumes && spare > 0; round++) {
+      double total_weight = 0;
+      for (const auto &vol : vols_) {
+        if (IsUnsatisfied(vol, server_id)) {
+          total_weight += vol.weight;
+        }
+      }
+      if (total_weight == 0) {
+        break;
+      }
+
+      double given = 0;
+      bool is_satisfied = false;
+      for (auto &vol : vols_) {
+        if (!IsUnsatisfied(vol, server_id)) {
+          continue;
+        }
+        const auto fair = spare * vol.weight / total_weight;
+        const auto share =
+            std::min(fair, vol.demands.at(server_id) - vol.share);
+        is_satisfied |= share < fair;
+        vol.share += share;
+        given += share;
+      }
+      spare -= given;
+
+      if (!is_satisfied) {
+        break;
+      }
+    }
+
+    for (auto &vol : vols_) {
+      const auto demand = vol.demands.at(server_id);
+      if (!vol.is_registered || demand <= 0) {
+        continue;
+      }
+      vol.rate_limits.at(server_id) =
+          std::clamp(vol.share / demand, kMinRateLimit, 1.0);
+    }
+  }
+
+  [[nodiscard]] static bool IsUnsatisfied(const Volume &vol,
+                                          ServerID server_id) {
+    return vol.is_registered && vol.share < vol.demands.at(server_id);
+  }
+};
+
+}  // namespace sandook::controller
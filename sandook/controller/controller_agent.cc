@@ -5,6 +5,7 @@ extern "C" {
 #include <runtime/net.h>
 }
 
+#include <algorithm>
 #include <array>
 #include <cerrno>
 #include <cstdint>
@@ -13,22 +14,25 @@ extern "C" {
 #include <utility>
 
 #include "sandook/base/error.h"
+#include "sandook/base/qos.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/bindings/log.h"
+#include "sandook/config/config.h"
 #include "sandook/controller/controller_agent.h"
 
 namespace sandook {
 
 ControllerAgent::ControllerAgent() {
   LOG(INFO) << "Sandook: ";
-  LOG(INFO) << "\tReplicationFactor = " << kNumReplicas;
+  LOG(INFO) << "\tDefaultReplicationFactor = " << kDefaultNumReplicas;
 }
 
 Status<ServerID> ControllerAgent::RegisterServer(const std::string &ip,
                                                  int port,
                                                  const std::string &name,
-                                                 uint64_t n_sectors) {
+                                                 uint64_t n_sectors,
+                                                 Location location) {
   const auto server_id = next_server_id_.fetch_add(1);
   assert(server_id < kNumMaxServers);
 
@@ -45,7 +49,8 @@ Status<ServerID> ControllerAgent::RegisterServer(const std::string &ip,
   }
 
   const auto &[it, ok] =
-      servers_.try_emplace(server_id, server_id, ip, port, name, n_sectors);
+      servers_.try_emplace(server_id, server_id, ip, port, name, n_sectors,
+                           location);
   if (!ok) {
     LOG(ERR) << "Cannot add server";
     return MakeError(EINVAL);
@@ -62,26 +67,96 @@ Status<DiskPeakIOPS> ControllerAgent::GetDiskPeakIOPS(
 }
 
 Status<VolumeID> ControllerAgent::RegisterVolume(const std::string &ip,
-                                                 int port, uint64_t n_sectors) {
-  const auto vol_id = vol_id_.fetch_add(1);
-  assert(vol_id < kNumMaxVolumes);
+                                                 int port, uint64_t n_sectors,
+                                                 VolumeQoS qos,
+                                                 uint32_t num_replicas,
+                                                 bool is_erasure_coded) {
+  if (num_replicas < kMinNumReplicas || num_replicas > kMaxNumReplicas) {
+    LOG(ERR) << "Invalid number of replicas: " << num_replicas;
+    return MakeError(EINVAL);
+  }
+
+  if (!controller::QoSAllocator::IsValid(qos)) {
+    LOG(ERR) << "Invalid QoS: reservation exceeds limit";
+    return MakeError(EINVAL);
+  }
+
+  /* Only valid registrations take an ID, so rejected ones never use up IDs. */
+  auto vol_id = vol_id_.load();
+  do {
+    if (vol_id >= kNumMaxVolumes) {
+      LOG(ERR) << "Too many volumes";
+      return MakeError(ENOSPC);
+    }
+  } while (!vol_id_.compare_exchange_weak(vol_id, vol_id + 1));
 
   netaddr raddr{};
   const std::string addr = ip + ":" + std::to_string(port);
   str_to_netaddr(addr.c_str(), &raddr);
 
-  const auto &[it, ok] = vols_.try_emplace(vol_id, vol_id, ip, port, n_sectors);
+  const auto qos_add = qos_alloc_.AddVolume(vol_id, qos);
+  if (!qos_add) {
+    LOG(ERR) << "Cannot add volume to QoS allocator";
+    return MakeError(qos_add);
+  }
+
+  const auto cc_add = cc_alloc_.AddVolume(vol_id, qos.weight);
+  if (!cc_add) {
+    LOG(ERR) << "Cannot add volume to congestion allocator";
+    return MakeError(cc_add);
+  }
+
+  const auto &[it, ok] = vols_.try_emplace(vol_id, vol_id, ip, port, n_sectors,
+                                           qos, num_replicas, is_erasure_coded);
   if (!ok) {
     return MakeError(EINVAL);
   }
   LOG(INFO) << it->second;
 
+  /* Writes need as many servers as the most replicated volume has replicas,
+   * or a stripe has blocks if any volume is erasure-coded.
+   */
+  uint32_t min_write_servers = 0;
+  for (const auto &[_, vol] : vols_) {
+    min_write_servers = std::max(min_write_servers, vol.num_write_servers());
+  }
+  sched_.SetMinWriteServers(min_write_servers);
+
   return vol_id;
 }
 
+Status<uint64_t> ControllerAgent::UpdateVolumeDemand(VolumeID vol_id,
+                                                     uint64_t requested) {
+  const auto capacity = servers_.size() * kQoSCapacityPerSSD;
+  return qos_alloc_.UpdateDemand(vol_id, requested, capacity);
+}
+
+Status<ServerRateLimits> ControllerAgent::UpdateVolumeServerOps(
+    VolumeID vol_id, const ServerOps &ops) {
+  if (Config::kCongestionControlType !=
+      Config::CongestionControlType::kCoordinated) {
+    return ServerRateLimits{};
+  }
+
+  const auto is_due = cc_alloc_.UpdateOps(vol_id, ops);
+  if (!is_due) {
+    return MakeError(is_due);
+  }
+  if (*is_due) {
+    const auto servers = sched_.GetServerStats();
+    if (!servers) {
+      return MakeError(servers);
+    }
+    cc_alloc_.Allocate(*servers);
+  }
+
+  return cc_alloc_.GetRateLimits(vol_id);
+}
+
 Status<void> ControllerAgent::UpdateServerStats(ServerID server_id,
                                                 ServerStats stats) {
   assert(servers_.find(server_id) != servers_.end());
+  stats.fill_level = blk_alloc_.GetFillLevel(server_id);
   return sched_.UpdateServerStats(server_id, stats);
 }
 
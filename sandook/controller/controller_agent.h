@@ -8,9 +8,13 @@
 
 #include "sandook/base/controller_stats.h"
 #include "sandook/base/error.h"
+#include "sandook/base/location.h"
+#include "sandook/base/qos.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/controller/block_allocator.h"
+#include "sandook/controller/congestion_allocator.h"
+#include "sandook/controller/qos_allocator.h"
 #include "sandook/controller/server_desc.h"
 #include "sandook/controller/volume_desc.h"
 #include "sandook/scheduler/control_plane/scheduler.h"
@@ -47,9 +51,13 @@ class ControllerAgent {
 
   [[nodiscard]] Status<ServerID> RegisterServer(const std::string &ip, int port,
                                                 const std::string &name,
-                                                uint64_t n_sectors);
-  [[nodiscard]] Status<VolumeID> RegisterVolume(const std::string &ip, int port,
-                                                uint64_t n_sectors);
+                                                uint64_t n_sectors,
+                                                Location location = {});
+  [[nodiscard]] Status<VolumeID> RegisterVolume(
+      const std::string &ip, int port, uint64_t n_sectors,
+      VolumeQoS qos = {.reservation = 0, .limit = 0, .weight = 1},
+      uint32_t num_replicas = kDefaultNumReplicas,
+      bool is_erasure_coded = false);
 
   Status<ServerAllocationBlockInfoList> AllocateBlocks(ServerID server_id);
 
@@ -59,6 +67,17 @@ class ControllerAgent {
   Status<DataPlaneServerStats> GetDataPlaneServerStats(ServerID server_id);
   Status<DiskPeakIOPS> GetDiskPeakIOPS(ServerID server_id) const;
 
+  /* Records the QoS tokens requested so far by the volume and returns the rate
+   * allocated to it (0 if unlimited).
+   */
+  Status<uint64_t> UpdateVolumeDemand(VolumeID vol_id, uint64_t requested);
+
+  /* Records the ops sent so far by the volume to each server and returns the
+   * rate limits allocated to it at congested servers.
+   */
+  Status<ServerRateLimits> UpdateVolumeServerOps(VolumeID vol_id,
+                                                 const ServerOps &ops);
+
   /* This method is used for tests.
    * It allows "pausing" the dynamic scheduler and testing the behavior of the
    * controller agent at a given moment in time.
@@ -74,6 +93,10 @@ class ControllerAgent {
 
   controller::BlockAllocator blk_alloc_;
 
+  controller::QoSAllocator qos_alloc_;
+
+  controller::CongestionAllocator cc_alloc_;
+
   controller::RuntimeInfo stats_;
 
   schedulers::control_plane::Scheduler sched_;
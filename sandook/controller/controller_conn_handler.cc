@@ -86,7 +86,7 @@ Status<RPCReturnBuffer> ControllerConnHandler::HandleRegisterServer(
   name.erase(std::remove(name.begin(), name.end(), ' '), name.end());
 
   auto id = ctrl_->RegisterServer(static_cast<const char*>(msg->ip), msg->port,
-                                  name.c_str(), msg->nsectors);
+                                  name.c_str(), msg->nsectors, msg->location);
   if (!id) {
     return MakeError(id);
   }
@@ -108,7 +108,8 @@ Status<RPCReturnBuffer> ControllerConnHandler::HandleRegisterVolume(
   auto* msg = reinterpret_cast<RegisterVolumeMsg*>(
       const_cast<std::byte*>(payload.data()));
   auto id = ctrl_->RegisterVolume(static_cast<const char*>(msg->ip), msg->port,
-                                  msg->nsectors);
+                                  msg->nsectors, msg->qos, msg->num_replicas,
+                                  msg->is_erasure_coded);
   if (!id) {
     return MakeError(id);
   }
@@ -181,7 +182,21 @@ Status<RPCReturnBuffer> ControllerConnHandler::HandleGetServerStats(
   auto* msg = reinterpret_cast<GetServerStatsMsg*>(
       const_cast<std::byte*>(payload.data()));
 
-  auto reply = CreateGetServerStatsReplyMsg(msg->vol_id);
+  const auto qos_rate = ctrl_->UpdateVolumeDemand(msg->vol_id, msg->qos_demand);
+  if (!qos_rate) {
+    LOG(ERR) << "Cannot update the QoS demand of volume: " << msg->vol_id;
+    return MakeError(qos_rate);
+  }
+
+  const auto cc_rate_limits =
+      ctrl_->UpdateVolumeServerOps(msg->vol_id, msg->server_ops);
+  if (!cc_rate_limits) {
+    LOG(ERR) << "Cannot allocate the rates of volume: " << msg->vol_id;
+    return MakeError(cc_rate_limits);
+  }
+
+  auto reply =
+      CreateGetServerStatsReplyMsg(msg->vol_id, *qos_rate, *cc_rate_limits);
   const auto response_size = GetMsgSize(reply.get());
   auto* reply_msg = reinterpret_cast<GetServerStatsReplyMsg*>(
       reply.get() + sizeof(MsgHeader));
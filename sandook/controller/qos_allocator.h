@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/error.h"
+#include "sandook/base/qos.h"
+#include "sandook/base/time.h"
+#include "sandook/base/types.h"
+#include "sandook/bindings/sync.h"
+
+namespace sandook::controller {
+
+/* Interval to redistribute the capacity among the QoS classes of volumes. */
+constexpr auto kQoSAllocationIntervalUs = 10 * kOneMilliSecond;
+
+/* Allocates the rates that volumes enforce for their QoS classes.
+ *
+ * Volumes report the (cumulative) tokens they request, from which the demand
+ * of each volume is measured over every interval. Each volume is guaranteed
+ * its reservation, but the part of a reservation that a volume does not use is
+ * lent to the others along with the capacity left over after the
+ * reservations. The spare capacity is shared in proportion to the weights of
+ * the volumes: first up to their demand (with some headroom to let the demand
+ * grow), then up to their limits.
+ *
+ * QoS is only enforced once a volume has a reservation to protect; until then
+ * volumes are only held to their limits.
+ */
+class QoSAllocator {
+ public:
+  /* Headroom over the measured demand of a volume. */
+  constexpr static auto kDemandHeadroom = 1.25;
+  /* Smallest rate of a volume, so that no volume is starved. */
+  constexpr static uint64_t kMinRate = 1000;
+
+  QoSAllocator() = default;
+  ~QoSAllocator() = default;
+
+  /* No copying. */
+  QoSAllocator(const QoSAllocator &) = delete;
+  QoSAllocator &operator=(const QoSAllocator &) = delete;
+
+  /* No moving. */
+  QoSAllocator(QoSAllocator &&) noexcept;
+  QoSAllocator &operator=(QoSAllocator &&) noexcept;
+
+  /* Whether a volume may be added with the QoS (a limit of 0 is unlimited). */
+  [[nodiscard]] static bool IsValid(const VolumeQoS &qos) {
+    return qos.limit == 0 || qos.reservation <= qos.limit;
+  }
+
+  Status<void> AddVolume(VolumeID vol_id, VolumeQoS qos) {
+    if (vol_id >= kNumMaxVolumes) {
+      return MakeError(EINVAL);
+    }
+    if (!IsValid(qos)) {
+      return MakeError(EINVAL);
+    }
+
+    rt::SpinGuard g(lock_);
+    auto &vol = vols_.at(vol_id);
+    if (vol.is_registered) {
+      return MakeError(EALREADY);
+    }
+    qos.weight = std::max<uint64_t>(qos.weight, 1);
+    vol = Volume{.qos = qos, .rate = qos.limit, .is_registered = true};
+    return {};
+  }
+
+  /* Records the tokens requested so far by the volume and returns its rate
+   * (0 if unlimited). The rates are redistributed at most once per interval,
+   * among disk servers with the given total capacity.
+   */
+  Status<uint64_t> UpdateDemand(VolumeID vol_id, uint64_t requested,
+                                uint64_t capacity) {
+    if (vol_id >= kNumMaxVolumes) {
+      return MakeError(EINVAL);
+    }
+
+    rt::SpinGuard g(lock_);
+    auto &vol = vols_.at(vol_id);
+    if (!vol.is_registered) {
+      return MakeError(ENOENT);
+    }
+    vol.requested = requested;
+
+    const auto now = MicroTime();
+    if (now - last_allocation_us_ >= kQoSAllocationIntervalUs) {
+      MeasureDemand(now - last_allocation_us_);
+      Redistribute(capacity);
+      last_allocation_us_ = now;
+    }
+
+    return vol.rate;
+  }
+
+  /* Redistributes the capacity given the demand of each volume (in tokens per
+   * second). This is exposed for tests; UpdateDemand measures the demand.
+   */
+  void Allocate(uint64_t capacity,
+                const std::array<double, kNumMaxVolumes> &demands) {
+    rt::SpinGuard g(lock_);
+    for (size_t i = 0; i < kNumMaxVolumes; i++) {
+      vols_.at(i).demand = demands.at(i);
+    }
+    Redistribute(capacity);
+  }
+
+  [[nodiscard]] uint64_t GetRate(VolumeID vol_id) {
+    rt::SpinGuard g(lock_);
+    return vols_.at(vol_id).rate;
+  }
+
+ private:
+  struct Volume {
+    VolumeQoS qos{};
+    /* Tokens requested so far, and at the last allocation. */
+    uint64_t requested{0};
+    uint64_t last_requested{0};
+    /* Tokens requested per second over the last interval. */
+    double demand{0};
+    /* Allocated rate (0 if unlimited). */
+    uint64_t rate{0};
+    bool is_registered{false};
+
+    /* Used by Redistribute. */
+    double share{0};
+  };
+
+  rt::Spin lock_;
+  std::array<Volume, kNumMaxVolumes> vols_{};
+  uint64_t last_allocation_us_{0};
+
+  void MeasureDemand(uint64_t elapsed_us) {
+    const auto elapsed = static_cast<double>(elapsed_us) / kOneSecond;
+    for (auto &vol : vols_) {
+      if (!vol.is_registered) {
+        continue;
+      }
+      vol.demand =
+          static_cast<double>(vol.requested - vol.last_requested) / elapsed;
+      vol.last_requested = vol.requested;
+    }
+  }
+
+  void Redistribute(uint64_t capacity) {
+    const bool has_reservations = std::ranges::any_of(vols_, [](auto &vol) {
+      return vol.is_registered && vol.qos.reservation > 0;
+    });
+    if (!has_reservations || capacity == 0) {
+      for (auto &vol : vols_) {
+        vol.rate = vol.qos.limit;
+      }
+      return;
+    }
+
+    /* Reservations are only charged for what the volumes use of them. */
+    auto spare = static_cast<double>(capacity);
+    for (auto &vol : vols_) {
+      if (!vol.is_registered) {
+        continue;
+      }
+      vol.share =
+          std::min(static_cast<double>(vol.qos.reservation), vol.demand);
+      spare -= vol.share;
+    }
+    spare = std::max(spare, 0.0);
+
+    spare = Distribute(spare, [](const Volume &vol) {
+      return std::min(GetLimit(vol), vol.demand * kDemandHeadroom);
+    });
+    Distribute(spare, GetLimit);
+
+    for (auto &vol : vols_) {
+      if (!vol.is_registered) {
+        continue;
+      }
+      const auto share = std::max(
+          static_cast<double>(std::max(vol.qos.reservation, kMinRate)),
+          vol.share);
+      vol.rate = static_cast<uint64_t>(std::min(share, GetLimit(vol)));
+    }
+  }
+
+  [[nodiscard]] static double GetLimit(const Volume &vol) {
+    return (vol.qos.limit == 0) ? std::numeric_limits<double>::infinity()
+                                : static_cast<double>(vol.qos.limit);
+  }
+
+  /* Shares the spare capacity among the volumes in proportion to their
+   * weights, without taking any volume above its cap (water-filling). Returns
+   * the capacity that is left.
+   */
+  template <typename F>
+  double Distribute(double spare, F get_cap) {
+    /* Every round but the last caps at least one more volume. */
+    for (size_t round = 0; round < kNumMaxVolumes && spare > 0; round++) {
+      double total_weight = 0;
+      for (const auto &vol : vols_) {
+        if (vol.is_registered && vol.share < get_cap(vol)) {
+          total_weight += static_cast<double>(vol.qos.weight);
+        }
+      }
+      if (total_weight == 0) {
+        break;
+      }
+
+      double given = 0;
+      bool is_capped = false;
+      for (auto &vol : vols_) {
+        const auto cap = get_cap(vol);
+        if (!vol.is_registered || vol.share >= cap) {
+          continue;
+        }
+        const auto fair =
+            spare * static_cast<double>(vol.qos.weight) / total_weight;
+        const auto share = std::min(fair, cap - vol.share);
+        is_capped |= share < fair;
+        vol.share += share;
+        given += share;
+      }
+      spare -= given;
+
+      /* The capacity the capped volumes could not take is handed out again. */
+      if (!is_capped) {
+        break;
+      }
+    }
+
+    return std::max(spare, 0.0);
+  }
+};
+
+}  // namespace sandook::controller
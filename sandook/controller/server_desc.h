@@ -7,6 +7,7 @@
 #include <utility>
 
 #include "sandook/base/constants.h"
+#include "sandook/base/location.h"
 #include "sandook/base/msg.h"
 
 namespace sandook {
@@ -14,12 +15,13 @@ namespace sandook {
 class ServerDesc {
  public:
   ServerDesc(uint32_t id, std::string ip, int port, std::string name,
-             uint64_t nsectors)
+             uint64_t nsectors, Location location = {})
       : id_(id),
         ip_(std::move(ip)),
         name_(std::move(name)),
         port_(port),
-        nsectors_(nsectors) {
+        nsectors_(nsectors),
+        location_(location) {
     std::cout << "Allocated: " << nsectors_ << '\n';
   }
   ~ServerDesc() = default;
@@ -38,16 +40,20 @@ class ServerDesc {
     std::strncpy(static_cast<char *>(info.ip), ip_.c_str(), ip_.size());
     std::strncpy(static_cast<char *>(info.name), name_.c_str(), name_.size());
     info.port = port_;
+    info.location = location_;
     return info;
   }
 
   [[nodiscard]] uint64_t nsectors() const { return nsectors_; }
+  [[nodiscard]] Location location() const { return location_; }
 
   friend std::ostream &operator<<(std::ostream &out, const ServerDesc &p) {
     out << "DiskServer: " << p.id_ << '\n';
     out << "\t" << p.name_ << '\n';
     out << "\t" << p.ip_ << ":" << p.port_ << '\n';
-    out << "\t" << p.nsectors_ << " sectors";
+    out << "\t" << p.nsectors_ << " sectors" << '\n';
+    out << "\track " << p.location_.rack << ", failure domain "
+        << p.location_.failure_domain;
     return out;
   }
 
@@ -60,6 +66,7 @@ class ServerDesc {
   std::string name_;
   int port_{};
   uint64_t nsectors_{};
+  Location location_{};
 };
 
 }  // namespace sandook
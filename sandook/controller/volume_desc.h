@@ -1,19 +1,44 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <string>
 #include <utility>
 
+#include "sandook/base/constants.h"
+#include "sandook/base/qos.h"
+
 namespace sandook {
 
 class VolumeDesc {
  public:
-  VolumeDesc(uint32_t id, std::string ip, int port, uint64_t nsectors)
-      : id_(id), ip_(std::move(ip)), port_(port), nsectors_(nsectors) {}
+  VolumeDesc(uint32_t id, std::string ip, int port, uint64_t nsectors,
+             VolumeQoS qos, uint32_t num_replicas = kDefaultNumReplicas,
+             bool is_erasure_coded = false)
+      : id_(id),
+        ip_(std::move(ip)),
+        port_(port),
+        nsectors_(nsectors),
+        qos_(qos),
+        num_replicas_(num_replicas),
+        is_erasure_coded_(is_erasure_coded) {}
   ~VolumeDesc() = default;
 
   [[nodiscard]] uint64_t nsectors() const { return nsectors_; }
+  [[nodiscard]] VolumeQoS qos() const { return qos_; }
+  [[nodiscard]] uint32_t num_replicas() const { return num_replicas_; }
+  [[nodiscard]] bool is_erasure_coded() const { return is_erasure_coded_; }
+
+  /* Servers that a write of the volume needs to take writes at once: one per
+   * replica, or per block of a stripe if the volume is erasure-coded.
+   */
+  [[nodiscard]] uint32_t num_write_servers() const {
+    if (!is_erasure_coded_) {
+      return num_replicas_;
+    }
+    return std::max<uint32_t>(num_replicas_, kECStripeBlocks);
+  }
 
   /* No copying. */
   VolumeDesc(const VolumeDesc &) = delete;
@@ -26,7 +51,12 @@ class VolumeDesc {
   friend std::ostream &operator<<(std::ostream &out, const VolumeDesc &v) {
     out << "Volume: " << v.id_ << '\n';
     out << "\t" << v.ip_ << ":" << v.port_ << '\n';
-    out << "\t" << v.nsectors_ << " sectors";
+    out << "\t" << v.nsectors_ << " sectors" << '\n';
+    out << "\tQoS: reservation = " << v.qos_.reservation
+        << ", limit = " << v.qos_.limit << ", weight = " << v.qos_.weight
+        << '\n';
+    out << "\tReplicationFactor = " << v.num_replicas_ << '\n';
+    out << "\tErasureCoded = " << v.is_erasure_coded_;
     return out;
   }
 
@@ -35,6 +65,9 @@ class VolumeDesc {
   std::string ip_;
   int port_{};
   uint64_t nsectors_{};
+  VolumeQoS qos_{};
+  uint32_t num_replicas_{kDefaultNumReplicas};
+  bool is_erasure_coded_{false};
 };
 
 }  // namespace sandook
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cerrno>
@@ -8,9 +9,14 @@
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <limits>
+#include <memory>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -19,7 +25,9 @@
 #include "sandook/base/io_desc.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/bindings/log.h"
+#include "sandook/bindings/sync.h"
 #include "sandook/config/config.h"
+#include "sandook/disk_model/model_bundle.h"
 
 constexpr auto kReadOnlyModelSuffix = "_100r.model";
 constexpr auto kWriteOnlyModelSuffix = "_1000w.model";
@@ -40,6 +48,11 @@ constexpr auto kMixModelSuffix_50 = "_500w.model";
 constexpr auto kMixModelSuffix_60 = "_600w.model";
 constexpr auto kMixModelSuffix_70 = "_700w.model";
 constexpr auto kMixModelSuffix_75 = "_750w.model";  // legacy
+constexpr std::string_view kModelExtension = ".model";
+
+// Profiles at other fill levels (percent of the disk that is allocated) are
+// optional; see DiskModel::LoadProfile().
+constexpr int kFillLevelCandidates[] = {10, 20, 30, 40, 50, 60, 70, 80, 90};
 
 constexpr auto kPeakLoadDampeningFactor = 0.95;
 // NOTE: Historically, the model "blew up" latency when queried above the last
@@ -59,125 +72,479 @@ using LoadLatency = std::pair<LoadValues, LatencyValues>;
 
 class DiskModel {
  public:
-  explicit DiskModel(const std::string &name) {
-    if (!LoadModels(name)) {
+  /* Number of cells of the grids used to index into the model curves. */
+  constexpr static size_t kGridSize = 64;
+  /* Resolution of the write-ratio index into the mixed models. */
+  constexpr static size_t kRatioGridSize = 100;
+  /* Iterations to invert a curve interpolated across two mixed models. */
+  constexpr static auto kMaxInverseIterations = 16;
+
+  explicit DiskModel(const std::string &name)
+      : DiskModel(name, Config::kDiskModelInterpolateMix) {}
+
+  DiskModel(const std::string &name, bool interpolate_mix) {
+    auto model = GetShared(name);
+    if (!model) {
       LOG(WARN) << "Cannot load disk model for: " << name;
       throw std::runtime_error("Cannot load model for: " + name);
     }
+    *this = **model;
+    interpolate_mix_ = interpolate_mix;
   }
 
   DiskModel() = default;
   ~DiskModel() = default;
 
+  /* fill_level is the fraction of the disk that is allocated. */
   [[nodiscard]] uint64_t GetLatency(uint64_t cur_load, OpType op,
-                                    ServerMode mode, double write_ratio) const {
-
-    // return GetLatency(cur_load, &load_mix_30_, &latency_mix_30_);
-    // return GetLatency(cur_load, &load_mix_70_, &latency_mix_70_);
-
-    /* Read-only. */
-    if (op == OpType::kRead && mode == ServerMode::kRead) {
-      return GetLatency(cur_load, &load_read_, &latency_read_);
+                                    ServerMode mode, double write_ratio,
+                                    double fill_level = 0.0) const {
+    const auto blend = SelectCurves(op, mode, write_ratio, fill_level);
+    if (blend.num_curves == 1) {
+      return GetLatency(cur_load, *blend.curves[0]);
     }
+    return std::min<uint64_t>(
+        static_cast<uint64_t>(GetLatencyUs(cur_load, blend)),
+        kSaturationLatencyPenaltyUs);
+  }
 
-    /* Write-only. */
-    if (op == OpType::kWrite && mode == ServerMode::kWrite) {
-      return GetLatency(cur_load, &load_write_, &latency_write_);
+  /* Inverse of GetLatency(): returns the highest load that can be offered
+   * before the latency exceeds target_latency.
+   */
+  [[nodiscard]] double GetLoad(double target_latency, OpType op,
+                               ServerMode mode, double write_ratio,
+                               double fill_level = 0.0) const {
+    const auto blend = SelectCurves(op, mode, write_ratio, fill_level);
+    if (blend.num_curves == 1) {
+      return GetLoad(target_latency, *blend.curves[0]);
     }
 
-    /* Read-write mixed.
-     * Select the closest available write-mix model by rounding write_ratio up.
+    /* The crossing of the interpolated curve lies between the crossings of
+     * the curves it interpolates.
      */
-    const auto &mix = SelectMixModel(write_ratio);
-    return GetLatency(cur_load, &mix.load, &mix.latency);
+    auto lo = std::numeric_limits<double>::max();
+    auto hi = 0.0;
+    for (size_t i = 0; i < blend.num_curves; i++) {
+      const auto load = GetLoad(target_latency, *blend.curves[i]);
+      lo = std::min(lo, load);
+      hi = std::max(hi, load);
+    }
+    for (int i = 0; i < kMaxInverseIterations; i++) {
+      const auto mid = (lo + hi) / 2;
+      if (GetLatencyUs(static_cast<uint64_t>(mid), blend) <= target_latency) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
   }
 
-  [[nodiscard]] uint64_t GetPeakIOPS(
-      ServerMode mode, double write_ratio = 0.0) const {
+  [[nodiscard]] uint64_t GetPeakIOPS(ServerMode mode, double write_ratio = 0.0,
+                                     double fill_level = 0.0) const {
+    Blend blend;
     switch (mode) {
       case ServerMode::kRead:
-        return GetPeakIOPS(&load_read_, &latency_read_);
+        blend = SelectCurves(OpType::kRead, mode, write_ratio, fill_level);
+        break;
 
       case ServerMode::kWrite:
-        return GetPeakIOPS(&load_write_, &latency_write_);
+        blend = SelectCurves(OpType::kWrite, mode, write_ratio, fill_level);
+        break;
 
-      case ServerMode::kMix: {
-        const auto &mix = SelectMixModel(write_ratio);
-        return GetPeakIOPS(&mix.load, &mix.latency);
-      }
+      case ServerMode::kMix:
+        blend = SelectCurves(OpType::kRead, mode, write_ratio, fill_level);
+        break;
 
       default:
         throw std::runtime_error("Invalid server mode for obtaining peak load");
     }
 
-    std::unreachable();
+    if (blend.num_curves == 1) {
+      return blend.curves[0]->peak_iops;
+    }
+    double peak_iops = 0.0;
+    for (size_t i = 0; i < blend.num_curves; i++) {
+      peak_iops +=
+          blend.weights[i] * static_cast<double>(blend.curves[i]->peak_iops);
+    }
+    return static_cast<uint64_t>(peak_iops);
+  }
+
+  /* Highest modeled load of the pure read (op = kRead) or pure write
+   * (op = kWrite) profile (at the lowest fill level).
+   */
+  [[nodiscard]] uint64_t GetMaxLoad(OpType op) const {
+    const auto &curve = GetProfile(op).curves.front();
+    return data_->loads[curve.offset + curve.num_points - 1];
+  }
+
+  /* Multiplies the latency of every sample of the pure read (op = kRead) or
+   * pure write (op = kWrite) profile (at all fill levels) by scale(load).
+   */
+  template <typename F>
+  void ScaleLatency(OpType op, F &&scale) {
+    /* The points may be shared with other models; scale a private copy. */
+    auto data = std::make_shared<CurveData>();
+    data->owned_loads.assign(data_->loads.begin(), data_->loads.end());
+    data->owned_latencies.assign(data_->latencies.begin(),
+                                 data_->latencies.end());
+    data->loads = data->owned_loads;
+    data->latencies = data->owned_latencies;
+    data->load_grid = data_->load_grid;
+    data->latency_grid = data_->latency_grid;
+
+    auto &profile = (op == OpType::kRead) ? read_ : write_;
+    for (auto &curve : profile.curves) {
+      const auto end = curve.offset + curve.num_points;
+      for (size_t i = curve.offset; i < end; i++) {
+        const auto latency = static_cast<double>(data->owned_latencies[i]) *
+                             scale(data->owned_loads[i]);
+        data->owned_latencies[i] = static_cast<uint64_t>(std::lround(latency));
+      }
+      Index(data.get(), &curve);
+    }
+    data_ = std::move(data);
+  }
+
+  /* Expected format:
+   * Load,Latency
+   */
+  static LoadLatency LoadModel(const std::filesystem::path &fpath) {
+    LOG(DEBUG) << "Reading model: " << fpath;
+
+    std::ifstream f(fpath);
+    if (!f.is_open() || !f.good()) {
+      const std::string fpath_str(fpath);
+      throw std::runtime_error("Could not open model file: " + fpath_str);
+    }
+
+    LoadLatency result;
+    uint64_t load = 0;
+    double lat = NAN;
+    std::string line;
+
+    /* Ignore the first line with headers. */
+    std::getline(f, line);
+
+    while (std::getline(f, line)) {
+      std::stringstream ss(line);
+      /* First item is load. */
+      ss >> load;
+      /* Ignore the comma. */
+      ss.ignore();
+      /* Second item is latency. */
+      ss >> lat;
+
+      std::get<0>(result).emplace_back(load);
+      std::get<1>(result).emplace_back(lat);
+    }
+
+    f.close();
+
+    return result;
   }
 
  private:
-  struct MixModel {
-    double write_ratio_bucket;
-    LoadValues load;
-    LatencyValues latency;
+  /* Up to two write ratios, each at up to two fill levels. */
+  constexpr static size_t kMaxBlendCurves = 4;
+
+  /* A load/latency curve compiled into the shared arrays of CurveData.
+   *
+   * Points are stored in loads/latencies (structure of arrays) starting at
+   * offset. Two grids index into them in O(1): cell c of the load grid holds
+   * the first point with load >= c * load_step and cell c of the latency grid
+   * holds the first point with latency > c * latency_step. A lookup then only
+   * scans the few points within one cell.
+   */
+  struct Curve {
+    size_t offset{0};
+    size_t num_points{0};
+    size_t grid_offset{0};
+    uint64_t load_step{1};
+    uint64_t latency_step{1};
+    uint64_t max_latency{0};
+    uint64_t peak_iops{0};
   };
 
-  LoadValues load_read_;
-  LatencyValues latency_read_;
+  /* Curves of one workload profiled at different fill levels (ascending). The
+   * base model file is the profile at fill level 0.
+   */
+  struct Profile {
+    std::vector<double> fill_levels;
+    std::vector<Curve> curves;
+  };
 
-  LoadValues load_write_;
-  LatencyValues latency_write_;
+  /* The (one or two) mixed models to use for a write ratio. */
+  struct MixSelection {
+    const Profile *lo;
+    const Profile *hi;
+    /* Weight of hi in the interpolation; 0 if only lo is used. */
+    double hi_weight;
+  };
 
-  std::vector<MixModel> mix_models_;
+  /* Weighted combination of curves that a query is interpolated across. */
+  struct Blend {
+    std::array<const Curve *, kMaxBlendCurves> curves{};
+    std::array<double, kMaxBlendCurves> weights{};
+    size_t num_curves{0};
+  };
+
+  /* Points and grids of all the curves of a model. These are not modified
+   * once built, so that all copies of a model (e.g., one per scheduler) share
+   * them.
+   */
+  struct CurveData {
+    /* Bundle that the points are mapped from (if any). */
+    std::shared_ptr<const ModelBundle> bundle;
+    /* Points that are not mapped from a bundle. */
+    LoadValues owned_loads;
+    LatencyValues owned_latencies;
+    std::span<const uint64_t> loads;
+    std::span<const uint64_t> latencies;
+    std::vector<size_t> load_grid;
+    std::vector<size_t> latency_grid;
+  };
+
+  std::shared_ptr<const CurveData> data_;
+
+  Profile read_;
+  Profile write_;
+
+  /* Mixed models in ascending order of write ratio. */
+  std::vector<Profile> mix_models_;
+  std::vector<double> mix_write_ratios_;
+  /* Cell k holds the first mixed model with write ratio >= k / kRatioGridSize.
+   */
+  std::array<size_t, kRatioGridSize + 1> mix_grid_{};
+
+  /* Interpolate across the two closest mixed models instead of conservatively
+   * rounding the write ratio up to the next one.
+   */
+  bool interpolate_mix_{false};
 
-  [[nodiscard]] const MixModel &SelectMixModel(double write_ratio) const {
+  [[nodiscard]] const Profile &GetProfile(OpType op) const {
+    return (op == OpType::kRead) ? read_ : write_;
+  }
+
+  [[nodiscard]] Blend SelectCurves(OpType op, ServerMode mode,
+                                   double write_ratio,
+                                   double fill_level) const {
+    Blend blend;
+
+    /* Read-only. */
+    if (op == OpType::kRead && mode == ServerMode::kRead) {
+      AddCurves(&blend, read_, 1.0, fill_level);
+      return blend;
+    }
+
+    /* Write-only. */
+    if (op == OpType::kWrite && mode == ServerMode::kWrite) {
+      AddCurves(&blend, write_, 1.0, fill_level);
+      return blend;
+    }
+
+    /* Read-write mixed. */
+    const auto mix = SelectMixModels(write_ratio);
+    AddCurves(&blend, *mix.lo, 1.0 - mix.hi_weight, fill_level);
+    if (mix.hi != nullptr) {
+      AddCurves(&blend, *mix.hi, mix.hi_weight, fill_level);
+    }
+    return blend;
+  }
+
+  /* Adds the curves of the profile around fill_level, interpolating between
+   * the two closest fill levels.
+   */
+  static void AddCurves(Blend *blend, const Profile &profile, double weight,
+                        double fill_level) {
+    const auto &fills = profile.fill_levels;
+    assert(!fills.empty());
+
+    const auto it = std::ranges::upper_bound(fills, fill_level);
+    if (it == fills.begin() || it == fills.end()) {
+      const auto idx = (it == fills.begin()) ? 0 : fills.size() - 1;
+      AddCurve(blend, &profile.curves[idx], weight);
+      return;
+    }
+
+    const auto hi = static_cast<size_t>(it - fills.begin());
+    const auto hi_weight =
+        (fill_level - fills[hi - 1]) / (fills[hi] - fills[hi - 1]);
+    AddCurve(blend, &profile.curves[hi - 1], weight * (1.0 - hi_weight));
+    AddCurve(blend, &profile.curves[hi], weight * hi_weight);
+  }
+
+  static void AddCurve(Blend *blend, const Curve *curve, double weight) {
+    if (weight <= 0.0) {
+      return;
+    }
+    assert(blend->num_curves < kMaxBlendCurves);
+    blend->curves.at(blend->num_curves) = curve;
+    blend->weights.at(blend->num_curves) = weight;
+    blend->num_curves++;
+  }
+
+  [[nodiscard]] MixSelection SelectMixModels(double write_ratio) const {
     if (mix_models_.empty()) {
       throw std::runtime_error("No mixed R/W models loaded");
     }
 
     // Clamp to sane range.
-    if (write_ratio < 0.0) {
-      write_ratio = 0.0;
+    write_ratio = std::clamp(write_ratio, 0.0, 1.0);
+
+    /* First model with a write ratio that is at least write_ratio. */
+    const auto cell = static_cast<size_t>(
+        write_ratio * static_cast<double>(kRatioGridSize));
+    auto idx = mix_grid_.at(cell);
+    if (idx < mix_models_.size() && mix_write_ratios_[idx] < write_ratio) {
+      idx++;
     }
-    if (write_ratio > 1.0) {
-      write_ratio = 1.0;
+
+    // If higher than all buckets, use the highest available bucket.
+    if (idx == mix_models_.size()) {
+      return {.lo = &mix_models_.back(), .hi = nullptr, .hi_weight = 0.0};
     }
 
     // Conservative selection: round up to the next available bucket.
-    for (const auto &m : mix_models_) {
-      if (write_ratio <= m.write_ratio_bucket) {
-        return m;
+    if (!interpolate_mix_ || idx == 0 ||
+        mix_write_ratios_[idx] == write_ratio) {
+      return {.lo = &mix_models_[idx], .hi = nullptr, .hi_weight = 0.0};
+    }
+
+    const auto lo_ratio = mix_write_ratios_[idx - 1];
+    const auto hi_ratio = mix_write_ratios_[idx];
+    return {.lo = &mix_models_[idx - 1],
+            .hi = &mix_models_[idx],
+            .hi_weight = (write_ratio - lo_ratio) / (hi_ratio - lo_ratio)};
+  }
+
+  /* Returns the models of the disk, which are loaded once and then shared by
+   * all the consumers in the process.
+   */
+  static Status<std::shared_ptr<const DiskModel>> GetShared(
+      const std::string &name) {
+    static rt::Mutex lock;
+    static std::unordered_map<std::string, std::shared_ptr<const DiskModel>>
+        models;
+
+    rt::MutexGuard g(lock);
+    if (auto it = models.find(name); it != models.end()) {
+      return it->second;
+    }
+
+    auto model = std::make_shared<DiskModel>();
+    if (!model->LoadModels(name)) {
+      return MakeError(EINVAL);
+    }
+    models.emplace(name, model);
+    return model;
+  }
+
+  /* Adds the curve of the disk with the given suffix (without the extension)
+   * to data. The curve is taken from the bundle of the disk if there is one,
+   * or else from its CSV model file.
+   */
+  static Status<Curve> LoadCurve(CurveData *data, const std::string &name,
+                                 std::string_view suffix) {
+    Curve curve{.grid_offset = data->load_grid.size()};
+
+    if (data->bundle) {
+      const auto *entry = data->bundle->Find(suffix);
+      if (entry == nullptr) {
+        return MakeError(ENOENT);
+      }
+      curve.offset = entry->offset;
+      curve.num_points = entry->num_points;
+    } else {
+      const auto fpath =
+          std::filesystem::path(Config::kSSDModelsDirPath /
+                                (name + std::string(suffix) +
+                                 std::string(kModelExtension)));
+      LoadLatency model;
+      try {
+        model = LoadModel(fpath);
+      } catch (...) {
+        return MakeError(ENOENT);
+      }
+      const auto &[load, latency] = model;
+      if (load.empty() || load.size() != latency.size()) {
+        return MakeError(EINVAL);
       }
+      curve.offset = data->owned_loads.size();
+      curve.num_points = load.size();
+      data->owned_loads.insert(data->owned_loads.end(), load.begin(),
+                               load.end());
+      data->owned_latencies.insert(data->owned_latencies.end(),
+                                   latency.begin(), latency.end());
     }
-    // If higher than all buckets, use the highest available bucket.
-    return mix_models_.back();
+
+    data->load_grid.resize(data->load_grid.size() + kGridSize);
+    data->latency_grid.resize(data->latency_grid.size() + kGridSize);
+    return curve;
   }
 
+  /* Loads the model with the given suffix along with its profiles at other
+   * fill levels (best-effort), which are named "<name>_<workload>_<pct>f.model"
+   * (e.g., "_1000w_80f.model" for writes at 80% fill).
+   */
+  static Status<Profile> LoadProfile(CurveData *data, const std::string &name,
+                                     std::string_view suffix) {
+    Profile profile;
+
+    const auto stem = suffix.substr(0, suffix.size() - kModelExtension.size());
+    auto curve = LoadCurve(data, name, stem);
+    if (!curve) {
+      return MakeError(curve);
+    }
+    profile.curves.push_back(*curve);
+    profile.fill_levels.push_back(0.0);
+
+    for (const auto pct : kFillLevelCandidates) {
+      const auto fill_stem =
+          std::string(stem) + "_" + std::to_string(pct) + "f";
+      curve = LoadCurve(data, name, fill_stem);
+      if (!curve) {
+        continue;
+      }
+      profile.curves.push_back(*curve);
+      profile.fill_levels.push_back(static_cast<double>(pct) / 100);
+    }
+
+    return profile;
+  }
+
+  /* Loads the models from the bundle of the disk ("<name>.bundle") if there
+   * is one, or else from its CSV model files.
+   */
   Status<void> LoadModels(const std::string &name) {
-    LoadLatency model;
+    auto data = std::make_shared<CurveData>();
+    auto bundle = ModelBundle::Open(Config::kSSDModelsDirPath /
+                                    (name + ModelBundle::kExtension));
+    if (bundle) {
+      LOG(DEBUG) << "Mapped model bundle for: " << name;
+      data->bundle = std::move(*bundle);
+    } else if (bundle.error() != ENOENT) {
+      LOG(WARN) << "Ignoring invalid model bundle for: " << name;
+    }
 
     /* Load read-only model. */
-    auto fname = name + kReadOnlyModelSuffix;
-    std::filesystem::path fpath(Config::kSSDModelsDirPath / fname);
-    try {
-      model = LoadModel(fpath);
-    } catch (...) {
-      return MakeError(EINVAL);
+    auto read = LoadProfile(data.get(), name, kReadOnlyModelSuffix);
+    if (!read) {
+      return MakeError(read);
     }
-    load_read_ = std::move(std::get<0>(model));
-    latency_read_ = std::move(std::get<1>(model));
+    read_ = std::move(*read);
 
     /* Load write-only model. */
-    fname = name + kWriteOnlyModelSuffix;
-    fpath = std::filesystem::path(Config::kSSDModelsDirPath / fname);
-    try {
-      model = LoadModel(fpath);
-    } catch (...) {
-      return MakeError(EINVAL);
+    auto write = LoadProfile(data.get(), name, kWriteOnlyModelSuffix);
+    if (!write) {
+      return MakeError(write);
     }
-    load_write_ = std::move(std::get<0>(model));
-    latency_write_ = std::move(std::get<1>(model));
+    write_ = std::move(*write);
 
     /* Load mixed models (best-effort). */
     mix_models_.clear();
+    mix_write_ratios_.clear();
     struct MixCandidate {
       double bucket;
       const char *suffix;
@@ -192,76 +559,94 @@ class DiskModel {
     };
 
     for (const auto &c : kMixCandidates) {
-      const auto fname = name + std::string(c.suffix);
-      const auto fpath = std::filesystem::path(Config::kSSDModelsDirPath / fname);
-      try {
-        model = LoadModel(fpath);
-      } catch (...) {
+      auto mix = LoadProfile(data.get(), name, c.suffix);
+      if (!mix) {
         continue;
       }
-      mix_models_.push_back(MixModel{
-          .write_ratio_bucket = c.bucket,
-          .load = std::move(std::get<0>(model)),
-          .latency = std::move(std::get<1>(model)),
-      });
+      mix_models_.push_back(std::move(*mix));
+      mix_write_ratios_.push_back(c.bucket);
     }
 
     if (mix_models_.empty()) {
       return MakeError(EINVAL);
     }
 
-    return {};
-  }
-
-  /* Expected format:
-   * Load,Latency
-   */
-  static LoadLatency LoadModel(const std::filesystem::path &fpath) {
-    LOG(DEBUG) << "Reading model: " << fpath;
-
-    std::ifstream f(fpath);
-    if (!f.is_open() || !f.good()) {
-      const std::string fpath_str(fpath);
-      throw std::runtime_error("Could not open model file: " + fpath_str);
+    size_t idx = 0;
+    for (size_t cell = 0; cell <= kRatioGridSize; cell++) {
+      const auto ratio =
+          static_cast<double>(cell) / static_cast<double>(kRatioGridSize);
+      while (idx < mix_write_ratios_.size() && mix_write_ratios_[idx] < ratio) {
+        idx++;
+      }
+      mix_grid_.at(cell) = idx;
     }
 
-    LoadLatency result;
-    uint64_t load = 0;
-    double lat = NAN;
-    std::string line;
-
-    /* Ignore the first line with headers. */
-    std::getline(f, line);
-
-    while (std::getline(f, line)) {
-      std::stringstream ss(line);
-      /* First item is load. */
-      ss >> load;
-      /* Ignore the comma. */
-      ss.ignore();
-      /* Second item is latency. */
-      ss >> lat;
-
-      std::get<0>(result).emplace_back(load);
-      std::get<1>(result).emplace_back(lat);
+    /* The points are in place now; index all curves. */
+    if (data->bundle) {
+      data->loads = data->bundle->loads();
+      data->latencies = data->bundle->latencies();
+    } else {
+      data->loads = data->owned_loads;
+      data->latencies = data->owned_latencies;
     }
+    for (auto *profile : {&read_, &write_}) {
+      for (auto &curve : profile->curves) {
+        Index(data.get(), &curve);
+      }
+    }
+    for (auto &profile : mix_models_) {
+      for (auto &curve : profile.curves) {
+        Index(data.get(), &curve);
+      }
+    }
+    data_ = std::move(data);
 
-    f.close();
+    return {};
+  }
 
-    return result;
+  /* (Re)builds the grids and the derived properties of the curve. */
+  static void Index(CurveData *data, Curve *curve) {
+    const auto load = data->loads.subspan(curve->offset, curve->num_points);
+    const auto latency =
+        data->latencies.subspan(curve->offset, curve->num_points);
+
+    curve->load_step = (load.back() / kGridSize) + 1;
+    curve->max_latency = *std::ranges::max_element(latency);
+    curve->latency_step = (curve->max_latency / kGridSize) + 1;
+    curve->peak_iops = GetPeakIOPS(load, latency);
+
+    size_t load_idx = 0;
+    size_t latency_idx = 0;
+    for (size_t cell = 0; cell < kGridSize; cell++) {
+      const auto cell_load = cell * curve->load_step;
+      while (load_idx < load.size() && load[load_idx] < cell_load) {
+        load_idx++;
+      }
+      data->load_grid[curve->grid_offset + cell] = load_idx;
+
+      /* First point above the cell's latency (loads are scanned in order, so
+       * this is non-decreasing even if the curve is not monotonic).
+       */
+      const auto cell_latency = cell * curve->latency_step;
+      while (latency_idx < latency.size() &&
+             latency[latency_idx] <= cell_latency) {
+        latency_idx++;
+      }
+      data->latency_grid[curve->grid_offset + cell] = latency_idx;
+    }
   }
 
-  static uint64_t GetPeakIOPS(const LoadValues *load,
-                              const LatencyValues *latency) {
-    assert(!load->empty());
-    assert(!latency->empty());
-    assert(load->size() == latency->size());
+  static uint64_t GetPeakIOPS(std::span<const uint64_t> load,
+                              std::span<const uint64_t> latency) {
+    assert(!load.empty());
+    assert(!latency.empty());
+    assert(load.size() == latency.size());
 
     // Choose the largest load with latency still below saturation.
-    uint64_t ret = load->back();
-    for (size_t i = 0; i < load->size(); i++) {
-      if (latency->at(i) >= kSaturationLatencyUs) {
-        ret = (i == 0) ? 0 : load->at(i - 1);
+    uint64_t ret = load.back();
+    for (size_t i = 0; i < load.size(); i++) {
+      if (latency[i] >= kSaturationLatencyUs) {
+        ret = (i == 0) ? 0 : load[i - 1];
         break;
       }
     }
@@ -270,48 +655,94 @@ class DiskModel {
     return static_cast<uint64_t>(dampened_load);
   }
 
-  static uint64_t GetLatency(uint64_t cur_load, const LoadValues *load,
-                             const LatencyValues *latency) {
-    assert(!load->empty());
-    assert(!latency->empty());
-    assert(load->size() == latency->size());
+  /* Latency of a single curve (without truncation or clamping). */
+  [[nodiscard]] double GetLatencyUs(uint64_t cur_load,
+                                    const Curve &curve) const {
+    assert(curve.num_points > 0);
+    const auto *load = &data_->loads[curve.offset];
+    const auto *latency = &data_->latencies[curve.offset];
 
     /* Start by assuming we are at saturation unless we find a better latency
      * point based on the offered load.
      */
-    size_t idx = load->size();
-    for (size_t i = 0; i < load->size(); i++) {
-      if (load->at(i) >= cur_load) {
-        idx = i;
-        break;
-      }
-    }
-
-    uint64_t cur_latency = 0;
-    if (idx == load->size()) {
+    if (cur_load > load[curve.num_points - 1]) {
       // If offered load exceeds the modeled range, clamp to saturation instead
       // of blowing up. This avoids destabilizing feedback in scheduling.
-      cur_latency = kSaturationLatencyPenaltyUs;
-    } else if (idx == 0) {
-      cur_latency = latency->at(idx);
-    } else {
-      /* Interpolate. */
-      const auto start_load = load->at(idx - 1);
-      const auto end_load = load->at(idx);
-      const auto load_range = static_cast<double>(end_load - start_load);
-      const auto cur_load_diff = static_cast<double>(cur_load - start_load);
-      const auto cur_pct = cur_load_diff / load_range;
-      const auto start_latency = latency->at(idx - 1);
-      const auto end_latency = latency->at(idx);
-      const auto latency_range =
-          static_cast<double>(end_latency - start_latency);
-      const auto latency_delta = static_cast<uint64_t>(latency_range * cur_pct);
-      cur_latency = start_latency + latency_delta;
+      return kSaturationLatencyPenaltyUs;
     }
 
+    /* First point with a load that is at least the offered load. */
+    auto idx =
+        data_->load_grid[curve.grid_offset + (cur_load / curve.load_step)];
+    while (load[idx] < cur_load) {
+      idx++;
+    }
+
+    if (idx == 0) {
+      return static_cast<double>(latency[idx]);
+    }
+
+    /* Interpolate. */
+    const auto start_load = load[idx - 1];
+    const auto end_load = load[idx];
+    const auto load_range = static_cast<double>(end_load - start_load);
+    const auto cur_load_diff = static_cast<double>(cur_load - start_load);
+    const auto cur_pct = cur_load_diff / load_range;
+    const auto start_latency = static_cast<double>(latency[idx - 1]);
+    const auto end_latency = static_cast<double>(latency[idx]);
+    return start_latency + (end_latency - start_latency) * cur_pct;
+  }
+
+  [[nodiscard]] uint64_t GetLatency(uint64_t cur_load,
+                                    const Curve &curve) const {
     // Never return above saturation. The disk model is used as a control signal;
     // clamping prevents extreme/unstable weight swings when close to the knee.
-    return std::min<uint64_t>(cur_latency, kSaturationLatencyPenaltyUs);
+    return std::min<uint64_t>(
+        static_cast<uint64_t>(GetLatencyUs(cur_load, curve)),
+        kSaturationLatencyPenaltyUs);
+  }
+
+  [[nodiscard]] double GetLatencyUs(uint64_t cur_load,
+                                    const Blend &blend) const {
+    double latency = 0.0;
+    for (size_t i = 0; i < blend.num_curves; i++) {
+      latency += blend.weights[i] * GetLatencyUs(cur_load, *blend.curves[i]);
+    }
+    return latency;
+  }
+
+  [[nodiscard]] double GetLoad(double target_latency,
+                               const Curve &curve) const {
+    assert(curve.num_points > 0);
+    const auto *load = &data_->loads[curve.offset];
+    const auto *latency = &data_->latencies[curve.offset];
+
+    /* Latency is flat at its first point for loads below the first point. */
+    if (static_cast<double>(latency[0]) > target_latency) {
+      return 0.0;
+    }
+
+    /* Beyond the modeled range the latency is clamped to saturation. */
+    if (target_latency >= static_cast<double>(curve.max_latency)) {
+      return static_cast<double>(load[curve.num_points - 1]);
+    }
+
+    /* First point with a latency above the target. */
+    const auto cell = static_cast<size_t>(
+        target_latency / static_cast<double>(curve.latency_step));
+    auto idx = data_->latency_grid[curve.grid_offset + cell];
+    while (static_cast<double>(latency[idx]) <= target_latency) {
+      idx++;
+    }
+
+    /* Interpolate within the segment that crosses the target. */
+    const auto start_latency = static_cast<double>(latency[idx - 1]);
+    const auto end_latency = static_cast<double>(latency[idx]);
+    const auto start_load = static_cast<double>(load[idx - 1]);
+    const auto end_load = static_cast<double>(load[idx]);
+    const auto cur_pct =
+        (target_latency - start_latency) / (end_latency - start_latency);
+    return start_load + (end_load - start_load) * cur_pct;
   }
 };
 
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/io_desc.h"
+#include "sandook/base/server_stats.h"
+#include "sandook/bindings/sync.h"
+#include "sandook/disk_model/disk_model.h"
+
+namespace sandook {
+
+/* Refines the profiled (offline) model of a disk from its live stats.
+ *
+ * The load range of each pure read/write curve is split into kNumBins bins.
+ * Every observation of a server in a pure mode updates an EWMA of the ratio
+ * between the observed tail latency and the one predicted by the profile, in
+ * the bin of the observed load. The refined model scales the profile by each
+ * bin's ratio, weighted by the confidence of that bin (number of
+ * observations, saturating at kMinSamples), so bins with few observations
+ * stay close to the profile.
+ *
+ * Only pure curves are refined: the disk server reports p99 latencies, which
+ * is what the pure curves are profiled from (mixed curves use p90).
+ */
+class DiskModelLearner {
+ public:
+  constexpr static size_t kNumBins = 32;
+  /* Smoothing of the per-bin correction. */
+  constexpr static auto kAlpha = 0.05;
+  /* Observations after which a bin is fully trusted. */
+  constexpr static uint64_t kMinSamples = 100;
+  /* Bounds on the correction to guard against outliers. */
+  constexpr static auto kMinCorrection = 0.5;
+  constexpr static auto kMaxCorrection = 4.0;
+
+  explicit DiskModelLearner(DiskModel base) : base_(std::move(base)) {}
+  ~DiskModelLearner() = default;
+
+  /* No copying. */
+  DiskModelLearner(const DiskModelLearner &) = delete;
+  DiskModelLearner &operator=(const DiskModelLearner &) = delete;
+
+  /* No moving. */
+  DiskModelLearner(DiskModelLearner &&) noexcept;
+  DiskModelLearner &operator=(DiskModelLearner &&) noexcept;
+
+  void Observe(const ServerStats &stats) {
+    const auto load = (stats.read_mops + stats.write_mops) * kMillion;
+
+    if (stats.mode == ServerMode::kRead && stats.completed_reads > 0) {
+      Observe(OpType::kRead, load, stats.fill_level, stats.signal_read_latency);
+    } else if (stats.mode == ServerMode::kWrite &&
+               stats.completed_writes > 0) {
+      Observe(OpType::kWrite, load, stats.fill_level,
+              stats.signal_write_latency);
+    }
+  }
+
+  /* Returns the profiled model refined with the observations so far. */
+  [[nodiscard]] DiskModel GetModel() {
+    auto model = base_;
+
+    rt::SpinGuard g(lock_);
+    for (const auto op : {OpType::kRead, OpType::kWrite}) {
+      const auto &bins = GetBins(op);
+      const auto max_load = base_.GetMaxLoad(op);
+      model.ScaleLatency(op, [&](uint64_t load) {
+        const auto &bin = bins.at(GetBin(static_cast<double>(load), max_load));
+        const auto confidence =
+            std::min(static_cast<double>(bin.samples) / kMinSamples, 1.0);
+        return 1.0 + confidence * (bin.correction - 1.0);
+      });
+    }
+
+    return model;
+  }
+
+ private:
+  struct Bin {
+    double correction{1.0};
+    uint64_t samples{0};
+  };
+  using Bins = std::array<Bin, kNumBins>;
+
+  /* Profiled model. */
+  const DiskModel base_;
+
+  rt::Spin lock_;
+  Bins read_bins_;
+  Bins write_bins_;
+
+  [[nodiscard]] Bins &GetBins(OpType op) {
+    return (op == OpType::kRead) ? read_bins_ : write_bins_;
+  }
+
+  [[nodiscard]] static size_t GetBin(double load, uint64_t max_load) {
+    const auto bin = static_cast<size_t>(load * kNumBins /
+                                         static_cast<double>(max_load + 1));
+    return std::min(bin, kNumBins - 1);
+  }
+
+  void Observe(OpType op, double load, double fill_level, uint64_t latency) {
+    const auto max_load = base_.GetMaxLoad(op);
+
+    /* Nothing to learn without a signal or beyond the profiled range (where
+     * the model is clamped to saturation).
+     */
+    if (latency == 0 || load <= 0.0 || load > static_cast<double>(max_load)) {
+      return;
+    }
+
+    const auto mode = (op == OpType::kRead) ? ServerMode::kRead
+                                            : ServerMode::kWrite;
+    const auto write_ratio = (op == OpType::kRead) ? 0.0 : 1.0;
+    const auto expected = std::max<uint64_t>(
+        base_.GetLatency(static_cast<uint64_t>(load), op, mode, write_ratio,
+                         fill_level),
+        1);
+    const auto ratio =
+        std::clamp(static_cast<double>(latency) / static_cast<double>(expected),
+                   kMinCorrection, kMaxCorrection);
+
+    rt::SpinGuard g(lock_);
+    auto &bin = GetBins(op).at(GetBin(load, max_load));
+    bin.correction += kAlpha * (ratio - bin.correction);
+    bin.samples++;
+  }
+};
+
+}  // namespace sandook
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sandook/base/error.h"
+
+namespace sandook {
+
+/* Binary bundle of all the profiled curves of one disk, which replaces its
+ * CSV model files.
+ *
+ * Layout (native byte order, every field 8-byte aligned):
+ *   Header
+ *   Entry[num_curves]
+ *   uint64_t loads[num_points]
+ *   uint64_t latencies[num_points]
+ *
+ * The checksum (64-bit FNV-1a) covers everything after the header. Bundles
+ * are mapped read-only and their points are used in place.
+ */
+class ModelBundle {
+ public:
+  constexpr static uint32_t kMagic = 0x4d4b4453;  // "SDKM"
+  constexpr static uint32_t kVersion = 1;
+  constexpr static auto kExtension = ".bundle";
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_curves;
+    uint64_t num_points;
+    uint64_t checksum;
+  };
+
+  /* Maximum length of the suffix that identifies a curve. */
+  constexpr static size_t kMaxSuffixLen = 31;
+
+  /* A curve of the bundle, identified by the suffix of the name of the CSV
+   * file it was converted from without the extension (e.g., "_1000w_80f").
+   */
+  struct Entry {
+    std::array<char, kMaxSuffixLen + 1> suffix;
+    uint64_t offset;
+    uint64_t num_points;
+  };
+
+  /* A curve to write into a bundle. */
+  struct Curve {
+    std::string_view suffix;
+    std::span<const uint64_t> loads;
+    std::span<const uint64_t> latencies;
+  };
+
+  ~ModelBundle() { munmap(addr_, len_); }
+
+  /* No copying. */
+  ModelBundle(const ModelBundle &) = delete;
+  ModelBundle &operator=(const ModelBundle &) = delete;
+
+  /* No moving. */
+  ModelBundle(ModelBundle &&) noexcept;
+  ModelBundle &operator=(ModelBundle &&) noexcept;
+
+  /* Maps the bundle and validates it. */
+  static Status<std::shared_ptr<const ModelBundle>> Open(
+      const std::filesystem::path &fpath) {
+    const int fd = open(fpath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return MakeError(errno);
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+      const auto err = errno;
+      close(fd);
+      return MakeError(err);
+    }
+    const auto len = static_cast<size_t>(st.st_size);
+    if (len < sizeof(Header)) {
+      close(fd);
+      return MakeError(EINVAL);
+    }
+
+    void *addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      return MakeError(errno);
+    }
+
+    std::shared_ptr<const ModelBundle> bundle(new ModelBundle(addr, len));
+    if (!bundle->IsValid()) {
+      return MakeError(EINVAL);
+    }
+    return bundle;
+  }
+
+  /* Writes the curves into a new bundle (atomically replacing fpath). */
+  static Status<void> Write(const std::filesystem::path &fpath,
+                            std::span<const Curve> curves) {
+    std::vector<Entry> entries;
+    std::vector<uint64_t> loads;
+    std::vector<uint64_t> latencies;
+    for (const auto &curve : curves) {
+      if (curve.suffix.size() > kMaxSuffixLen || curve.loads.empty() ||
+          curve.loads.size() != curve.latencies.size()) {
+        return MakeError(EINVAL);
+      }
+      Entry entry{.suffix = {},
+                  .offset = loads.size(),
+                  .num_points = curve.loads.size()};
+      std::ranges::copy(curve.suffix, entry.suffix.begin());
+      entries.push_back(entry);
+      loads.insert(loads.end(), curve.loads.begin(), curve.loads.end());
+      latencies.insert(latencies.end(), curve.latencies.begin(),
+                       curve.latencies.end());
+    }
+
+    const auto payload = std::as_bytes(std::span(entries));
+    const auto load_bytes = std::as_bytes(std::span(loads));
+    const auto latency_bytes = std::as_bytes(std::span(latencies));
+    auto checksum = kChecksumSeed;
+    checksum = Checksum(payload, checksum);
+    checksum = Checksum(load_bytes, checksum);
+    checksum = Checksum(latency_bytes, checksum);
+
+    const Header header{.magic = kMagic,
+                        .version = kVersion,
+                        .num_curves = entries.size(),
+                        .num_points = loads.size(),
+                        .checksum = checksum};
+
+    auto tmp_path = fpath;
+    tmp_path += ".tmp";
+    std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!f.is_open()) {
+      return MakeError(EIO);
+    }
+    const auto write = [&f](std::span<const std::byte> bytes) {
+      f.write(reinterpret_cast<const char *>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+    };
+    write(std::as_bytes(std::span(&header, 1)));
+    write(payload);
+    write(load_bytes);
+    write(latency_bytes);
+    f.close();
+    if (!f) {
+      return MakeError(EIO);
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, fpath, ec);
+    if (ec) {
+      return MakeError(ec.value());
+    }
+    return {};
+  }
+
+  [[nodiscard]] std::span<const Entry> entries() const {
+    return {reinterpret_cast<const Entry *>(header() + 1),
+            header()->num_curves};
+  }
+
+  /* Returns the curve with the given suffix (nullptr if there is none). */
+  [[nodiscard]] const Entry *Find(std::string_view suffix) const {
+    for (const auto &entry : entries()) {
+      if (suffix == entry.suffix.data()) {
+        return &entry;
+      }
+    }
+    return nullptr;
+  }
+
+  [[nodiscard]] std::span<const uint64_t> loads() const {
+    const auto curves = entries();
+    return {reinterpret_cast<const uint64_t *>(curves.data() + curves.size()),
+            header()->num_points};
+  }
+
+  [[nodiscard]] std::span<const uint64_t> latencies() const {
+    const auto points = loads();
+    return {points.data() + points.size(), points.size()};
+  }
+
+ private:
+  constexpr static uint64_t kChecksumSeed = 0xcbf29ce484222325;
+  constexpr static uint64_t kChecksumPrime = 0x100000001b3;
+
+  void *addr_;
+  size_t len_;
+
+  ModelBundle(void *addr, size_t len) : addr_(addr), len_(len) {}
+
+  [[nodiscard]] const Header *header() const {
+    return static_cast<const Header *>(addr_);
+  }
+
+  static uint64_t Checksum(std::span<const std::byte> bytes, uint64_t hash) {
+    for (const auto b : bytes) {
+      hash ^= static_cast<uint64_t>(b);
+      hash *= kChecksumPrime;
+    }
+    return hash;
+  }
+
+  [[nodiscard]] bool IsValid() const {
+    const auto *hdr = header();
+    if (hdr->magic != kMagic || hdr->version != kVersion) {
+      return false;
+    }
+
+    /* Guard the size computation below against overflows. */
+    const auto max_entries = len_ / sizeof(Entry);
+    const auto max_points = len_ / (2 * sizeof(uint64_t));
+    if (hdr->num_curves > max_entries || hdr->num_points > max_points) {
+      return false;
+    }
+    const auto payload_len = (hdr->num_curves * sizeof(Entry)) +
+                             (2 * hdr->num_points * sizeof(uint64_t));
+    if (len_ != sizeof(Header) + payload_len) {
+      return false;
+    }
+
+    for (const auto &entry : entries()) {
+      if (entry.suffix.back() != '\0' || entry.num_points == 0 ||
+          entry.offset > hdr->num_points ||
+          entry.num_points > hdr->num_points - entry.offset) {
+        return false;
+      }
+    }
+
+    const auto payload = std::span(
+        static_cast<const std::byte *>(addr_) + sizeof(Header), payload_len);
+    return Checksum(payload, kChecksumSeed) == hdr->checksum;
+  }
+};
+
+}  // namespace sandook
@@ -106,15 +106,15 @@ Status<int> BlkServer::HandleStorageOp(const StorageOpMsg *msg,
     } break;
 
     case OpType::kWrite: {
-      const auto start_time = hook_write_started();
+      const auto start_time = hook_write_started(iod->num_sectors);
       const auto ret = HandleWrite(offset, len, req_payload);
       if (unlikely(!ret)) {
         static const auto success = false;
-        hook_write_completed(start_time, success);
+        hook_write_completed(start_time, iod->num_sectors, success);
         return MakeError(ret);
       }
       static const auto success = true;
-      hook_write_completed(start_time, success);
+      hook_write_completed(start_time, iod->num_sectors, success);
       result = *ret;
     } break;
 
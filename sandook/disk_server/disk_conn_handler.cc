@@ -1,6 +1,7 @@
 #include "sandook/disk_server/disk_conn_handler.h"
 
 #include <cassert>
+#include <cerrno>
 #include <cstddef>
 #include <cstring>
 #include <memory>
@@ -50,7 +51,7 @@ Status<RPCReturnBuffer> DiskConnHandler::HandleDiscardBlocks(
 
   auto* it_start = msg->blocks.begin();
   auto* it_end = msg->blocks.begin() + msg->num_blocks;
-  const auto ret = server_->HandleDiscardBlocks({it_start, it_end});
+  const auto ret = server_->SubmitDiscardBlocks({it_start, it_end});
   if (!ret) {
     LOG(ERR) << "Cannot discard " << msg->num_blocks << " blocks";
   }
@@ -90,8 +91,12 @@ Status<RPCReturnBuffer> DiskConnHandler::HandleStorageOp(
 
   /* Handle the request and fill the reply payload (if applicable). */
   const auto ret =
-      server_->HandleStorageOp(msg, req_payload.view(), reply_payload.view());
+      server_->SubmitStorageOp(msg, req_payload.view(), reply_payload.view());
   if (!ret) {
+    /* Could not be admitted to the device in time. */
+    if (ret.error() == EBUSY) {
+      return RejectStorageOp(msg, StorageOpReplyCode::kRejectDeviceBusy);
+    }
     return MakeError(ret);
   }
 
@@ -114,9 +119,7 @@ Status<RPCReturnBuffer> DiskConnHandler::HandleStorageOp(
 
 Status<RPCReturnBuffer> DiskConnHandler::RejectStorageOp(
     StorageOpMsg* msg, StorageOpReplyCode code) const {
-  auto op = IODesc::get_op(&msg->iod);
-
-  server_->HandleRejection(op);
+  server_->HandleRejection(&msg->iod);
 
   static const auto reply_payload_size = 0;
   static const auto ret = 0;
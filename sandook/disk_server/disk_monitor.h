@@ -1,19 +1,23 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstdint>
 #include <cstdlib>
-#include <vector>
+#include <limits>
+#include <string>
 
 #include "base/compiler.h"
-#include "lib/tdigest/TDigest.h"
+#include "lib/ewma/Ewma.h"
 #include "sandook/base/constants.h"
 #include "sandook/base/counter.h"
+#include "sandook/base/histogram.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/time.h"
 #include "sandook/base/types.h"
 #include "sandook/bindings/log.h"
+#include "sandook/bindings/sync.h"
 #include "sandook/bindings/thread.h"
 #include "sandook/bindings/timer.h"
 #include "sandook/disk_model/disk_model.h"
@@ -25,7 +29,6 @@ constexpr static double kLoadScaleFactor =
     static_cast<double>(kOneSecond) /
     static_cast<double>(kLoadCalculationIntervalUs);
 
-constexpr static auto kMaxBufferEntries = 1UZ << 22;
 constexpr static auto kFlushIntervalUs = 10 * kOneMilliSecond;
 static_assert(kFlushIntervalUs * 2 <= kCongestionControlWindowUs,
               "DiskServer flush interval must be lower than half of CC window");
@@ -44,19 +47,32 @@ constexpr static auto kMinExpectedLatencyUs = 1.0;
 constexpr static auto kCongestedUnstableFactor = 0.7;
 constexpr static auto kCongestedStableFactor = 0.9;
 
+/* Fast congestion detection, which reacts within a few hundred microseconds
+ * (e.g., to a GC stall) instead of waiting for the next flush. It only marks
+ * replies as congested and never drives the congestion state machine.
+ */
+constexpr static auto kFastCongestionHoldUs = 500 * kOneMicroSecond;
+/* Smoothing of the per-core latency (per completion) and inflight depth (per
+ * submission and completion) averages.
+ */
+constexpr static auto kFastCongestionLatencyAlpha = 0.125;
+constexpr static auto kFastCongestionDepthAlpha = 0.03125;
+/* Trigger if the average latency exceeds the model's expected tail latency by
+ * this factor, or the average depth (in requests, however many sectors each
+ * writes) exceeds the depth expected by Little's law by this factor (and is at
+ * least kFastCongestionMinDepth).
+ */
+constexpr static auto kFastCongestionLatencyRatioThreshold = 2.0;
+constexpr static auto kFastCongestionDepthRatioThreshold = 4.0;
+constexpr static auto kFastCongestionMinDepth = 32.0;
+
 // NOLINTBEGIN(clang-analyzer-optin.performance.Padding)
 class DiskMonitor {
  public:
-  explicit DiskMonitor() : th_logger_([this]() { Logger(); }) {
-    r_buf_active_.resize(kMaxBufferEntries);
-    r_buf_inactive_.resize(kMaxBufferEntries);
-    w_buf_active_.resize(kMaxBufferEntries);
-    w_buf_inactive_.resize(kMaxBufferEntries);
-
-    // Since it depends on r_buf & w_buf, we must construct it after them.
-    th_flusher_ = rt::Thread([this]() { Flusher(); });
-    th_load_calculator_ = rt::Thread([this]() { LoadCalculator(); });
-  }
+  explicit DiskMonitor()
+      : th_flusher_([this]() { Flusher(); }),
+        th_load_calculator_([this]() { LoadCalculator(); }),
+        th_logger_([this]() { Logger(); }) {}
 
   ~DiskMonitor() {
     stop_ = true;
@@ -94,6 +110,7 @@ class DiskMonitor {
     is_rejections_enabled_ = is_rejections_enabled;
     assert(!name_.empty());
     model_ = DiskModel(name_);
+    is_model_loaded_ = true;
   }
 
   void SetDiskPeakIOPS(uint64_t read_iops, uint64_t write_iops,
@@ -137,12 +154,14 @@ class DiskMonitor {
 
   uint64_t ReadStarted() {
     inflight_reads_.inc_local();
+    UpdateFastDepth(inflight_requests_.fetch_add(1) + 1);
     return MicroTime();
   }
 
   void ReadCompleted(uint64_t start_time, bool success) {
     auto duration_us = MicroTime() - start_time;
     inflight_reads_.dec_local();
+    UpdateFastDepth(inflight_requests_.fetch_sub(1) - 1);
     disk_reads_.inc_local();
 
     if (success) {
@@ -159,48 +178,40 @@ class DiskMonitor {
       failed_reads_.inc_local();
     }
 
-    // Intentionally being (safely!) racy below for better scalability.
-    auto idx = r_buf_idx_++;
-    if (unlikely(idx >= kMaxBufferEntries)) {
-      LOG(WARN) << "Buffer is full" << '\n';
-      return;
-    }
-
-    r_buf_active_[idx] = duration_us;
+    read_latencies_.Record(duration_us);
+    UpdateFastLatency(OpType::kRead, duration_us);
   }
 
-  uint64_t WriteStarted() {
-    inflight_writes_.inc_local();
+  /* Writes are counted in sectors, as a request may write a run of them. */
+  uint64_t WriteStarted(uint32_t num_sectors) {
+    inflight_writes_.inc_local(num_sectors);
+    UpdateFastDepth(inflight_requests_.fetch_add(1) + 1);
     return MicroTime();
   }
 
-  void WriteCompleted(uint64_t start_time, bool success) {
+  void WriteCompleted(uint64_t start_time, uint32_t num_sectors,
+                      bool success) {
     auto duration_us = MicroTime() - start_time;
-    inflight_writes_.dec_local();
-    disk_writes_.inc_local();
+    inflight_writes_.dec_local(num_sectors);
+    UpdateFastDepth(inflight_requests_.fetch_sub(1) - 1);
+    disk_writes_.inc_local(num_sectors);
 
     if (success) {
-      completed_writes_.inc_local();
+      completed_writes_.inc_local(num_sectors);
       if (mode_ == ServerMode::kWrite) {
-        pure_writes_.inc_local();
+        pure_writes_.inc_local(num_sectors);
       } else if (mode_ == ServerMode::kRead) {
-        impure_writes_.inc_local();
+        impure_writes_.inc_local(num_sectors);
       } else {
-        mixed_writes_.inc_local();
+        mixed_writes_.inc_local(num_sectors);
       }
     } else {
-      total_failed_writes_.inc_local();
-      failed_writes_.inc_local();
-    }
-
-    // Intentionally being (safely!) racy below for better scalability.
-    auto idx = w_buf_idx_++;
-    if (unlikely(idx >= kMaxBufferEntries)) {
-      LOG(WARN) << "Buffer is full" << '\n';
-      return;
+      total_failed_writes_.inc_local(num_sectors);
+      failed_writes_.inc_local(num_sectors);
     }
 
-    w_buf_active_[idx] = duration_us;
+    write_latencies_.Record(duration_us);
+    UpdateFastLatency(OpType::kWrite, duration_us);
   }
 
   void SetModeAndWeights(ServerMode mode, ServerWeight read_weight,
@@ -215,16 +226,30 @@ class DiskMonitor {
 
   [[nodiscard]] ServerMode GetMode() const { return mode_; }
 
+  [[nodiscard]] const DiskModel &GetModel() const { return model_; }
+
   [[nodiscard]] bool IsModeSwitchGracePeriod() const {
     const auto time_since_mode_switch_us_ = MicroTime() - mode_switch_time_us_;
     return time_since_mode_switch_us_ <= kDiskServerModeSwitchGracePeriodUs;
   }
 
   void ReadRejected() { rejected_reads_.inc_local(); }
-  void WriteRejected() { rejected_writes_.inc_local(); }
+  void WriteRejected(uint32_t num_sectors) {
+    rejected_writes_.inc_local(num_sectors);
+  }
 
   [[nodiscard]] bool IsCongested() const {
-    return congestion_state_ == ServerCongestionState::kCongested;
+    return congestion_state_ == ServerCongestionState::kCongested ||
+           IsFastCongested();
+  }
+
+  [[nodiscard]] bool IsFastCongested() const {
+    return MicroTime() < fast_congested_until_us_ &&
+           !IsModeSwitchGracePeriod();
+  }
+
+  [[nodiscard]] ServerCongestionState GetCongestionState() const {
+    return congestion_state_;
   }
 
   [[nodiscard]] bool IsAllowingWrites() const {
@@ -236,14 +261,11 @@ class DiskMonitor {
   std::string name_;
   bool is_rejections_enabled_{false};
   DiskModel model_;
+  bool is_model_loaded_{false};
 
-  std::atomic_size_t r_buf_idx_{0};
-  std::vector<uint64_t> r_buf_active_;
-  std::vector<uint64_t> r_buf_inactive_;
-
-  std::atomic_size_t w_buf_idx_{0};
-  std::vector<uint64_t> w_buf_active_;
-  std::vector<uint64_t> w_buf_inactive_;
+  /* Latencies (in us) of completed requests since the last flush. */
+  LatencyHistogram read_latencies_;
+  LatencyHistogram write_latencies_;
 
   /* Disk properties. */
   uint64_t peak_read_iops_{std::numeric_limits<uint64_t>::max()};
@@ -309,8 +331,21 @@ class DiskMonitor {
   uint64_t state_transition_write_latency_{0};
   double signal_ratio_{0.0};
   double state_transition_ratio_{0.0};
-  tdigest::TDigest td_reads_;
-  tdigest::TDigest td_writes_;
+
+  /* Fast congestion detection. */
+  struct alignas(kCacheLineSizeBytes) CoreSignals {
+    Ewma read{kFastCongestionLatencyAlpha};
+    Ewma write{kFastCongestionLatencyAlpha};
+    Ewma depth{kFastCongestionDepthAlpha};
+  };
+  std::array<CoreSignals, kMaxNumCores> core_signals_;
+  /* Requests (not sectors) issued to the disk and not completed yet. */
+  std::atomic_int64_t inflight_requests_{0};
+  /* Thresholds derived from the model; refreshed on every flush. */
+  double fast_read_threshold_us_{std::numeric_limits<double>::max()};
+  double fast_write_threshold_us_{std::numeric_limits<double>::max()};
+  double fast_depth_threshold_{std::numeric_limits<double>::max()};
+  uint64_t fast_congested_until_us_{0};
 
   uint64_t last_stats_us_{0};
   rt::Thread th_flusher_;
@@ -343,39 +378,21 @@ class DiskMonitor {
   }
 
   void FlushReads() {
-    size_t buf_idx = 0;
-    buf_idx = r_buf_idx_.exchange(buf_idx);
-    buf_idx = std::min(buf_idx, kMaxBufferEntries);
-    r_buf_active_.swap(r_buf_inactive_);
-
-    td_reads_ = tdigest::TDigest();
-    for (size_t i = 0; i < buf_idx; i++) {
-      const auto lat = r_buf_inactive_[i];
-      td_reads_.add(lat);
-    }
+    const auto hist = read_latencies_.Collect();
 
-    median_read_latency_td_ = td_reads_.quantile(kP50);
-    p90_read_latency_td_ = td_reads_.quantile(kP90);
-    p99_read_latency_td_ = td_reads_.quantile(kP99);
+    median_read_latency_td_ = hist.Quantile(kP50);
+    p90_read_latency_td_ = hist.Quantile(kP90);
+    p99_read_latency_td_ = hist.Quantile(kP99);
 
     signal_read_latency_ = p99_read_latency_td_;
   }
 
   void FlushWrites() {
-    size_t buf_idx = 0;
-    buf_idx = w_buf_idx_.exchange(buf_idx);
-    buf_idx = std::min(buf_idx, kMaxBufferEntries);
-    w_buf_active_.swap(w_buf_inactive_);
-
-    td_writes_ = tdigest::TDigest();
-    for (size_t i = 0; i < buf_idx; i++) {
-      const auto lat = w_buf_inactive_[i];
-      td_writes_.add(lat);
-    }
+    const auto hist = write_latencies_.Collect();
 
-    median_write_latency_td_ = td_writes_.quantile(kP50);
-    p90_write_latency_td_ = td_writes_.quantile(kP90);
-    p99_write_latency_td_ = td_writes_.quantile(kP99);
+    median_write_latency_td_ = hist.Quantile(kP50);
+    p90_write_latency_td_ = hist.Quantile(kP90);
+    p99_write_latency_td_ = hist.Quantile(kP99);
 
     signal_write_latency_ = p99_write_latency_td_;
   }
@@ -391,6 +408,7 @@ class DiskMonitor {
     while (!stop_) {
       rt::Sleep(interval);
       Flush();
+      UpdateFastThresholds();
       UpdateCongestionState();
     }
   }
@@ -424,6 +442,65 @@ class DiskMonitor {
     }
   }
 
+  void UpdateFastLatency(OpType op, uint64_t duration_us) {
+    const auto lat = static_cast<double>(duration_us);
+
+    rt::Preempt p;
+    rt::PreemptGuard g(p);
+
+    auto &core = core_signals_[p.get_cpu()];
+    const auto avg = (op == OpType::kRead) ? core.read.filter(lat)
+                                           : core.write.filter(lat);
+    const auto threshold = (op == OpType::kRead) ? fast_read_threshold_us_
+                                                 : fast_write_threshold_us_;
+    if (unlikely(avg > threshold)) {
+      fast_congested_until_us_ = MicroTime() + kFastCongestionHoldUs;
+    }
+  }
+
+  void UpdateFastDepth(int64_t depth) {
+    rt::Preempt p;
+    rt::PreemptGuard g(p);
+
+    auto &core = core_signals_[p.get_cpu()];
+    if (unlikely(core.depth.filter(static_cast<double>(depth)) >
+                 fast_depth_threshold_)) {
+      fast_congested_until_us_ = MicroTime() + kFastCongestionHoldUs;
+    }
+  }
+
+  /* Expected latency of requests of the op at the current load and mode. */
+  [[nodiscard]] double GetExpectedLatency(OpType op) const {
+    return static_cast<double>(std::max<uint64_t>(
+        model_.GetLatency(total_load_ops_, op, mode_, write_ratio_),
+        static_cast<uint64_t>(kMinExpectedLatencyUs)));
+  }
+
+  /* Independent of whether rejections are enabled, as replies are marked as
+   * congested regardless.
+   */
+  void UpdateFastThresholds() {
+    if (!is_model_loaded_) {
+      return;
+    }
+
+    const auto exp_read_lat = GetExpectedLatency(OpType::kRead);
+    const auto exp_write_lat = GetExpectedLatency(OpType::kWrite);
+    fast_read_threshold_us_ =
+        exp_read_lat * kFastCongestionLatencyRatioThreshold;
+    fast_write_threshold_us_ =
+        exp_write_lat * kFastCongestionLatencyRatioThreshold;
+
+    /* Little's law: depth = throughput * latency. */
+    const auto exp_lat =
+        (1.0 - write_ratio_) * exp_read_lat + write_ratio_ * exp_write_lat;
+    const auto exp_depth = static_cast<double>(total_load_ops_) * exp_lat /
+                           static_cast<double>(kOneSecond);
+    fast_depth_threshold_ =
+        std::max(exp_depth * kFastCongestionDepthRatioThreshold,
+                 kFastCongestionMinDepth);
+  }
+
   void UpdateCongestionState() {
     if (!is_rejections_enabled_) {
       return;
@@ -441,12 +518,8 @@ class DiskMonitor {
      *   pure read/write models are generated from p99.
      * - Consider both reads and writes, since either can be the bottleneck.
      */
-    const auto exp_read_lat = static_cast<double>(std::max<uint64_t>(
-        model_.GetLatency(total_load_ops_, OpType::kRead, mode_, write_ratio_),
-        static_cast<uint64_t>(kMinExpectedLatencyUs)));
-    const auto exp_write_lat = static_cast<double>(std::max<uint64_t>(
-        model_.GetLatency(total_load_ops_, OpType::kWrite, mode_, write_ratio_),
-        static_cast<uint64_t>(kMinExpectedLatencyUs)));
+    const auto exp_read_lat = GetExpectedLatency(OpType::kRead);
+    const auto exp_write_lat = GetExpectedLatency(OpType::kWrite);
 
     const auto obs_read_sig = static_cast<double>(
         (mode_ == ServerMode::kRead) ? p99_read_latency_td_ : p90_read_latency_td_);
@@ -530,6 +603,7 @@ class DiskMonitor {
     LOG(INFO) << "Completed writes   : " << completed_writes_t_;
 
     LOG(INFO) << "CongestionState    : " << congestion_state_;
+    LOG(INFO) << "Fast congested     : " << IsFastCongested();
 
     LOG(INFO) << "Rejected reads     : " << rejected_reads_t_;
     LOG(INFO) << "Rejected writes    : " << rejected_writes_t_;
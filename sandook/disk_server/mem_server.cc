@@ -109,14 +109,15 @@ Status<void> MemServer::HandleWriteOp(std::span<const std::byte> src,
 
     case OpType::kWrite: {
       assert(len == req_payload.size());
-      const auto start_time = hook_write_started();
+      const auto start_time = hook_write_started(iod->num_sectors);
       const auto ret = HandleWriteOp(req_payload, start_lba);
       if (unlikely(!ret)) {
-        hook_write_completed(start_time, false /* success */);
+        hook_write_completed(start_time, iod->num_sectors,
+                             false /* success */);
         LOG_ONCE(ERR) << "Write IO error: " << ret.error();
         return MakeError(ret);
       }
-      hook_write_completed(start_time, true /* success */);
+      hook_write_completed(start_time, iod->num_sectors, true /* success */);
       return len;
     }
 
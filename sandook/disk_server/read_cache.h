@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "base/compiler.h"
+#include "sandook/base/constants.h"
+#include "sandook/base/counter.h"
+#include "sandook/base/payload.h"
+#include "sandook/bindings/sync.h"
+
+namespace sandook {
+
+/* Read cache for hot blocks in front of the disk server's storage backend.
+ *
+ * Blocks are cached at sector granularity and sharded by LBA into kMaxNumCores
+ * shards, each with its own lock and an equal slice of the memory budget.
+ * Admission and eviction follow S3-FIFO: new blocks enter a small probationary
+ * FIFO and are only promoted to the main FIFO if they are accessed again before
+ * being evicted. Blocks evicted from the small FIFO leave a ghost entry behind
+ * so that they are admitted straight into the main FIFO if they return soon.
+ * One-hit wonders (e.g., scans) therefore never displace the hot set.
+ *
+ * Coherence with writes: writes and discards invalidate their blocks (bumping
+ * the epoch of the shards they touch) both before they are issued and after
+ * they complete; they never write through, as concurrent writes to a block may
+ * complete out of order. A read miss samples the epoch before issuing the
+ * device read and the subsequent fill is dropped if the epoch has moved, so a
+ * fill can never insert data that a write in flight or completed since then
+ * may have overwritten.
+ */
+class ReadCache {
+ public:
+  constexpr static auto kBlockSize = 1UL << kSectorShift;
+  /* Fraction of a shard's slots that belong to the small FIFO. */
+  constexpr static auto kSmallQueueRatio = 0.1;
+  /* Saturation value of the per-block access counter. */
+  constexpr static uint8_t kMaxFrequency = 3;
+
+  explicit ReadCache(size_t capacity_bytes) {
+    const auto slots_per_shard = capacity_bytes / kBlockSize / kMaxNumCores;
+    if (slots_per_shard == 0) {
+      return;
+    }
+
+    for (auto &shard : shards_) {
+      shard.Init(slots_per_shard);
+    }
+    is_enabled_ = true;
+  }
+
+  ~ReadCache() = default;
+
+  /* No copying. */
+  ReadCache(const ReadCache &) = delete;
+  ReadCache &operator=(const ReadCache &) = delete;
+
+  /* No moving. */
+  ReadCache(ReadCache &&) noexcept;
+  ReadCache &operator=(ReadCache &&) noexcept;
+
+  [[nodiscard]] bool is_enabled() const { return is_enabled_; }
+
+  [[nodiscard]] int64_t hits() { return hits_.get_sum(); }
+  [[nodiscard]] int64_t misses() { return misses_.get_sum(); }
+
+  /* Copies the block at lba into buf if it is cached. */
+  [[nodiscard]] bool Lookup(uint64_t lba, std::span<std::byte> buf) {
+    assert(buf.size() == kBlockSize);
+    auto &shard = GetShard(lba);
+
+    {
+      rt::SpinGuard g(shard.lock);
+
+      const auto it = shard.index.find(lba);
+      if (it != shard.index.end()) {
+        auto &entry = shard.entries[it->second];
+        std::memcpy(buf.data(), shard.GetSlot(it->second), kBlockSize);
+        entry.freq = std::min<uint8_t>(entry.freq + 1, kMaxFrequency);
+        hits_.inc_local();
+        return true;
+      }
+    }
+
+    misses_.inc_local();
+    return false;
+  }
+
+  /* Returns the epoch to pass to Fill() for a block that missed in the cache.
+   * Must be sampled before the block is read from the device.
+   */
+  [[nodiscard]] uint64_t GetEpoch(uint64_t lba) {
+    auto &shard = GetShard(lba);
+    rt::SpinGuard g(shard.lock);
+    return shard.epoch;
+  }
+
+  /* Inserts a block that was read from the device, unless a write or discard
+   * to the same shard has been issued or completed since epoch was sampled.
+   */
+  void Fill(uint64_t lba, std::span<const std::byte> buf, uint64_t epoch) {
+    assert(buf.size() == kBlockSize);
+    auto &shard = GetShard(lba);
+    rt::SpinGuard g(shard.lock);
+
+    if (unlikely(shard.epoch != epoch)) {
+      return;
+    }
+
+    if (shard.index.contains(lba)) {
+      return;
+    }
+
+    const auto slot = shard.AllocateSlot();
+    shard.entries[slot] = Entry{.lba = lba, .freq = 0, .valid = true};
+    shard.index.emplace(lba, slot);
+    std::memcpy(shard.GetSlot(slot), buf.data(), kBlockSize);
+
+    if (shard.ghost_set.erase(lba) != 0) {
+      shard.main.push_back(slot);
+    } else {
+      shard.small.push_back(slot);
+    }
+  }
+
+  /* Drops the cached copies of the given blocks and any fill of them that is
+   * in flight (e.g., around a write or a discard).
+   */
+  void Invalidate(uint64_t start_lba, uint64_t num_sectors) {
+    for (uint64_t lba = start_lba; lba < start_lba + num_sectors; lba++) {
+      auto &shard = GetShard(lba);
+      rt::SpinGuard g(shard.lock);
+
+      shard.epoch++;
+      const auto it = shard.index.find(lba);
+      if (it != shard.index.end()) {
+        /* The slot is reclaimed lazily when it reaches the head of its FIFO. */
+        shard.entries[it->second].valid = false;
+        shard.index.erase(it);
+      }
+    }
+  }
+
+ private:
+  struct Entry {
+    uint64_t lba;
+    uint8_t freq;
+    bool valid;
+  };
+
+  struct alignas(kCacheLineSizeBytes) Shard {
+    rt::Spin lock;
+
+    /* Bumped on every write/discard to a block in this shard. */
+    uint64_t epoch{0};
+
+    /* Backing memory for all the slots of this shard. */
+    std::unique_ptr<Payload> data;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> free_slots;
+    std::unordered_map<uint64_t, uint32_t> index;
+
+    /* S3-FIFO queues (of slots) and the ghost FIFO (of LBAs). */
+    std::deque<uint32_t> small;
+    std::deque<uint32_t> main;
+    std::deque<uint64_t> ghost;
+    std::unordered_set<uint64_t> ghost_set;
+    size_t small_capacity{0};
+    size_t ghost_capacity{0};
+
+    void Init(size_t num_slots) {
+      data =
+          std::make_unique<Payload>(kDeviceAlignment, num_slots * kBlockSize);
+      entries.resize(num_slots);
+      free_slots.reserve(num_slots);
+      for (size_t i = num_slots; i > 0; i--) {
+        free_slots.push_back(i - 1);
+      }
+      index.reserve(num_slots);
+      small_capacity = std::max(
+          1UZ, static_cast<size_t>(static_cast<double>(num_slots) *
+                                   kSmallQueueRatio));
+      ghost_capacity = num_slots - small_capacity;
+      ghost_set.reserve(ghost_capacity);
+    }
+
+    [[nodiscard]] std::byte *GetSlot(uint32_t slot) const {
+      return data->view().subspan(slot * kBlockSize, kBlockSize).data();
+    }
+
+    uint32_t AllocateSlot() {
+      while (free_slots.empty()) {
+        Evict();
+      }
+      const auto slot = free_slots.back();
+      free_slots.pop_back();
+      return slot;
+    }
+
+    void Evict() {
+      if (small.size() >= small_capacity || main.empty()) {
+        EvictSmall();
+      } else {
+        EvictMain();
+      }
+    }
+
+    void EvictSmall() {
+      const auto slot = small.front();
+      small.pop_front();
+
+      auto &entry = entries[slot];
+      if (!entry.valid) {
+        free_slots.push_back(slot);
+        return;
+      }
+
+      /* Re-accessed while on probation; promote. */
+      if (entry.freq > 0) {
+        entry.freq = 0;
+        main.push_back(slot);
+        return;
+      }
+
+      index.erase(entry.lba);
+      entry.valid = false;
+      free_slots.push_back(slot);
+      InsertGhost(entry.lba);
+    }
+
+    void EvictMain() {
+      const auto slot = main.front();
+      main.pop_front();
+
+      auto &entry = entries[slot];
+      if (!entry.valid) {
+        free_slots.push_back(slot);
+        return;
+      }
+
+      /* Second chance (up to kMaxFrequency times) for recently used blocks. */
+      if (entry.freq > 0) {
+        entry.freq--;
+        main.push_back(slot);
+        return;
+      }
+
+      index.erase(entry.lba);
+      entry.valid = false;
+      free_slots.push_back(slot);
+    }
+
+    void InsertGhost(uint64_t lba) {
+      if (ghost_capacity == 0 || !ghost_set.insert(lba).second) {
+        return;
+      }
+      ghost.push_back(lba);
+
+      /* Best-effort: a stale FIFO entry for an LBA that was already re-admitted
+       * may drop a newer ghost entry for it early, which is harmless.
+       */
+      while (ghost.size() > ghost_capacity) {
+        ghost_set.erase(ghost.front());
+        ghost.pop_front();
+      }
+    }
+  };
+
+  /* Whether a non-zero memory budget was configured. */
+  bool is_enabled_{false};
+
+  /* Cache shards (indexed by LBA). */
+  std::array<Shard, kMaxNumCores> shards_;
+
+  /* Hit/miss statistics. */
+  ThreadSafeCounter hits_;
+  ThreadSafeCounter misses_;
+
+  [[nodiscard]] Shard &GetShard(uint64_t lba) {
+    return shards_[lba % kMaxNumCores];
+  }
+};
+
+}  // namespace sandook
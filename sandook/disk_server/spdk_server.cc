@@ -5,18 +5,24 @@
 #include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <span>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "base/compiler.h"
 #include "sandook/base/constants.h"
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
 #include "sandook/base/msg.h"
+#include "sandook/base/types.h"
+#include "sandook/base/time.h"
 #include "sandook/bindings/log.h"
 #include "sandook/bindings/storage.h"
+#include "sandook/bindings/sync.h"
+#include "sandook/bindings/thread.h"
 #include "sandook/disk_server/storage_server.h"
 #include "sandook/rpc/rpc.h"
 
@@ -56,7 +62,17 @@ SPDKServer::SPDKServer(RPCClient *ctrl)
             return serial_num;
           }()),
       gen(rd()),
-      block_dist(0, rt::Storage::get_num_blocks() - 1) {}
+      block_dist(0, rt::Storage::get_num_blocks() - 1),
+      th_trimmer_([this]() { Trimmer(); }) {}
+
+SPDKServer::~SPDKServer() {
+  {
+    const rt::SpinGuard guard(trim_lock_);
+    stop_trimmer_ = true;
+    trim_waker_.Wake();
+  }
+  th_trimmer_.Join();
+}
 
 [[nodiscard]] Status<int> SPDKServer::HandleStorageOp(
     const StorageOpMsg *msg, std::span<const std::byte> req_payload,
@@ -84,15 +100,16 @@ SPDKServer::SPDKServer(RPCClient *ctrl)
 
     case OpType::kWrite: {
       assert(len == req_payload.size());
-      const auto start_time = hook_write_started();
+      const auto start_time = hook_write_started(iod->num_sectors);
       // const auto ret = rt::Storage::Write(req_payload, block_dist(gen));
       const auto ret = rt::Storage::Write(req_payload, start_lba);
       if (unlikely(!ret)) {
-        hook_write_completed(start_time, false /* success */);
+        hook_write_completed(start_time, iod->num_sectors,
+                             false /* success */);
         LOG_ONCE(ERR) << "Write IO error: " << ret.error();
         return MakeError(ret);
       }
-      hook_write_completed(start_time, true /* success */);
+      hook_write_completed(start_time, iod->num_sectors, true /* success */);
       return len;
     }
 
@@ -114,17 +131,101 @@ SPDKServer::SPDKServer(RPCClient *ctrl)
 
 [[nodiscard]] Status<void> SPDKServer::HandleDiscardBlocks(
     const std::vector<ServerBlockAddr> &blocks) {
-  static const uint32_t one_block = 1;
+  if (blocks.empty()) {
+    return {};
+  }
 
-  for (const auto blk_addr : blocks) {
-    const auto ret = rt::Storage::Deallocate(blk_addr, one_block);
-    if (unlikely(!ret)) {
-      LOG(ERR) << "Discard error on block " << blk_addr << ": " << ret.error();
-      return MakeError(ret);
+  std::vector<ServerBlockAddr> sorted_blocks(blocks);
+  std::sort(sorted_blocks.begin(), sorted_blocks.end());
+
+  /* Coalesce contiguous blocks into ranges. */
+  std::vector<rt::StorageRange> ranges;
+  for (const auto blk_addr : sorted_blocks) {
+    if (!ranges.empty()) {
+      auto &last = ranges.back();
+      if (blk_addr < last.lba + last.lba_count) {
+        /* Duplicate. */
+        continue;
+      }
+      if (blk_addr == last.lba + last.lba_count &&
+          last.lba_count < std::numeric_limits<uint32_t>::max()) {
+        last.lba_count++;
+        continue;
+      }
     }
+    ranges.push_back({.lba = blk_addr, .lba_count = 1});
+  }
+
+  /* Note: the controller never re-allocates server blocks so a deferred TRIM
+   * cannot race with a new write to the same block.
+   */
+  {
+    const rt::SpinGuard guard(trim_lock_);
+    for (const auto &range : ranges) {
+      pending_trims_.Push(range.lba, range.lba_count);
+    }
+    trim_waker_.Wake();
+  }
+
+  /* Push back on the sender rather than let the queue grow without bound. */
+  std::vector<rt::StorageRange> overflow;
+  while (true) {
+    {
+      const rt::SpinGuard guard(trim_lock_);
+      if (pending_trims_.size() <= kMaxPendingTrims) {
+        break;
+      }
+      pending_trims_.Pop(rt::Storage::kMaxDeallocateRanges, &overflow);
+    }
+    Trim(overflow);
   }
 
   return {};
 }
 
+uint64_t SPDKServer::GetTrimIntervalUs() const {
+  switch (GetCongestionState()) {
+    case ServerCongestionState::kCongestedUnstable:
+    case ServerCongestionState::kCongestedStable:
+      return kTrimCongestionRecoveryIntervalUs;
+
+    default:
+      return kTrimIntervalUs;
+  }
+}
+
+void SPDKServer::Trim(std::span<const rt::StorageRange> ranges) {
+  const auto ret = rt::Storage::Deallocate(ranges);
+  if (unlikely(!ret)) {
+    LOG_ONCE(ERR) << "Discard error on " << ranges.size()
+                  << " ranges: " << ret.error();
+  }
+}
+
+void SPDKServer::Trimmer() {
+  std::vector<rt::StorageRange> ranges;
+  ranges.reserve(rt::Storage::kMaxDeallocateRanges);
+
+  while (true) {
+    /* Hold back while the disk is congested, but keep draining the oldest
+     * ranges; TRIMs are not urgent, but must not pile up.
+     */
+    const auto max_ranges =
+        IsCongested() ? kMinTrimRanges : rt::Storage::kMaxDeallocateRanges;
+
+    {
+      rt::SpinGuard guard(trim_lock_);
+      guard.Park(trim_waker_,
+                 [this] { return stop_trimmer_ || !pending_trims_.empty(); });
+      if (stop_trimmer_) {
+        return;
+      }
+      pending_trims_.Pop(max_ranges, &ranges);
+    }
+
+    Trim(ranges);
+    rt::Sleep(Duration(GetTrimIntervalUs()));
+  }
+}
+
 }  // namespace sandook
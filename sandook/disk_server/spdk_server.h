@@ -3,10 +3,17 @@
 #include <cstddef>
 #include <random>
 #include <span>
+#include <vector>
 
+#include "sandook/base/constants.h"
 #include "sandook/base/error.h"
 #include "sandook/base/msg.h"
+#include "sandook/base/types.h"
+#include "sandook/bindings/storage.h"
+#include "sandook/bindings/sync.h"
+#include "sandook/bindings/thread.h"
 #include "sandook/disk_server/storage_server.h"
+#include "sandook/disk_server/trim_queue.h"
 #include "sandook/rpc/rpc.h"
 
 namespace sandook {
@@ -19,7 +26,7 @@ struct alignas(kCacheLineSizeBytes) Traces {
 class SPDKServer : public StorageServer {
  public:
   explicit SPDKServer(RPCClient *ctrl);
-  ~SPDKServer() override = default;
+  ~SPDKServer() override;
 
   /* No copying. */
   SPDKServer(const SPDKServer &) = delete;
@@ -33,13 +40,46 @@ class SPDKServer : public StorageServer {
       const StorageOpMsg *msg, std::span<const std::byte> req_payload,
       std::span<std::byte> resp_payload) override;
 
+  /* Coalesces the blocks into ranges and queues them to be trimmed in the
+   * background.
+   */
   [[nodiscard]] Status<void> HandleDiscardBlocks(
       const std::vector<ServerBlockAddr> &blocks) override;
 
  private:
+  /* Pacing of background TRIMs (one command per interval) depending on the
+   * congestion state of the disk. While congested, only kMinTrimRanges ranges
+   * are trimmed per interval so that the queue still drains.
+   */
+  constexpr static auto kTrimIntervalUs = 100 * kOneMicroSecond;
+  constexpr static auto kTrimCongestionRecoveryIntervalUs = 1 * kOneMilliSecond;
+  constexpr static size_t kMinTrimRanges = 8;
+
+  /* Ranges that may wait to be trimmed; beyond that, discards trim the oldest
+   * ranges themselves before returning.
+   */
+  constexpr static size_t kMaxPendingTrims =
+      64 * rt::Storage::kMaxDeallocateRanges;
+
   std::random_device rd;
   std::mt19937 gen;
   std::uniform_int_distribution<uint64_t> block_dist;
+
+  /* Block ranges waiting to be trimmed. */
+  TrimQueue pending_trims_;
+  rt::Spin trim_lock_;
+  rt::ThreadWaker trim_waker_;
+  bool stop_trimmer_{false};
+
+  /* Thread to issue TRIMs in the background. */
+  rt::Thread th_trimmer_;
+
+  void Trimmer();
+
+  /* Trims the ranges with one dataset management command. */
+  static void Trim(std::span<const rt::StorageRange> ranges);
+
+  [[nodiscard]] uint64_t GetTrimIntervalUs() const;
 };
 
 }  // namespace sandook
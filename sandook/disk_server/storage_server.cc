@@ -1,6 +1,8 @@
 #include "sandook/disk_server/storage_server.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <span>
@@ -12,6 +14,7 @@
 #include "sandook/base/io.h"
 #include "sandook/base/io_desc.h"
 #include "sandook/base/msg.h"
+#include "sandook/base/server_stats.h"
 #include "sandook/base/time.h"
 #include "sandook/bindings/log.h"
 #include "sandook/bindings/timer.h"
@@ -23,7 +26,9 @@ namespace sandook {
 
 StorageServer::StorageServer(RPCClient *ctrl, uint64_t num_sectors,
                              const std::string &name)
-    : ctrl_(ctrl), name_(name) {
+    : ctrl_(ctrl),
+      name_(name),
+      cache_(Config::kDiskServerReadCacheSizeMB << kMiBShift) {
   const auto *const ip = Config::kStorageServerIP.c_str();
   const auto port = Config::kStorageServerPort;
 
@@ -33,7 +38,8 @@ StorageServer::StorageServer(RPCClient *ctrl, uint64_t num_sectors,
   }
   utils::SetControllerTimeCalibration(*delta_us);
 
-  auto req = CreateRegisterServerMsg(ip, port, name, num_sectors);
+  auto req = CreateRegisterServerMsg(ip, port, name, num_sectors,
+                                     Config::kLocation);
   const auto req_size = GetMsgSize(req.get());
   auto reg_resp = ctrl_->Call(writable_span(req.get(), req_size));
 
@@ -45,11 +51,132 @@ StorageServer::StorageServer(RPCClient *ctrl, uint64_t num_sectors,
   }
 
   LOG(INFO) << "DiskServerName = " << name;
+  LOG(INFO) << "DiskServerReadCacheSizeMB = "
+            << Config::kDiskServerReadCacheSizeMB;
 }
 
 StorageServer::~StorageServer() {
   stop_ = true;
   th_ctrl_stats_.Join();
+
+  if (cache_.is_enabled()) {
+    LOG(INFO) << "Read cache hits   : " << cache_.hits();
+    LOG(INFO) << "Read cache misses : " << cache_.misses();
+  }
+}
+
+Status<int> StorageServer::SubmitStorageOp(
+    const StorageOpMsg *msg, std::span<const std::byte> req_payload,
+    std::span<std::byte> resp_payload) {
+  if (!cache_.is_enabled()) {
+    return IssueStorageOp(msg, req_payload, resp_payload);
+  }
+
+  const IODesc *iod = &msg->iod;
+  const OpType op = IODesc::get_op(iod);
+  const auto start_lba = iod->start_sector;
+  const auto num_sectors = iod->num_sectors;
+
+  switch (op) {
+    case OpType::kRead: {
+      /* Only single block reads are cached; virtual disks map each of their
+       * sectors to an independent server block so this is the common case.
+       */
+      if (num_sectors != 1) {
+        break;
+      }
+
+      if (cache_.Lookup(start_lba, resp_payload)) {
+        return static_cast<int>(resp_payload.size());
+      }
+
+      const auto epoch = cache_.GetEpoch(start_lba);
+      auto ret = IssueStorageOp(msg, req_payload, resp_payload);
+      if (ret) {
+        cache_.Fill(start_lba, resp_payload, epoch);
+      }
+      return ret;
+    }
+
+    case OpType::kWrite:
+    case OpType::kDiscard: {
+      /* No write-through, as writes to a block may complete out of order.
+       * Invalidating before the write keeps reads from hitting data it
+       * overwrites, and after it drops fills that read the device meanwhile.
+       */
+      cache_.Invalidate(start_lba, num_sectors);
+      auto ret = IssueStorageOp(msg, req_payload, resp_payload);
+      cache_.Invalidate(start_lba, num_sectors);
+      return ret;
+    }
+
+    default:
+      break;
+  }
+
+  return IssueStorageOp(msg, req_payload, resp_payload);
+}
+
+Status<int> StorageServer::IssueStorageOp(
+    const StorageOpMsg *msg, std::span<const std::byte> req_payload,
+    std::span<std::byte> resp_payload) {
+  const OpType op = IODesc::get_op(&msg->iod);
+  if (op != OpType::kRead && op != OpType::kWrite) {
+    return HandleStorageOp(msg, req_payload, resp_payload);
+  }
+
+  const auto num_sectors = msg->iod.num_sectors;
+  const auto admitted = sq_.Acquire(op, num_sectors);
+  if (!admitted) {
+    return MakeError(admitted);
+  }
+
+  auto ret = HandleStorageOp(msg, req_payload, resp_payload);
+  sq_.Release(op, num_sectors);
+
+  return ret;
+}
+
+void StorageServer::SetWriteKneeDepth() {
+  const auto &model = mon_.GetModel();
+  const auto peak_iops = model.GetPeakIOPS(ServerMode::kWrite);
+  const auto latency_us = model.GetLatency(peak_iops, OpType::kWrite,
+                                           ServerMode::kWrite, 1.0);
+
+  /* Little's law: outstanding requests = throughput x latency. */
+  const auto depth = std::ceil(static_cast<double>(peak_iops) *
+                               static_cast<double>(latency_us) /
+                               static_cast<double>(kOneSecond));
+  write_knee_depth_ = std::clamp(static_cast<uint32_t>(depth),
+                                 SubmissionQueue::kMinWriteDepth,
+                                 SubmissionQueue::kMaxDeviceDepth);
+  UpdateWriteDepth();
+
+  LOG(INFO) << "DiskServerWriteKneeDepth = " << write_knee_depth_;
+}
+
+void StorageServer::UpdateWriteDepth() {
+  /* Right after switching into read mode, writes that were routed with a stale
+   * view of the mode are still admitted; only let them trickle through so that
+   * they do not delay the reads that follow.
+   */
+  const bool is_draining_writes = mon_.GetMode() == ServerMode::kRead &&
+                                  mon_.IsModeSwitchGracePeriod();
+  sq_.SetWriteDepth(is_draining_writes ? SubmissionQueue::kMinWriteDepth
+                                       : write_knee_depth_);
+}
+
+Status<void> StorageServer::SubmitDiscardBlocks(
+    const std::vector<ServerBlockAddr> &blocks) {
+  auto ret = HandleDiscardBlocks(blocks);
+
+  if (cache_.is_enabled()) {
+    for (const auto blk_addr : blocks) {
+      cache_.Invalidate(blk_addr, 1 /* num_sectors */);
+    }
+  }
+
+  return ret;
 }
 
 void StorageServer::ControllerStatsUpdater() {
@@ -90,6 +217,7 @@ Status<void> StorageServer::HandleUpdateServerStatsReply(
           payload.last(sizeof(UpdateServerStatsReplyMsg)).data()));
 
   mon_.SetModeAndWeights(msg->mode, msg->read_weight, msg->write_weight);
+  UpdateWriteDepth();
 
   return {};
 }
@@ -107,6 +235,7 @@ Status<void> StorageServer::HandleUpdateServerStatsReply(
   mon_.SetServerID(server_id_);
   mon_.SetServerName(name_);
   mon_.SetIsRejectionsEnabled(msg->is_rejections_enabled);
+  SetWriteKneeDepth();
 
   LOG(INFO) << "DiskServerID = " << server_id_;
   LOG(INFO) << "DiskServerRejectionsEnabled = " << msg->is_rejections_enabled;
@@ -12,6 +12,8 @@
 #include "sandook/base/types.h"
 #include "sandook/bindings/thread.h"
 #include "sandook/disk_server/disk_monitor.h"
+#include "sandook/disk_server/read_cache.h"
+#include "sandook/disk_server/submission_queue.h"
 #include "sandook/rpc/rpc.h"
 
 namespace sandook {
@@ -35,6 +37,19 @@ class StorageServer {
   [[nodiscard]] static Status<size_t> GetMsgResponseSize(
       const StorageOpMsg *msg);
 
+  /* Entry point for storage ops. Reads are served from the read cache when
+   * possible (without touching the device or its load accounting) and writes
+   * invalidate the cached blocks. Reads and writes that go to the device
+   * are admitted through the submission queue and fail with EBUSY if they
+   * cannot be admitted before their deadline.
+   */
+  [[nodiscard]] Status<int> SubmitStorageOp(
+      const StorageOpMsg *msg, std::span<const std::byte> req_payload,
+      std::span<std::byte> resp_payload);
+
+  [[nodiscard]] Status<void> SubmitDiscardBlocks(
+      const std::vector<ServerBlockAddr> &blocks);
+
   [[nodiscard]] virtual Status<int> HandleStorageOp(
       const StorageOpMsg *msg, std::span<const std::byte> req_payload,
       std::span<std::byte> resp_payload) = 0;
@@ -44,14 +59,14 @@ class StorageServer {
     return MakeError(ENOTSUP);
   }
 
-  void HandleRejection(OpType op) {
-    switch (op) {
+  void HandleRejection(const IODesc *iod) {
+    switch (IODesc::get_op(iod)) {
       case OpType::kRead:
         mon_.ReadRejected();
         break;
 
       case OpType::kWrite:
-        mon_.WriteRejected();
+        mon_.WriteRejected(iod->num_sectors);
         break;
 
       default:
@@ -61,6 +76,10 @@ class StorageServer {
 
   [[nodiscard]] bool IsCongested() const { return mon_.IsCongested(); }
 
+  [[nodiscard]] ServerCongestionState GetCongestionState() const {
+    return mon_.GetCongestionState();
+  }
+
   [[nodiscard]] bool IsAllowingWrites() const {
     return mon_.IsAllowingWrites();
   }
@@ -73,9 +92,12 @@ class StorageServer {
     mon_.ReadCompleted(start_time, success);
   }
 
-  uint64_t hook_write_started() { return mon_.WriteStarted(); }
-  void hook_write_completed(uint64_t start_time, bool success) {
-    mon_.WriteCompleted(start_time, success);
+  uint64_t hook_write_started(uint32_t num_sectors) {
+    return mon_.WriteStarted(num_sectors);
+  }
+  void hook_write_completed(uint64_t start_time, uint32_t num_sectors,
+                            bool success) {
+    mon_.WriteCompleted(start_time, num_sectors, success);
   }
 
  private:
@@ -97,8 +119,28 @@ class StorageServer {
   /* Agent for monitoring performance statistics of this disk. */
   DiskMonitor mon_;
 
+  /* Cache of hot blocks served without going to the device. */
+  ReadCache cache_;
+
+  /* Admission queue for requests to the device. */
+  SubmissionQueue sq_;
+
+  /* Outstanding writes at the knee of the disk's write curve. */
+  uint32_t write_knee_depth_{SubmissionQueue::kMaxDeviceDepth};
+
   void ControllerStatsUpdater();
 
+  /* Issue a storage op to the backend through the submission queue. */
+  [[nodiscard]] Status<int> IssueStorageOp(
+      const StorageOpMsg *msg, std::span<const std::byte> req_payload,
+      std::span<std::byte> resp_payload);
+
+  /* Derive the write depth of the submission queue from the disk model. */
+  void SetWriteKneeDepth();
+
+  /* Apply the write depth for the current mode to the submission queue. */
+  void UpdateWriteDepth();
+
   [[nodiscard]] Status<void> HandleUpdateServerStatsReply(
       std::span<const std::byte> payload);
 
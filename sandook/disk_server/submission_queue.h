@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <deque>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/error.h"
+#include "sandook/base/io_desc.h"
+#include "sandook/base/time.h"
+#include "sandook/bindings/sync.h"
+#include "sandook/bindings/timer.h"
+
+namespace sandook {
+
+/* Admission queue in front of a storage device.
+ *
+ * Every request that goes to the device must first acquire a slot and release
+ * it once completed. Policy:
+ * - The device never has more than kMaxDeviceDepth requests outstanding.
+ * - Reads have strict priority: a write is only admitted when no read is
+ *   waiting for a slot.
+ * - At most write_depth_ sectors are outstanding in writes at a time (a write
+ *   of more sectors than that is only admitted alone). This is set by the
+ *   owner from the knee of the disk's write curve and lowered during the
+ *   mode-switch grace period so that stale writes cannot crowd out reads.
+ * - Requests that cannot be admitted before their deadline are rejected with
+ *   EBUSY so that the client can retry them on a different replica/server.
+ */
+class SubmissionQueue {
+ public:
+  constexpr static uint32_t kMaxDeviceDepth = 256;
+  constexpr static uint32_t kMinWriteDepth = 1;
+  constexpr static uint64_t kReadDeadlineUs = 1 * kOneMilliSecond;
+  constexpr static uint64_t kWriteDeadlineUs = 5 * kOneMilliSecond;
+
+  SubmissionQueue() = default;
+  ~SubmissionQueue() = default;
+
+  /* No copying. */
+  SubmissionQueue(const SubmissionQueue &) = delete;
+  SubmissionQueue &operator=(const SubmissionQueue &) = delete;
+
+  /* No moving. */
+  SubmissionQueue(SubmissionQueue &&) noexcept;
+  SubmissionQueue &operator=(SubmissionQueue &&) noexcept;
+
+  /* Blocks until the request can be issued to the device; the sectors of a
+   * write count towards the write depth.
+   */
+  [[nodiscard]] Status<void> Acquire(OpType op, uint32_t num_sectors = 1) {
+    const bool is_read = op == OpType::kRead;
+
+    rt::SpinGuard g(lock_);
+
+    if (is_read && read_waiters_.empty() && CanIssue()) {
+      inflight_reads_++;
+      return {};
+    }
+    if (!is_read && write_waiters_.empty() && read_waiters_.empty() &&
+        CanIssueWrite(num_sectors)) {
+      inflight_writes_ += num_sectors;
+      return {};
+    }
+
+    const auto deadline_us =
+        MicroTime() + (is_read ? kReadDeadlineUs : kWriteDeadlineUs);
+    auto *waiters = is_read ? &read_waiters_ : &write_waiters_;
+    Waiter w{.deadline_us = deadline_us, .num_sectors = num_sectors};
+    waiters->push_back(&w);
+
+    /* Rejects the request at its deadline even if no request completes until
+     * then (e.g., while the device stalls for GC).
+     */
+    rt::Timer timer([this, waiters, &w]() { Timeout(waiters, &w); });
+    timer.StartAt(Time(deadline_us));
+    g.Park(w.waker, [&w]() { return w.is_done; });
+
+    /* The timer may have fired already; it still refers to the waiter. */
+    if (!timer.Cancel()) {
+      g.Park(w.waker, [&w]() { return w.is_timer_done; });
+    }
+
+    if (!w.is_admitted) {
+      return MakeError(EBUSY);
+    }
+    return {};
+  }
+
+  /* Releases the slot of a completed request and admits waiting requests. */
+  void Release(OpType op, uint32_t num_sectors = 1) {
+    rt::SpinGuard g(lock_);
+
+    if (op == OpType::kRead) {
+      inflight_reads_--;
+    } else {
+      inflight_writes_ -= num_sectors;
+    }
+
+    Dispatch();
+  }
+
+  void SetWriteDepth(uint32_t depth) {
+    rt::SpinGuard g(lock_);
+
+    write_depth_.store(std::clamp(depth, kMinWriteDepth, kMaxDeviceDepth),
+                       std::memory_order_relaxed);
+    Dispatch();
+  }
+
+  /* Safe to call without the lock while the depth is being set. */
+  [[nodiscard]] uint32_t write_depth() const {
+    return write_depth_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Waiter {
+    uint64_t deadline_us;
+    uint32_t num_sectors;
+    rt::ThreadWaker waker;
+    bool is_done{false};
+    bool is_admitted{false};
+    bool is_timer_done{false};
+  };
+
+  rt::Spin lock_;
+
+  /* Requests currently issued to the device (writes in sectors). */
+  uint32_t inflight_reads_{0};
+  uint32_t inflight_writes_{0};
+
+  /* Maximum number of sectors outstanding in writes (only set under lock_). */
+  std::atomic_uint32_t write_depth_{kMaxDeviceDepth};
+
+  /* Requests waiting for a slot, in FIFO (and therefore deadline) order. */
+  std::deque<Waiter *> read_waiters_;
+  std::deque<Waiter *> write_waiters_;
+
+  [[nodiscard]] bool CanIssue() const {
+    return inflight_reads_ + inflight_writes_ < kMaxDeviceDepth;
+  }
+
+  [[nodiscard]] bool CanIssueWrite(uint32_t num_sectors) const {
+    return CanIssue() && (inflight_writes_ == 0 ||
+                          inflight_writes_ + num_sectors <= write_depth());
+  }
+
+  static void Wake(Waiter *w, bool is_admitted) {
+    w->is_admitted = is_admitted;
+    w->is_done = true;
+    w->waker.Wake();
+  }
+
+  static void Expire(std::deque<Waiter *> *waiters, uint64_t now_us) {
+    while (!waiters->empty() && waiters->front()->deadline_us < now_us) {
+      Wake(waiters->front(), false /* is_admitted */);
+      waiters->pop_front();
+    }
+  }
+
+  /* Rejects the request of the waiter if it is still waiting. */
+  void Timeout(std::deque<Waiter *> *waiters, Waiter *w) {
+    rt::SpinGuard g(lock_);
+
+    w->is_timer_done = true;
+    if (w->is_done) {
+      w->waker.Wake();
+      return;
+    }
+    std::erase(*waiters, w);
+    Wake(w, false /* is_admitted */);
+  }
+
+  void Dispatch() {
+    const auto now_us = MicroTime();
+    Expire(&read_waiters_, now_us);
+    Expire(&write_waiters_, now_us);
+
+    while (!read_waiters_.empty() && CanIssue()) {
+      inflight_reads_++;
+      Wake(read_waiters_.front(), true /* is_admitted */);
+      read_waiters_.pop_front();
+    }
+
+    while (read_waiters_.empty() && !write_waiters_.empty() &&
+           CanIssueWrite(write_waiters_.front()->num_sectors)) {
+      inflight_writes_ += write_waiters_.front()->num_sectors;
+      Wake(write_waiters_.front(), true /* is_admitted */);
+      write_waiters_.pop_front();
+    }
+  }
+};
+
+}  // namespace sandook
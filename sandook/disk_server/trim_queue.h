@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "sandook/bindings/storage.h"
+
+namespace sandook {
+
+/* Block ranges waiting to be trimmed, oldest first.
+ *
+ * A range that overlaps or is adjacent to queued ones is merged with them into
+ * the place of the oldest, so that ranges discarded piecemeal (e.g., by
+ * different messages) are trimmed together and queued blocks are never
+ * trimmed twice. Not thread-safe.
+ */
+class TrimQueue {
+ public:
+  TrimQueue() = default;
+  ~TrimQueue() = default;
+
+  /* No copying. */
+  TrimQueue(const TrimQueue &) = delete;
+  TrimQueue &operator=(const TrimQueue &) = delete;
+
+  /* No moving. */
+  TrimQueue(TrimQueue &&) noexcept;
+  TrimQueue &operator=(TrimQueue &&) noexcept;
+
+  /* Number of (merged) ranges queued. */
+  [[nodiscard]] size_t size() const { return by_lba_.size(); }
+
+  [[nodiscard]] bool empty() const { return by_lba_.empty(); }
+
+  void Push(uint64_t lba, uint64_t n_blocks) {
+    if (n_blocks == 0) {
+      return;
+    }
+
+    auto end = lba + n_blocks;
+    auto seq = next_seq_;
+
+    /* Absorb the queued ranges that overlap or touch [lba, end): at most one
+     * starting before lba, then the ones starting up to end.
+     */
+    auto it = by_lba_.upper_bound(lba);
+    if (it != by_lba_.begin()) {
+      const auto prev = std::prev(it);
+      if (prev->first + at(prev->second).n_blocks >= lba) {
+        it = prev;
+      }
+    }
+    while (it != by_lba_.end() && it->first <= end) {
+      auto &range = at(it->second);
+      lba = std::min(lba, range.lba);
+      end = std::max(end, range.lba + range.n_blocks);
+      seq = std::min(seq, it->second);
+      range.n_blocks = 0;
+      it = by_lba_.erase(it);
+    }
+
+    if (seq == next_seq_) {
+      ranges_.push_back({.lba = lba, .n_blocks = end - lba});
+      next_seq_++;
+    } else {
+      at(seq) = {.lba = lba, .n_blocks = end - lba};
+    }
+    by_lba_.emplace(lba, seq);
+  }
+
+  /* Pops the oldest ranges (as up to max_ranges device ranges) into ranges. */
+  void Pop(size_t max_ranges, std::vector<rt::StorageRange> *ranges) {
+    ranges->clear();
+    while (ranges->size() < max_ranges && !ranges_.empty()) {
+      auto &range = ranges_.front();
+      if (range.n_blocks == 0) {
+        /* Merged into an older range. */
+        PopFront();
+        continue;
+      }
+
+      const auto n_blocks =
+          std::min<uint64_t>(range.n_blocks, kMaxDeviceRangeBlocks);
+      ranges->push_back({.lba = range.lba,
+                         .lba_count = static_cast<uint32_t>(n_blocks)});
+      by_lba_.erase(range.lba);
+      if (n_blocks == range.n_blocks) {
+        PopFront();
+        continue;
+      }
+
+      /* The rest of a range too long for the device stays at the front. */
+      range.lba += n_blocks;
+      range.n_blocks -= n_blocks;
+      by_lba_.emplace(range.lba, head_seq_);
+    }
+  }
+
+ private:
+  constexpr static uint64_t kMaxDeviceRangeBlocks =
+      std::numeric_limits<decltype(rt::StorageRange::lba_count)>::max();
+
+  struct Range {
+    uint64_t lba;
+    /* Zero once merged into another range. */
+    uint64_t n_blocks;
+  };
+
+  /* Ranges in the order they were queued; the one at the front has sequence
+   * number head_seq_.
+   */
+  std::deque<Range> ranges_;
+  uint64_t head_seq_{0};
+  uint64_t next_seq_{0};
+  /* Sequence numbers of the (disjoint, non-adjacent) ranges by their start. */
+  std::map<uint64_t, uint64_t> by_lba_;
+
+  Range &at(uint64_t seq) {
+    assert(seq >= head_seq_ && seq < next_seq_);
+    return ranges_.at(seq - head_seq_);
+  }
+
+  void PopFront() {
+    ranges_.pop_front();
+    head_seq_++;
+  }
+};
+
+}  // namespace sandook
@@ -47,10 +47,26 @@ class AdaptiveRWIsolationBase : public RWIsolationBase {
     return {};
   }
 
+  Status<void> UpdateModel(ServerID server_id,
+                           const DiskModel &model) override {
+    models_.at(server_id) = model;
+    return {};
+  }
+
   uint64_t GetPeakIOPS(ServerID server_id, ServerMode mode) override {
+    if (mode == ServerMode::kRead) {
+      return models_.at(server_id).GetPeakIOPS(ServerMode::kRead);
+    }
     return models_.at(server_id).GetPeakIOPS(ServerMode::kMix);
   }
 
+  double GetLatency(ServerID server_id, OpType op, ServerMode mode,
+                    double load) override {
+    const auto write_ratio = (op == OpType::kWrite) ? 1.0 : 0.0;
+    return static_cast<double>(models_.at(server_id).GetLatency(
+        static_cast<uint64_t>(load), op, mode, write_ratio));
+  }
+
  private:
   sandook::DiskModels models_;
 };
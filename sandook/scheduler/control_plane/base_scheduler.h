@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cerrno>
+#include <cstddef>
 #include <string>
 
+#include "sandook/base/constants.h"
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
 #include "sandook/base/server_stats.h"
@@ -32,6 +34,19 @@ class BaseScheduler {
     return {};
   }
 
+  /* Sets the fewest servers that writes need, i.e., the replication factor of
+   * the most replicated volume.
+   */
+  virtual void SetMinWriteServers(size_t n_servers) {
+    min_write_servers_ = n_servers;
+  }
+
+  /* Replaces the model of a server (e.g., with one refined online). */
+  virtual Status<void> UpdateModel([[maybe_unused]] ServerID server_id,
+                                   [[maybe_unused]] const DiskModel &model) {
+    return {};
+  }
+
   virtual Status<ServerModes> ComputeModes(
       [[maybe_unused]] const ServerStatsList &stats,
       [[maybe_unused]] const SystemLoad load) {
@@ -48,6 +63,10 @@ class BaseScheduler {
       ServerID server_id) const {
     return MakeError(ENOTSUP);
   }
+
+ protected:
+  /* Fewest servers that take writes (see SetMinWriteServers). */
+  size_t min_write_servers_{kDefaultNumReplicas};
 };
 
 }  // namespace sandook::schedulers::control_plane
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/time.h"
+#include "sandook/base/types.h"
+
+namespace sandook::schedulers::control_plane {
+
+/* Forecasts the read and write load of the system.
+ *
+ * Samples of the system load are averaged over periods of kPeriodUs, and each
+ * period's average updates a Holt (double exponential smoothing) model of the
+ * level and the trend of the load. A forecast extrapolates the trend from the
+ * level; loads never go below zero.
+ */
+class LoadForecaster {
+ public:
+  constexpr static uint64_t kPeriodUs = kModeSwitchIntervalUs / 10;
+  /* Smoothing of the level and the trend. */
+  constexpr static auto kLevelAlpha = 0.5;
+  constexpr static auto kTrendBeta = 0.3;
+
+  LoadForecaster() : period_start_us_(MicroTime()) {}
+  ~LoadForecaster() = default;
+
+  /* No copying. */
+  LoadForecaster(const LoadForecaster &) = delete;
+  LoadForecaster &operator=(const LoadForecaster &) = delete;
+
+  /* No moving. */
+  LoadForecaster(LoadForecaster &&) noexcept;
+  LoadForecaster &operator=(LoadForecaster &&) noexcept;
+
+  void Update(const SystemLoad load) {
+    const auto [read_ops, write_ops] = load;
+    last_read_ops_ = static_cast<double>(read_ops);
+    last_write_ops_ = static_cast<double>(write_ops);
+    sum_read_ops_ += last_read_ops_;
+    sum_write_ops_ += last_write_ops_;
+    num_samples_++;
+
+    const auto now = MicroTime();
+    if (now - period_start_us_ < kPeriodUs) {
+      return;
+    }
+
+    const auto n = static_cast<double>(num_samples_);
+    read_.Update(sum_read_ops_ / n);
+    write_.Update(sum_write_ops_ / n);
+    sum_read_ops_ = 0;
+    sum_write_ops_ = 0;
+    num_samples_ = 0;
+    period_start_us_ = now;
+  }
+
+  /* Returns the (read, write) load expected horizon_us from now. */
+  [[nodiscard]] std::pair<double, double> Forecast(uint64_t horizon_us) const {
+    const auto periods =
+        static_cast<double>(horizon_us) / static_cast<double>(kPeriodUs);
+    return {read_.Forecast(periods, last_read_ops_),
+            write_.Forecast(periods, last_write_ops_)};
+  }
+
+ private:
+  struct Holt {
+    double level{0};
+    double trend{0};
+    bool is_init{false};
+
+    void Update(double load) {
+      if (!is_init) {
+        level = load;
+        is_init = true;
+        return;
+      }
+
+      const auto prev_level = level;
+      level = (kLevelAlpha * load) + ((1 - kLevelAlpha) * (level + trend));
+      trend = (kTrendBeta * (level - prev_level)) + ((1 - kTrendBeta) * trend);
+    }
+
+    /* Falls back to the last sample until the first period completes. */
+    [[nodiscard]] double Forecast(double periods, double last_load) const {
+      if (!is_init) {
+        return last_load;
+      }
+      return std::max(level + (periods * trend), 0.0);
+    }
+  };
+
+  Holt read_;
+  Holt write_;
+
+  /* Samples of the current period. */
+  uint64_t period_start_us_;
+  double sum_read_ops_{0};
+  double sum_write_ops_{0};
+  uint64_t num_samples_{0};
+  double last_read_ops_{0};
+  double last_write_ops_{0};
+};
+
+}  // namespace sandook::schedulers::control_plane
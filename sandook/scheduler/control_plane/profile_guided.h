@@ -18,6 +18,7 @@
 #include "sandook/base/time.h"
 #include "sandook/base/types.h"
 #include "sandook/bindings/log.h"
+#include "sandook/config/config.h"
 #include "sandook/disk_model/disk_model.h"
 #include "sandook/scheduler/control_plane/base_scheduler.h"
 
@@ -34,6 +35,10 @@ constexpr auto kMaxIterations = 5000;
 constexpr auto kBias = 0.005;
 constexpr auto kMinWeight = 0.0;
 constexpr auto kMaxWeight = 1.0;
+constexpr auto kMaxBisectionIterations = 32;
+constexpr auto kBisectionToleranceUs = 0.5;
+/* Servers at or above this fill level are not sent new writes. */
+constexpr auto kNearlyFullFillLevel = 0.95;
 
 class ProfileGuided : public BaseScheduler {
  public:
@@ -66,6 +71,12 @@ class ProfileGuided : public BaseScheduler {
     return {};
   }
 
+  Status<void> UpdateModel(ServerID server_id,
+                           const DiskModel &model) override {
+    models_.at(server_id) = model;
+    return {};
+  }
+
   bool UseIterativeMethod(const ServerStatsList &stats, OpType op,
                           const SystemLoad load) {
     uint64_t total_iops_capacity = 0;
@@ -77,7 +88,8 @@ class ProfileGuided : public BaseScheduler {
        */
       const auto peak_mode = srv.mode == ServerMode::kRead ? ServerMode::kRead
                                                            : ServerMode::kWrite;
-      const auto srv_load = model.GetPeakIOPS(peak_mode);
+      const auto srv_load =
+          model.GetPeakIOPS(peak_mode, 0.0 /* write_ratio */, srv.fill_level);
       total_iops_capacity += srv_load;
     });
 
@@ -92,7 +104,30 @@ class ProfileGuided : public BaseScheduler {
 
   Status<ServerWeights> ComputeWeights(const ServerStatsList &stats, OpType op,
                                        const SystemLoad load) override {
+    auto weights = ComputeModelWeights(stats, op, load);
+    if (weights && op == OpType::kWrite) {
+      AvoidFullServers(&*weights, stats);
+    }
+    return weights;
+  }
+
+ private:
+  std::random_device rand_dev_;
+  std::mt19937 rand_gen_;
+  sandook::DiskModels models_;
+
+  Status<ServerWeights> ComputeModelWeights(const ServerStatsList &stats,
+                                            OpType op, const SystemLoad load) {
     if (UseIterativeMethod(stats, op, load)) {
+      if (Config::kProfileGuidedSolverType ==
+          Config::ProfileGuidedSolverType::kBisection) {
+        auto ret = ComputeWeightsBisection(stats, op, load);
+        if (ret) {
+          return *ret;
+        }
+        return ComputeWeightsFromPeak(stats, op, load);
+      }
+
       auto bound = kStableMeanBound;
       while (bound < kMaxIterativeMethodMeanBound) {
         auto ret = ComputeWeightsIterative(stats, op, load, bound);
@@ -106,10 +141,30 @@ class ProfileGuided : public BaseScheduler {
     return ComputeWeightsFromPeak(stats, op, load);
   }
 
- private:
-  std::random_device rand_dev_;
-  std::mt19937 rand_gen_;
-  sandook::DiskModels models_;
+  /* Moves the write weight of nearly full servers to the others (in
+   * proportion to their weights), unless all servers are nearly full.
+   */
+  static void AvoidFullServers(ServerWeights *weights,
+                               const ServerStatsList &stats) {
+    double sum_weights = 0.0;
+    std::ranges::for_each(stats, [&](const auto &srv) {
+      if (srv.fill_level < kNearlyFullFillLevel) {
+        sum_weights += weights->at(srv.server_id);
+      }
+    });
+    if (sum_weights <= 0.0) {
+      return;
+    }
+
+    std::ranges::for_each(stats, [&](const auto &srv) {
+      auto &weight = weights->at(srv.server_id);
+      if (srv.fill_level < kNearlyFullFillLevel) {
+        weight /= sum_weights;
+      } else {
+        weight = 0.0;
+      }
+    });
+  }
 
   static void ResetWeights(ServerWeights *weights,
                            const ServerStatsList *stats) {
@@ -177,7 +232,8 @@ class ProfileGuided : public BaseScheduler {
         const auto load = new_load + residual_load;
 
         const auto &model = models_.at(server_id);
-        const auto sig = model.GetLatency(load, op, srv.mode, write_ratio);
+        const auto sig = model.GetLatency(load, op, srv.mode, write_ratio,
+                                          srv.fill_level);
 
         if (sig < best_server_signal) {
           best_server_signal = sig;
@@ -240,6 +296,83 @@ class ProfileGuided : public BaseScheduler {
     return weights;
   }
 
+  /* Equalizes the model latency across servers: bisects on a target latency
+   * and inverts each server's model to find the load it can take at that
+   * latency. Weights are the servers' shares of the resulting load.
+   */
+  Status<ServerWeights> ComputeWeightsBisection(const ServerStatsList &stats,
+                                                OpType op,
+                                                const SystemLoad load) {
+    const size_t num_servers = stats.size();
+
+    /* Nothing to stabilize with less than 2 servers. */
+    if (num_servers < 2) {
+      return MakeError(EAGAIN);
+    }
+
+    const auto [read_ops, write_ops] = load;
+    const auto total_ops = read_ops + write_ops;
+
+    /* If there is no load in the system, nothing else to do. */
+    if (total_ops == 0) {
+      return MakeError(EAGAIN);
+    }
+
+    const double write_ratio =
+        static_cast<double>(write_ops) / static_cast<double>(total_ops);
+
+    /* Computes the new load each server can take at the target latency on top
+     * of its residual load and returns the total.
+     */
+    ServerWeights shares{0.0};
+    const auto get_shares = [&](double target_latency) {
+      double sum_shares = 0.0;
+      std::ranges::for_each(stats, [&](const auto &srv) {
+        const auto server_id = srv.server_id;
+        const auto &model = models_.at(server_id);
+        const auto srv_load = model.GetLoad(target_latency, op, srv.mode,
+                                            write_ratio, srv.fill_level);
+        const auto share = std::max(srv_load - GetResidualLoad(srv, op), 0.0);
+        shares.at(server_id) = share;
+        sum_shares += share;
+      });
+      return sum_shares;
+    };
+
+    /* The load cannot be served without saturating some server. */
+    const auto d_total_ops = static_cast<double>(total_ops);
+    auto lo = 0.0;
+    auto hi = static_cast<double>(kSaturationLatencyUs);
+    if (get_shares(hi) < d_total_ops) {
+      return MakeError(EAGAIN);
+    }
+
+    for (int i = 0; i < kMaxBisectionIterations; i++) {
+      if (hi - lo <= kBisectionToleranceUs) {
+        break;
+      }
+      const auto mid = (lo + hi) / 2;
+      if (get_shares(mid) >= d_total_ops) {
+        hi = mid;
+      } else {
+        lo = mid;
+      }
+    }
+
+    const auto sum_shares = get_shares(hi);
+    if (sum_shares <= 0.0) {
+      return MakeError(EAGAIN);
+    }
+
+    ServerWeights weights{0.0};
+    std::ranges::for_each(stats, [&](const auto &srv) {
+      const auto server_id = srv.server_id;
+      weights.at(server_id) = shares.at(server_id) / sum_shares;
+    });
+
+    return weights;
+  }
+
   Status<ServerWeights> ComputeWeightsFromPeak(const ServerStatsList &stats,
                                                OpType /*op*/,
                                                const SystemLoad load) {
@@ -269,7 +402,8 @@ class ProfileGuided : public BaseScheduler {
     std::ranges::for_each(stats, [&](const auto &srv) {
       const auto server_id = srv.server_id;
       const auto &model = models_.at(server_id);
-      const auto srv_load = model.GetPeakIOPS(srv.mode, write_ratio);
+      const auto srv_load =
+          model.GetPeakIOPS(srv.mode, write_ratio, srv.fill_level);
       loads.emplace_back(srv_load);
       total_iops_capacity += srv_load;
     });
@@ -284,7 +418,8 @@ class ProfileGuided : public BaseScheduler {
     std::ranges::for_each(stats, [&](const auto &srv) {
       const auto server_id = srv.server_id;
       const auto &model = models_.at(server_id);
-      const auto srv_load = model.GetPeakIOPS(srv.mode, write_ratio);
+      const auto srv_load =
+          model.GetPeakIOPS(srv.mode, write_ratio, srv.fill_level);
       double weight = static_cast<double>(srv_load) /
                       static_cast<double>(total_iops_capacity);
       if (srv_load >= median_load) {
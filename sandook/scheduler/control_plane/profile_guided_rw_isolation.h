@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>  // NOLINT
+#include <cstddef>
 #include <ranges>
 #include <stdexcept>
 #include <string>
@@ -46,6 +47,27 @@ class ProfileGuidedRWIsolation : public BaseScheduler {
     return {};
   }
 
+  /* The modes are computed by rw_, which must reserve the write servers. */
+  void SetMinWriteServers(size_t n_servers) override {
+    BaseScheduler::SetMinWriteServers(n_servers);
+    rw_.SetMinWriteServers(n_servers);
+  }
+
+  Status<void> UpdateModel(ServerID server_id,
+                           const DiskModel &model) override {
+    const auto pg_update = pg_.UpdateModel(server_id, model);
+    if (!pg_update) {
+      return MakeError(pg_update);
+    }
+
+    const auto rw_update = rw_.UpdateModel(server_id, model);
+    if (!rw_update) {
+      return MakeError(rw_update);
+    }
+
+    return {};
+  }
+
   Status<DiskPeakIOPS> GetDiskPeakIOPS(ServerID server_id) const override {
     return pg_.GetDiskPeakIOPS(server_id);
   }
@@ -44,7 +44,7 @@ class RWIsolation : public BaseScheduler {
 
     const size_t num_servers = stats.size();
 
-    if (num_servers <= kNumReplicas) {
+    if (num_servers <= min_write_servers_) {
       /* There are not enough servers in the system for isolation, just keep all
        * servers in mixed mode to handle both reads and writes.
        */
@@ -116,7 +116,7 @@ class RWIsolation : public BaseScheduler {
 
   void UpdateModeSwitchTime() { last_mode_switch_time_ = Time::Now(); }
 
-  static ServerAllocation GetAllocation(const ServerStatsList *stats) {
+  ServerAllocation GetAllocation(const ServerStatsList *stats) const {
     // NOLINTBEGIN
     const double total_writes = std::ranges::fold_left(
         *stats, 0.0, [](double mops, const auto &server) {
@@ -124,12 +124,12 @@ class RWIsolation : public BaseScheduler {
         });
     // NOLINTEND
 
-    /* If there is at least one write, we need to reserve at least kNumReplicas
-     * servers to handle the writes.
+    /* If there is at least one write, we need to reserve at least
+     * min_write_servers_ servers to handle the writes.
      */
     size_t min_w_servers = 0;
     if (total_writes > 0) {
-      min_w_servers = kNumReplicas;
+      min_w_servers = min_write_servers_;
     }
 
     // NOLINTBEGIN
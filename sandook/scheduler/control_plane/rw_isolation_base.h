@@ -1,29 +1,63 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cassert>
 #include <cerrno>
 #include <cmath>
+#include <iterator>
+#include <limits>
+#include <numeric>
 #include <cstddef>
 #include <random>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include "sandook/base/constants.h"
 #include "sandook/base/error.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/time.h"
 #include "sandook/base/types.h"
+#include "sandook/config/config.h"
 #include "sandook/disk_model/disk_model.h"
 #include "sandook/scheduler/control_plane/base_scheduler.h"
+#include "sandook/scheduler/control_plane/load_forecaster.h"
 #include "sandook/telemetry/controller_rw_isolation_telemetry.h"
 #include "sandook/telemetry/telemetry_stream.h"
 
 namespace sandook::schedulers::control_plane {
 
+/* Lookahead of the predictive allocator (in mode switch intervals). */
+constexpr auto kForecastModeSwitchIntervals = 3;
+/* Predicted tail latency improvement that justifies an early mode switch. */
+constexpr auto kModeSwitchCostUs = 50.0;
+/* Latencies within this margin are considered equal. */
+constexpr auto kLatencyToleranceUs = 1.0;
+/* A rotation of the write servers is deferred while the write load is
+ * expected to drop by at least this fraction over the next mode switch
+ * interval, for up to kMaxModeSwitchDeferral intervals in total.
+ */
+constexpr auto kMinWriteLoadDrop = 0.1;
+constexpr auto kMaxModeSwitchDeferral = 2;
+/* Granularity at which write debts are compared. */
+constexpr auto kWriteDebtUnitBytes = static_cast<double>(1ULL << 30);
+/* Fill level beyond which the write amplification is no longer modeled. */
+constexpr auto kMaxDebtFillLevel = 0.9;
+/* Beyond this many distinct SSD profiles the write servers are picked
+ * greedily instead of exhaustively.
+ */
+constexpr size_t kMaxExactServerClasses = 4;
+/* Latency of an idle SSD assumed in the absence of a model. */
+constexpr auto kUnmodeledIdleLatencyUs = 100.0;
+
 class RWIsolationBase : public BaseScheduler {
  public:
-  explicit RWIsolationBase()
-      : rand_generator_(rand_device_()), last_mode_switch_time_(MicroTime()) {}
+  explicit RWIsolationBase(Config::RWIsolationAllocatorType allocator_type =
+                               Config::kRWIsolationAllocatorType)
+      : allocator_type_(allocator_type),
+        rand_generator_(rand_device_()),
+        last_mode_switch_time_(MicroTime()) {}
   ~RWIsolationBase() override = default;
 
   /* No copying. */
@@ -48,7 +82,10 @@ class RWIsolationBase : public BaseScheduler {
     const size_t num_servers = stats.size();
     ServerModes modes;
 
-    if (num_servers <= kNumReplicas) {
+    forecaster_.Update(load);
+    UpdateWriteOrder(stats);
+
+    if (num_servers <= min_write_servers_) {
       /* There are not enough servers in the system for isolation, just keep all
        * servers in mixed mode to handle both reads and writes.
        */
@@ -61,7 +98,9 @@ class RWIsolationBase : public BaseScheduler {
       return modes;
     }
 
-    const auto allocation = GetAllocation(&stats, load);
+    const auto allocation = IsPredictive()
+                                ? GetPredictedAllocation(&stats, load)
+                                : GetAllocation(&stats, load);
     const auto [is_traffic, n_r_servers, n_w_servers] = allocation;
     if (!is_traffic) {
       /* There is no traffic in the system, do not change the allocation and
@@ -96,19 +135,17 @@ class RWIsolationBase : public BaseScheduler {
     UpdateAllocation(allocation);
 
     /* Set the new server allocation. */
-    auto server_id = last_write_server_idx_;
+    auto it = write_order_.cbegin();
 
     /* Assign the write-mode servers. */
-    for (size_t i = 0; i < n_w_servers; i++) {
+    for (size_t i = 0; i < n_w_servers; i++, it++) {
       /* Add 1 to the server ID to account for kInvalidServerID. */
-      modes.at(server_id + 1) = ServerMode::kWrite;
-      server_id = (server_id + 1) % num_servers_;
+      modes.at(*it + 1) = ServerMode::kWrite;
     }
     /* Assign the read-mode servers. */
-    for (size_t i = 0; i < n_r_servers; i++) {
+    for (size_t i = 0; i < n_r_servers; i++, it++) {
       /* Add 1 to the server ID to account for kInvalidServerID. */
-      modes.at(server_id + 1) = ServerMode::kRead;
-      server_id = (server_id + 1) % num_servers_;
+      modes.at(*it + 1) = ServerMode::kRead;
     }
 
     last_write_server_idx_ =
@@ -135,16 +172,34 @@ class RWIsolationBase : public BaseScheduler {
     std::unreachable();
   }
 
+  /* Expected latency of the server at the given load. Without a model, the
+   * server is treated as an M/M/1 queue at its peak IOPS.
+   */
+  virtual double GetLatency(ServerID server_id, OpType op, ServerMode mode,
+                            double load) {
+    const auto peak = static_cast<double>(GetPeakIOPS(server_id, mode));
+    const auto max_latency = static_cast<double>(kSaturationLatencyPenaltyUs);
+    if (load >= peak) {
+      return max_latency;
+    }
+    return std::min(kUnmodeledIdleLatencyUs / (1.0 - (load / peak)),
+                    max_latency);
+  }
+
  private:
+  const Config::RWIsolationAllocatorType allocator_type_;
   std::random_device rand_device_;
   std::mt19937 rand_generator_;
   TelemetryStream<ControllerRWIsolationTelemetry> telemetry_;
+  LoadForecaster forecaster_;
 
   ServerAllocation last_allocation_{false, 0, 0};
   SystemLoad prev_system_load_;
   uint64_t last_mode_switch_time_;
   size_t num_servers_{0};
   size_t last_write_server_idx_{0};
+  /* Servers (ServerID - 1) in the order they are picked for writes. */
+  std::vector<size_t> write_order_;
 
   bool IsLoadIncreased(const SystemLoad load) const {
     const auto [cur_read_load, cur_write_load] = load;
@@ -179,18 +234,306 @@ class RWIsolationBase : public BaseScheduler {
     last_allocation_ = allocation;
   }
 
+  /* Effective write debt of the server: garbage collection has to move more
+   * valid data per byte written on a fuller disk (write amplification of about
+   * 1 / (1 - fill level)).
+   */
+  static double GetWriteDebt(const ServerStats &stats) {
+    const auto fill_level =
+        std::clamp(stats.fill_level, 0.0, kMaxDebtFillLevel);
+    return static_cast<double>(stats.write_debt) / (1.0 - fill_level);
+  }
+
+  /* Orders the servers by their write debt (in units of kWriteDebtUnitBytes
+   * so that small differences do not reorder them), breaking ties
+   * round-robin from last_write_server_idx_. Servers that absorbed the most
+   * writes thus stay in read mode until they recover.
+   */
+  void UpdateWriteOrder(const ServerStatsList &stats) {
+    std::array<double, kNumMaxServers> debts{};
+    for (const auto &srv : stats) {
+      debts.at(srv.server_id) =
+          std::floor(GetWriteDebt(srv) / kWriteDebtUnitBytes);
+    }
+
+    write_order_.clear();
+    auto server_id = last_write_server_idx_;
+    for (size_t i = 0; i < num_servers_; i++) {
+      write_order_.push_back(server_id);
+      server_id = (server_id + 1) % num_servers_;
+    }
+    /* Add 1 to the server ID to account for kInvalidServerID. */
+    std::ranges::stable_sort(write_order_, {}, [&debts](size_t idx) {
+      return debts.at(idx + 1);
+    });
+  }
+
+  [[nodiscard]] bool IsPredictive() const {
+    return allocator_type_ == Config::RWIsolationAllocatorType::kPredictive;
+  }
+
   bool AllocationNeedsUpdate(const ServerAllocation allocation,
                              const SystemLoad load) {
-    return IsAllocationChanged(allocation);
+    if (!IsPredictive()) {
+      return IsAllocationChanged(allocation);
+    }
+
+    const auto [cur_is_traffic, cur_nr, cur_nw] = allocation;
+    const auto [last_is_traffic, last_nr, last_nw] = last_allocation_;
+    if (cur_nw == last_nw) {
+      return false;
+    }
+    /* Moving in or out of isolation cannot wait. */
+    if (cur_nr == 0 || last_nr == 0 || last_nw == 0) {
+      return true;
+    }
+    /* Switch early only if it is worth its cost. */
+    return GetPredictedLatency(last_nw) - GetPredictedLatency(cur_nw) >
+           kModeSwitchCostUs;
   }
 
   bool IsTimeToModeSwitch() const {
     const auto now = MicroTime();
-    return (now - last_mode_switch_time_) >= kModeSwitchIntervalUs;
+    const auto elapsed = now - last_mode_switch_time_;
+    if (elapsed < kModeSwitchIntervalUs || !IsPredictive()) {
+      return elapsed >= kModeSwitchIntervalUs;
+    }
+    if (elapsed >= kMaxModeSwitchDeferral * kModeSwitchIntervalUs) {
+      return true;
+    }
+
+    /* Rotating the write servers while the write load is dropping is cheaper
+     * later, as fewer writes are left in-flight on the servers that switch to
+     * reads (and mix with them during the grace period).
+     */
+    const auto [cur_read_ops, cur_write_ops] = forecaster_.Forecast(0);
+    const auto [next_read_ops, next_write_ops] =
+        forecaster_.Forecast(kModeSwitchIntervalUs);
+    return next_write_ops > cur_write_ops * (1 - kMinWriteLoadDrop);
+  }
+
+  /* Returns the highest latency expected at any server over the lookahead
+   * window if the first n_w_servers in write_order_ served the writes and the
+   * rest served the reads.
+   */
+  double GetPredictedLatency(size_t n_w_servers) {
+    const auto n_r_servers = num_servers_ - n_w_servers;
+    auto max_latency = 0.0;
+    for (int i = 0; i <= kForecastModeSwitchIntervals; i++) {
+      const auto [read_ops, write_ops] =
+          forecaster_.Forecast(i * kModeSwitchIntervalUs);
+      for (size_t j = 0; j < num_servers_; j++) {
+        const auto server_id = write_order_.at(j);
+        const auto is_write = j < n_w_servers;
+        const auto op = is_write ? OpType::kWrite : OpType::kRead;
+        const auto mode = is_write ? ServerMode::kWrite : ServerMode::kRead;
+        const auto load = is_write
+                              ? write_ops / static_cast<double>(n_w_servers)
+                              : read_ops / static_cast<double>(n_r_servers);
+        /* Add 1 to the server ID to account for kInvalidServerID. */
+        max_latency =
+            std::max(max_latency, GetLatency(server_id + 1, op, mode, load));
+      }
+    }
+    return max_latency;
+  }
+
+  /* Chooses the read/write split that minimizes the predicted tail latency,
+   * preferring splits closer to the current one on ties.
+   */
+  ServerAllocation GetPredictedAllocation(const ServerStatsList *stats,
+                                          const SystemLoad load) {
+    const auto allocation = GetAllocation(stats, load);
+    const auto [is_traffic, n_r_servers, n_w_servers] = allocation;
+    /* Nothing to split without both reads and writes. */
+    if (n_r_servers == 0 || n_w_servers == 0 ||
+        num_servers_ <= min_write_servers_ + 1) {
+      return allocation;
+    }
+
+    const auto last_nw = std::get<2>(last_allocation_);
+    const auto distance = [last_nw](size_t n) {
+      return n > last_nw ? n - last_nw : last_nw - n;
+    };
+
+    auto best_nw = n_w_servers;
+    auto best_latency = GetPredictedLatency(best_nw);
+    for (size_t n = min_write_servers_; n < num_servers_; n++) {
+      const auto latency = GetPredictedLatency(n);
+      if (latency < best_latency - kLatencyToleranceUs ||
+          (latency <= best_latency + kLatencyToleranceUs &&
+           distance(n) < distance(best_nw))) {
+        best_nw = n;
+        best_latency = latency;
+      }
+    }
+
+    return {is_traffic, num_servers_ - best_nw, best_nw};
   }
 
   void UpdateModeSwitchTime() { last_mode_switch_time_ = MicroTime(); }
 
+  /* Servers with identical profiles, in write_order_. */
+  struct ServerClass {
+    uint64_t read_iops;
+    uint64_t write_iops;
+    std::vector<size_t> servers;
+  };
+  using ServerClasses = std::vector<ServerClass>;
+  using ClassCounts = std::vector<size_t>;
+
+  /* Selects the write servers for the given write load and moves them to the
+   * front of write_order_ (otherwise keeping its order); returns how many
+   * there are.
+   *
+   * The selection is the set of servers that can absorb the write load while
+   * giving up the least read capacity, so on heterogeneous clusters the disks
+   * that write best relative to how they read take the writes. Servers with
+   * identical profiles are interchangeable, so only the number of servers
+   * taken from each class is chosen, and within a class the servers are taken
+   * in write_order_.
+   */
+  size_t SelectWriteServers(uint64_t write_ops, size_t min_w_servers,
+                            size_t n_servers) {
+    constexpr size_t kExtraWriteSSDs = 1;
+    n_servers = std::min(n_servers, write_order_.size());
+
+    ServerClasses classes;
+    for (size_t i = 0; i < n_servers; i++) {
+      const auto idx = write_order_[i];
+      /* Add 1 to the server ID to account for kInvalidServerID. */
+      const auto read_iops = GetPeakIOPS(idx + 1, ServerMode::kRead);
+      const auto write_iops = GetPeakIOPS(idx + 1, ServerMode::kMix);
+      auto it = std::ranges::find_if(classes, [&](const auto &c) {
+        return c.read_iops == read_iops && c.write_iops == write_iops;
+      });
+      if (it == classes.end()) {
+        classes.push_back({.read_iops = read_iops,
+                           .write_iops = write_iops,
+                           .servers = {}});
+        it = std::prev(classes.end());
+      }
+      it->servers.push_back(idx);
+    }
+
+    auto counts = (classes.size() <= kMaxExactServerClasses)
+                      ? CoverExact(classes, write_ops)
+                      : CoverGreedy(classes, write_ops);
+
+    /* Allocate some additional write SSDs to be safe. */
+    auto n_w_servers = std::accumulate(counts.begin(), counts.end(), 0UZ);
+    const auto target = std::min(
+        n_servers, std::max(min_w_servers, n_w_servers + kExtraWriteSSDs));
+    while (n_w_servers < target) {
+      counts.at(GetCheapestClass(classes, counts))++;
+      n_w_servers++;
+    }
+
+    std::array<bool, kNumMaxServers> is_write{};
+    for (size_t k = 0; k < classes.size(); k++) {
+      for (size_t i = 0; i < counts[k]; i++) {
+        is_write.at(classes[k].servers[i]) = true;
+      }
+    }
+    std::ranges::stable_partition(
+        write_order_, [&is_write](size_t idx) { return is_write.at(idx); });
+
+    return n_w_servers;
+  }
+
+  /* Returns the class with unselected servers that gives up the least read
+   * capacity per unit of write capacity.
+   */
+  static size_t GetCheapestClass(const ServerClasses &classes,
+                                 const ClassCounts &counts) {
+    auto best = classes.size();
+    for (size_t k = 0; k < classes.size(); k++) {
+      if (counts[k] == classes[k].servers.size()) {
+        continue;
+      }
+      if (best == classes.size() || IsCheaper(classes[k], classes[best])) {
+        best = k;
+      }
+    }
+    assert(best != classes.size());
+    return best;
+  }
+
+  /* Compares read_iops / write_iops across the two classes. */
+  static bool IsCheaper(const ServerClass &a, const ServerClass &b) {
+    return static_cast<double>(a.read_iops) *
+               static_cast<double>(b.write_iops) <
+           static_cast<double>(b.read_iops) *
+               static_cast<double>(a.write_iops);
+  }
+
+  /* Enumerates the counts taken from each class for the cheapest set that
+   * covers write_ops (fewest servers on ties); takes all the servers if none
+   * does.
+   */
+  static ClassCounts CoverExact(const ServerClasses &classes,
+                                uint64_t write_ops) {
+    ClassCounts counts(classes.size(), 0);
+    ClassCounts best;
+    auto best_cost = std::numeric_limits<uint64_t>::max();
+    auto best_n = std::numeric_limits<size_t>::max();
+
+    const auto search = [&](auto &self, size_t k, uint64_t capacity,
+                            uint64_t cost, size_t n) -> void {
+      if (cost > best_cost) {
+        return;
+      }
+      if (capacity >= write_ops) {
+        /* Taking more servers can only cost more. */
+        if (cost < best_cost || n < best_n) {
+          best = counts;
+          best_cost = cost;
+          best_n = n;
+        }
+        return;
+      }
+      if (k == classes.size()) {
+        return;
+      }
+
+      const auto &c = classes[k];
+      for (size_t i = 0; i <= c.servers.size(); i++) {
+        counts[k] = i;
+        self(self, k + 1, capacity + (i * c.write_iops),
+             cost + (i * c.read_iops), n + i);
+      }
+      counts[k] = 0;
+    };
+    search(search, 0, 0, 0, 0);
+
+    if (best.empty()) {
+      for (size_t k = 0; k < classes.size(); k++) {
+        counts[k] = classes[k].servers.size();
+      }
+      return counts;
+    }
+    return best;
+  }
+
+  /* Takes servers from the classes in order of GetCheapestClass() until they
+   * cover write_ops.
+   */
+  static ClassCounts CoverGreedy(const ServerClasses &classes,
+                                 uint64_t write_ops) {
+    ClassCounts counts(classes.size(), 0);
+    const auto n_servers = std::accumulate(
+        classes.begin(), classes.end(), 0UZ,
+        [](size_t n, const auto &c) { return n + c.servers.size(); });
+
+    uint64_t capacity = 0;
+    for (size_t n = 0; n < n_servers && capacity < write_ops; n++) {
+      const auto k = GetCheapestClass(classes, counts);
+      counts[k]++;
+      capacity += classes[k].write_iops;
+    }
+    return counts;
+  }
+
   ServerAllocation GetAllocation(const ServerStatsList *stats,
                                  const SystemLoad load) {
     const auto n_servers = stats->size();
@@ -211,11 +554,11 @@ class RWIsolationBase : public BaseScheduler {
     const auto total_ops = read_ops + write_ops;
 
     /* If there is at least one write operation, we need to reserve at least
-     * kNumReplicas servers to handle the writes.
+     * min_write_servers_ servers to handle the writes.
      */
     size_t min_w_servers = 0;
     if (all_writes > 0 || write_ops > 0) {
-      min_w_servers = kNumReplicas;
+      min_w_servers = min_write_servers_;
     }
 
     size_t n_r_servers = 0;
@@ -225,33 +568,12 @@ class RWIsolationBase : public BaseScheduler {
      * servers in mix mode; this is indicated by returning both n_r_servers and
      * n_w_servers as zero.
      */
-    const auto kExtraWriteSSDs = 1;
     if (read_ops != 0 && write_ops != 0) {
-      /* Find the actual demand of write servers based on the write IOPS
-       * currently in the system and the profiles of the SSDs.
-       */
-      uint64_t handled_writes = 0;
-      auto server_id = last_write_server_idx_;
-      size_t dem_w_servers = 0;
-      while (true) {
-        if (handled_writes >= write_ops || dem_w_servers == n_servers) {
-          break;
-        }
-
-        /* Add 1 to the server ID to account for kInvalidServerID. */
-        const auto server_w_tput = GetPeakIOPS(server_id + 1, ServerMode::kMix);
-        handled_writes += server_w_tput;
-        dem_w_servers += 1;
-        server_id = (server_id + 1) % num_servers_;
-      }
-      /* Allocate some additional write SSDs to be safe. */
-      dem_w_servers += kExtraWriteSSDs;
-
-      /* Compute the number of write servers to allocate considering the demand
-       * of write IOPS and the minimum number of servers required for block
-       * replication.
+      /* Select the write servers based on the write IOPS currently in the
+       * system and the profiles of the SSDs, considering the minimum number of
+       * servers required for block replication.
        */
-      n_w_servers = std::min(n_servers, std::max(min_w_servers, dem_w_servers));
+      n_w_servers = SelectWriteServers(write_ops, min_w_servers, n_servers);
 
       /* Assign the remaining servers as read servers. */
       n_r_servers = n_servers - n_w_servers;
@@ -19,6 +19,7 @@
 #include "sandook/bindings/timer.h"
 #include "sandook/config/config.h"
 #include "sandook/disk_model/disk_model.h"
+#include "sandook/disk_model/disk_model_learner.h"
 #include "sandook/scheduler/control_plane/adaptive_rw_isolation_weak.h"
 #include "sandook/scheduler/control_plane/base_scheduler.h"
 #include "sandook/scheduler/control_plane/no_op.h"
@@ -35,6 +36,11 @@ namespace sandook::schedulers::control_plane {
 using TelemetryMap =
     std::array<std::unique_ptr<TelemetryStream<DiskServerTelemetry>>,
                kNumMaxServers>;
+using DiskModelLearners =
+    std::array<std::unique_ptr<DiskModelLearner>, kNumMaxServers>;
+
+/* Interval to push the (online) refined disk models to the scheduler. */
+constexpr auto kModelRefreshIntervalUs = 1 * kOneSecond;
 
 class Scheduler {
  public:
@@ -99,6 +105,11 @@ class Scheduler {
 
     stats_mgr_.AddServer(server_id, name);
 
+    if (Config::kDiskModelOnlineLearning) {
+      learners_.at(server_id) = std::make_unique<DiskModelLearner>(
+          model != nullptr ? *model : DiskModel(name));
+    }
+
     /* Create a telemetry stream for the server. */
     const auto telemetry_tag = std::to_string(server_id) + "_" + name;
     telemetry_map_.at(server_id) =
@@ -109,6 +120,10 @@ class Scheduler {
     return {};
   }
 
+  void SetMinWriteServers(size_t n_servers) {
+    sched_->SetMinWriteServers(n_servers);
+  }
+
   Status<DiskPeakIOPS> GetDiskPeakIOPS(ServerID server_id) const {
     return sched_->GetDiskPeakIOPS(server_id);
   }
@@ -132,6 +147,11 @@ class Scheduler {
                                  is_update_system_load);
     telemetry_map_.at(server_id)->TraceBuffered(DiskServerTelemetry(stats));
 
+    /* Learn from the stats reported by the disk server. */
+    if (is_update_system_load && learners_.at(server_id)) {
+      learners_.at(server_id)->Observe(stats);
+    }
+
     return {};
   }
 
@@ -222,6 +242,8 @@ class Scheduler {
   ServerStatsManager stats_mgr_;
   std::unique_ptr<BaseScheduler> sched_;
   TelemetryMap telemetry_map_;
+  DiskModelLearners learners_;
+  uint64_t last_model_refresh_us_{0};
 
   bool stop_{false};
   bool freeze_weights_{false};
@@ -233,10 +255,30 @@ class Scheduler {
     return sched_->ComputeModes(stats, load);
   }
 
+  void RefreshModels() {
+    for (size_t i = 0; i < num_servers_; i++) {
+      const auto server_id = i + kInvalidServerID + 1;
+      auto &learner = learners_.at(server_id);
+      if (!learner) {
+        continue;
+      }
+
+      const auto ret = sched_->UpdateModel(server_id, learner->GetModel());
+      if (!ret) {
+        LOG(WARN) << "Cannot update model for server: " << server_id;
+      }
+    }
+  }
+
   void Run() {
     const Duration interval(kControlPlaneUpdateIntervalUs);
 
     while (!stop_) {
+      if (Config::kDiskModelOnlineLearning &&
+          MicroTime() - last_model_refresh_us_ >= kModelRefreshIntervalUs) {
+        RefreshModels();
+        last_model_refresh_us_ = MicroTime();
+      }
       Update();
       rt::Sleep(interval);
     }
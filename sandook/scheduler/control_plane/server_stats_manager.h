@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdint>
@@ -26,6 +27,11 @@ namespace sandook::schedulers::control_plane {
 constexpr static auto kControllerLoggingIntervalUs = 1 * kOneSecond;
 constexpr static auto kLoadCalculationIntervalUs = 10 * kOneMilliSecond;
 
+/* Rate at which an SSD in read mode is assumed to pay down its write debt
+ * (i.e., to garbage collect in the background).
+ */
+constexpr static uint64_t kGCRecoveryBytesPerSec = 512ULL << kMiBShift;
+
 constexpr static double kLoadScaleFactor =
     static_cast<double>(kOneSecond) /
     static_cast<double>(kLoadCalculationIntervalUs);
@@ -63,6 +69,7 @@ class ServerStatsManager {
     stats->write_weight = kDefaultServerWeight;
 
     stats_map_.at(server_id) = std::move(stats);
+    last_debt_update_us_.at(server_id) = MicroTime();
 
     servers_.insert(server_id);
   }
@@ -117,9 +124,19 @@ class ServerStatsManager {
     {
       const std::unique_lock lock(stats_lock_);
 
+      /* The write debt is only tracked here. */
+      const auto &old_stats = *stats_map_.at(server_id);
+      new_stats->write_debt = old_stats.write_debt;
+
       if (is_update_load) {
         stats_system_reads_ += reads;
         stats_system_writes_ += writes;
+
+        const auto now = MicroTime();
+        auto &last_update_us = last_debt_update_us_.at(server_id);
+        new_stats->write_debt = GetWriteDebt(old_stats, stats.completed_writes,
+                                             now - last_update_us);
+        last_update_us = now;
       }
 
       stats_map_.at(server_id) = std::move(new_stats);
@@ -142,6 +159,7 @@ class ServerStatsManager {
   ServerStatsMap stats_map_;
   uint64_t stats_system_reads_{0};
   uint64_t stats_system_writes_{0};
+  std::array<uint64_t, kNumMaxServers> last_debt_update_us_{};
   rt::SharedMutex stats_lock_;
 
   uint64_t read_ops_{0};
@@ -152,6 +170,19 @@ class ServerStatsManager {
   rt::Thread th_load_calculator_;
   rt::Thread th_stats_logger_;
 
+  /* Writes (in sectors) add to the debt of a server while read mode pays it
+   * down.
+   */
+  static uint64_t GetWriteDebt(const ServerStats &old_stats, uint64_t writes,
+                               uint64_t elapsed_us) {
+    auto debt = old_stats.write_debt + (writes << kSectorShift);
+    if (old_stats.mode == ServerMode::kRead) {
+      const auto recovered = kGCRecoveryBytesPerSec * elapsed_us / kOneSecond;
+      debt -= std::min(debt, recovered);
+    }
+    return debt;
+  }
+
   void CalculateLoad() {
     uint64_t system_reads = 0;
     uint64_t system_writes = 0;
@@ -4,6 +4,7 @@
 #include "sandook/base/io_desc.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
+#include "sandook/scheduler/data_plane/server_table.h"
 
 namespace sandook::schedulers::data_plane {
 
@@ -19,7 +20,8 @@ class BaseReadScheduler {
   BaseReadScheduler(BaseReadScheduler &&other) = delete;
   BaseReadScheduler &operator=(BaseReadScheduler &&other) = delete;
 
-  virtual Status<ServerID> SelectReadServer(const ServerWeights &weights,
+  /* Selects one of the servers in subset (among the choices). */
+  virtual Status<ServerID> SelectReadServer(const ServerChoices &choices,
                                             const ServerSet *subset,
                                             VolumeID vol_id,
                                             const IODesc *iod) = 0;
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <cstddef>
+#include <span>
+
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
+#include "sandook/scheduler/data_plane/server_table.h"
 
 namespace sandook::schedulers::data_plane {
 
@@ -19,8 +23,26 @@ class BaseWriteScheduler {
   BaseWriteScheduler(BaseWriteScheduler &&other) = delete;
   BaseWriteScheduler &operator=(BaseWriteScheduler &&other) = delete;
 
-  virtual Status<ServerReplicaList> SelectWriteReplicas(
-      const ServerWeights &weights, VolumeID vol_id, const IODesc *iod) = 0;
+  /* Selects a server among the choices for each of the blocks of a write
+   * (e.g., its replicas), distinct if there are enough servers; otherwise the
+   * blocks left over go to the first server.
+   */
+  virtual Status<void> SelectWriteServers(const ServerChoices &choices,
+                                          VolumeID vol_id, const IODesc *iod,
+                                          std::span<ServerID> servers) = 0;
+
+  /* Selects a server among the choices for each of num_replicas replicas. */
+  Status<ServerReplicaList> SelectWriteReplicas(const ServerChoices &choices,
+                                                VolumeID vol_id,
+                                                const IODesc *iod,
+                                                size_t num_replicas) {
+    ServerReplicaList replicas(num_replicas);
+    const auto ret = SelectWriteServers(choices, vol_id, iod, replicas);
+    if (!ret) {
+      return MakeError(ret);
+    }
+    return replicas;
+  }
 
  protected:
   BaseWriteScheduler() = default;
@@ -42,6 +42,9 @@ class CongestionControl {
     for (auto &factor : cc_rate_limits_) {
       factor = kBestUncongestedRateLimit;
     }
+    for (auto &factor : coordinated_rate_limits_) {
+      factor = 0;
+    }
     for (auto &congested_at : congested_at_) {
       congested_at = 0;
     }
@@ -112,7 +115,24 @@ class CongestionControl {
     states_.at(server_id) = state;
   }
 
+  /* Sets the rate limit allocated by the controller at the server, which
+   * overrides the one from AIMD. Once the controller stops allocating the rate
+   * (limit is 0), AIMD resumes from the last allocated limit.
+   */
+  void SetCoordinatedRateLimit(ServerID server_id, RateLimit limit) {
+    const auto prev_limit = coordinated_rate_limits_.at(server_id);
+    if (limit == 0 && prev_limit != 0) {
+      const rt::MutexGuard lock(cc_lock_);
+      cc_rate_limits_.at(server_id) = prev_limit;
+    }
+    coordinated_rate_limits_.at(server_id) = limit;
+  }
+
   [[nodiscard]] RateLimit GetRateLimit(ServerID server_id) const {
+    const auto coordinated_limit = coordinated_rate_limits_.at(server_id);
+    if (coordinated_limit != 0) {
+      return coordinated_limit;
+    }
     return cc_rate_limits_.at(server_id);
   }
 
@@ -123,6 +143,7 @@ class CongestionControl {
   std::array<uint64_t, kNumMaxServers> congested_at_;
   std::array<uint64_t, kNumMaxServers> congestion_responded_at_;
   std::array<RateLimit, kNumMaxServers> cc_rate_limits_;
+  std::array<RateLimit, kNumMaxServers> coordinated_rate_limits_;
   TelemetryMap telemetry_map_;
 
   bool stop_{false};
@@ -1,10 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
-#include <iterator>
-#include <random>
+#include <functional>
+#include <span>
+#include <utility>
 
 #include "sandook/base/constants.h"
 #include "sandook/base/error.h"
@@ -13,13 +17,31 @@
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/scheduler/data_plane/base_write_scheduler.h"
-#include "sandook/scheduler/data_plane/common.h"
+#include "sandook/scheduler/data_plane/server_load.h"
+#include "sandook/scheduler/data_plane/server_table.h"
 
 namespace sandook::schedulers::data_plane {
 
+/* Places the replicas of a write by (weighted) rendezvous hashing: each server
+ * scores the address of the write by hashing it with the ID of the server and
+ * scaling it by the write weight of the server, and the replicas go to the
+ * servers with the highest scores (in different failure domains where
+ * possible). An address therefore keeps its servers unless one of them stops
+ * taking writes (e.g., switches modes), in which case only the replicas on
+ * that server move.
+ *
+ * The load is bounded: servers with more than kLoadBound times the average of
+ * the requests in flight (as observed by this client) are passed over while
+ * enough others are left, so a hot range of addresses spills over to the next
+ * servers in its order.
+ */
 class HashWrite : public BaseWriteScheduler {
  public:
-  HashWrite() : rand_gen_(rand_dev_()) {}
+  constexpr static auto kLoadBound = 1.25;
+
+  explicit HashWrite(const ServerLoad *load) : load_(load) {
+    assert(load_ != nullptr);
+  }
   ~HashWrite() override = default;
 
   /* No copying. */
@@ -30,44 +52,90 @@ class HashWrite : public BaseWriteScheduler {
   HashWrite(HashWrite &&other) = delete;
   HashWrite &operator=(HashWrite &&other) = delete;
 
-  Status<ServerReplicaList> SelectWriteReplicas(const ServerWeights &weights,
-                                                VolumeID vol_id,
-                                                const IODesc *iod) override {
+  Status<void> SelectWriteServers(const ServerChoices &choices,
+                                  VolumeID vol_id, const IODesc *iod,
+                                  std::span<ServerID> servers) override {
     assert(iod != nullptr);
 
-    const auto servers = GetValidServers(weights);
-    assert(!servers.empty());
-
-    ServerReplicaList replicas{};
-    if (servers.size() == kNumReplicas) {
-      /* Just copy all servers as the replicas. */
-      std::copy(servers.begin(), servers.end(), replicas.begin());
-    } else {
-      ServerSet choices(servers.cbegin(), servers.cend());
-      const auto n_options =
-          std::min(static_cast<int>(choices.size()), kNumReplicas);
-      for (int i = 0; i < n_options; i++) {
-        const auto h = Hash(vol_id, iod->start_sector);
-        const auto idx = static_cast<int64_t>(h % choices.size());
-        const auto choice = std::next(choices.begin(), idx);
-        replicas.at(i) = *choice;
-        choices.erase(choice);
-      }
-      if (n_options < kNumReplicas) {
-        /* If not all kNumReplicas were found, use a default option to fill in
-         * the remaining ones.
-         */
-        const auto def = replicas.at(0);
-        std::ranges::fill(replicas.begin() + n_options, replicas.end(), def);
+    const auto options = choices.servers();
+    assert(!options.empty());
+
+    if (options.size() == servers.size()) {
+      /* Just copy all options as the servers. */
+      std::ranges::copy(options, servers.begin());
+      return {};
+    }
+
+    /* Order the servers by their scores for the address. */
+    const auto key = Hash(vol_id, iod->start_sector);
+    const bool is_weighted = choices.total_weight() > 0;
+    std::array<std::pair<double, ServerID>, kNumMaxServers> ranks{};
+    int64_t total_inflight = 0;
+    for (size_t i = 0; i < options.size(); i++) {
+      const auto server_id = options[i];
+      const auto weight = is_weighted ? choices.weight(server_id) : 1.0;
+      ranks.at(i) = {GetScore(key, server_id, weight), server_id};
+      total_inflight += std::max<int64_t>(load_->inflight(server_id), 0);
+    }
+    const auto ranked = std::span(ranks.data(), options.size());
+    std::ranges::sort(ranked, std::greater{});
+
+    /* Take the first server in order for each block that is away from the
+     * ones taken (see ServerChoices::GetReplicaExclusion), skipping the
+     * overloaded servers unless only they are left.
+     */
+    const auto max_inflight = static_cast<int64_t>(
+        std::ceil(kLoadBound * static_cast<double>(total_inflight) /
+                  static_cast<double>(options.size())));
+    const auto n_options = std::min(options.size(), servers.size());
+    for (size_t i = 0; i < n_options; i++) {
+      const auto is_excluded = choices.GetReplicaExclusion(servers.first(i));
+      const auto is_allowed = [&](const auto &rank) {
+        return !is_excluded(rank.second);
+      };
+      const auto is_underloaded = [&](const auto &rank) {
+        return is_allowed(rank) && load_->inflight(rank.second) <= max_inflight;
+      };
+
+      auto it = std::ranges::find_if(ranked, is_underloaded);
+      if (it == ranked.end()) {
+        it = std::ranges::find_if(ranked, is_allowed);
       }
+      assert(it != ranked.end());
+      servers[i] = it->second;
+    }
+
+    if (n_options < servers.size()) {
+      /* If not all servers were found, use a default option to fill in the
+       * remaining ones.
+       */
+      const auto def = servers.front();
+      std::ranges::fill(servers.subspan(n_options), def);
     }
 
-    return replicas;
+    return {};
   }
 
  private:
-  std::random_device rand_dev_;
-  std::mt19937 rand_gen_;
+  const ServerLoad *load_;
+
+  /* Returns the score of the server for the key, such that the highest score
+   * among servers falls on each server in proportion to its weight, i.e.,
+   * -weight / ln(u) for a uniform u in (0, 1) drawn from the key and the
+   * server.
+   */
+  [[nodiscard]] static double GetScore(size_t key, ServerID server_id,
+                                       ServerWeight weight) {
+    if (weight <= 0) {
+      return 0;
+    }
+
+    /* The top 53 bits fill the mantissa of a double. */
+    constexpr static auto kScale = 1.0 / (1ULL << 53);
+    const auto h = Mix(key ^ Mix(server_id));
+    const auto u = (static_cast<double>(h >> 11) + 0.5) * kScale;
+    return -weight / std::log(u);
+  }
 };
 
 }  // namespace sandook::schedulers::data_plane
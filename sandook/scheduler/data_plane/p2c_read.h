@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <limits>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/error.h"
+#include "sandook/base/io_desc.h"
+#include "sandook/base/random.h"
+#include "sandook/base/server_stats.h"
+#include "sandook/base/types.h"
+#include "sandook/scheduler/data_plane/base_read_scheduler.h"
+#include "sandook/scheduler/data_plane/server_load.h"
+#include "sandook/scheduler/data_plane/server_table.h"
+
+namespace sandook::schedulers::data_plane {
+
+/* Power of two choices: picks two of the servers at random and reads from the
+ * one that is expected to serve the read sooner, going by the load this client
+ * observes at each server and by the weights of the servers.
+ */
+class P2CRead : public BaseReadScheduler {
+ public:
+  explicit P2CRead(const ServerLoad *load) : load_(load) {
+    assert(load_ != nullptr);
+  }
+  ~P2CRead() override = default;
+
+  /* No copying. */
+  P2CRead(const P2CRead &) = delete;
+  P2CRead &operator=(const P2CRead &) = delete;
+
+  /* No moving. */
+  P2CRead(P2CRead &&other) = delete;
+  P2CRead &operator=(P2CRead &&other) = delete;
+
+  Status<ServerID> SelectReadServer(
+      const ServerChoices &choices, const ServerSet *subset,
+      [[maybe_unused]] VolumeID vol_id,
+      [[maybe_unused]] const IODesc *iod) override {
+    assert(subset != nullptr);
+
+    std::array<ServerID, kNumMaxServers> candidates{};
+    size_t n_candidates = 0;
+    for (const auto server_id : *subset) {
+      if (choices.is_valid(server_id)) {
+        candidates.at(n_candidates++) = server_id;
+      }
+    }
+    if (n_candidates == 0) {
+      return MakeError(ENOENT);
+    }
+    if (n_candidates == 1) {
+      return candidates.at(0);
+    }
+
+    /* Two distinct candidates. */
+    const auto i = rand_.Below(n_candidates);
+    auto j = rand_.Below(n_candidates - 1);
+    j += (j >= i) ? 1 : 0;
+
+    const auto first = candidates.at(i);
+    const auto second = candidates.at(j);
+    return (GetCost(choices, second) < GetCost(choices, first)) ? second
+                                                                 : first;
+  }
+
+ private:
+  const ServerLoad *load_;
+  CoreLocalRandom rand_;
+
+  /* Expected time for the server to serve one more read (in us) relative to
+   * its weight: the reads queued at it, including this one, each take as long
+   * as its recent reads did.
+   */
+  [[nodiscard]] double GetCost(const ServerChoices &choices,
+                               ServerID server_id) const {
+    const auto weight = choices.weight(server_id);
+    if (weight <= 0) {
+      return std::numeric_limits<double>::infinity();
+    }
+
+    const auto queued =
+        static_cast<double>(std::max<int64_t>(load_->inflight(server_id), 0));
+    const auto latency_us = std::max(load_->latency_us(server_id), 1.0);
+    return (queued + 1) * latency_us / weight;
+  }
+};
+
+}  // namespace sandook::schedulers::data_plane
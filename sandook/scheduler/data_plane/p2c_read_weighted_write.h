@@ -0,0 +1,46 @@
+#pragma once
+
+#include <span>
+
+#include "sandook/base/error.h"
+#include "sandook/base/io_desc.h"
+#include "sandook/base/server_stats.h"
+#include "sandook/base/types.h"
+#include "sandook/scheduler/data_plane/base_scheduler.h"
+#include "sandook/scheduler/data_plane/p2c_read.h"
+#include "sandook/scheduler/data_plane/server_load.h"
+#include "sandook/scheduler/data_plane/weighted_write.h"
+
+namespace sandook::schedulers::data_plane {
+
+class P2CReadWeightedWrite : public BaseScheduler {
+ public:
+  explicit P2CReadWeightedWrite(const ServerLoad *load) : read_sched_(load) {}
+  ~P2CReadWeightedWrite() override = default;
+
+  /* No copying. */
+  P2CReadWeightedWrite(const P2CReadWeightedWrite &) = delete;
+  P2CReadWeightedWrite &operator=(const P2CReadWeightedWrite &) = delete;
+
+  /* No moving. */
+  P2CReadWeightedWrite(P2CReadWeightedWrite &&other) = delete;
+  P2CReadWeightedWrite &operator=(P2CReadWeightedWrite &&other) = delete;
+
+  Status<ServerID> SelectReadServer(const ServerChoices &choices,
+                                    const ServerSet *subset, VolumeID vol_id,
+                                    const IODesc *iod) override {
+    return read_sched_.SelectReadServer(choices, subset, vol_id, iod);
+  }
+
+  Status<void> SelectWriteServers(const ServerChoices &choices,
+                                  VolumeID vol_id, const IODesc *iod,
+                                  std::span<ServerID> servers) override {
+    return write_sched_.SelectWriteServers(choices, vol_id, iod, servers);
+  }
+
+ private:
+  P2CRead read_sched_;
+  WeightedWrite write_sched_;
+};
+
+}  // namespace sandook::schedulers::data_plane
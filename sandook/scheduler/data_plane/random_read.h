@@ -1,24 +1,22 @@
 #pragma once
 
-#include <algorithm>
 #include <cassert>
 #include <cerrno>
-#include <iterator>
-#include <random>
-#include <vector>
+#include <utility>
 
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
+#include "sandook/base/random.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/scheduler/data_plane/base_read_scheduler.h"
-#include "sandook/scheduler/data_plane/common.h"
+#include "sandook/scheduler/data_plane/server_table.h"
 
 namespace sandook::schedulers::data_plane {
 
 class RandomRead : public BaseReadScheduler {
  public:
-  RandomRead() : rand_gen_(rand_dev_()) {}
+  RandomRead() = default;
   ~RandomRead() override = default;
 
   /* No copying. */
@@ -30,33 +28,31 @@ class RandomRead : public BaseReadScheduler {
   RandomRead &operator=(RandomRead &&other) = delete;
 
   Status<ServerID> SelectReadServer(
-      const ServerWeights &weights, const ServerSet *subset,
+      const ServerChoices &choices, const ServerSet *subset,
       [[maybe_unused]] VolumeID vol_id,
       [[maybe_unused]] const IODesc *iod) override {
     assert(subset != nullptr);
 
-    const auto servers = GetValidServers(weights);
-    assert(!servers.empty());
-
-    std::vector<ServerID> choices;
-    std::ranges::set_intersection(servers, *subset,
-                                  std::back_inserter(choices));
-
-    if (choices.empty()) {
+    int n_choices = 0;
+    for (const auto server_id : *subset) {
+      n_choices += choices.is_valid(server_id) ? 1 : 0;
+    }
+    if (n_choices == 0) {
       return MakeError(ENOENT);
     }
 
-    const auto n_choices = static_cast<int>(choices.size());
-    std::uniform_int_distribution<> dist(0, n_choices - 1);
-    const auto idx = dist(rand_gen_);
-    const auto chosen = choices.at(idx);
+    auto idx = static_cast<int>(rand_.Below(n_choices));
+    for (const auto server_id : *subset) {
+      if (choices.is_valid(server_id) && idx-- == 0) {
+        return server_id;
+      }
+    }
 
-    return chosen;
+    std::unreachable();
   }
 
  private:
-  std::random_device rand_dev_;
-  std::mt19937 rand_gen_;
+  CoreLocalRandom rand_;
 };
 
 }  // namespace sandook::schedulers::data_plane
@@ -1,18 +1,21 @@
 #pragma once
 
+#include <span>
+
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/scheduler/data_plane/base_scheduler.h"
 #include "sandook/scheduler/data_plane/hash_write.h"
+#include "sandook/scheduler/data_plane/server_load.h"
 #include "sandook/scheduler/data_plane/random_read.h"
 
 namespace sandook::schedulers::data_plane {
 
 class RandomReadHashWrite : public BaseScheduler {
  public:
-  RandomReadHashWrite() = default;
+  explicit RandomReadHashWrite(const ServerLoad *load) : write_sched_(load) {}
   ~RandomReadHashWrite() override = default;
 
   /* No copying. */
@@ -23,16 +26,16 @@ class RandomReadHashWrite : public BaseScheduler {
   RandomReadHashWrite(RandomReadHashWrite &&other) = delete;
   RandomReadHashWrite &operator=(RandomReadHashWrite &&other) = delete;
 
-  Status<ServerID> SelectReadServer(const ServerWeights &weights,
+  Status<ServerID> SelectReadServer(const ServerChoices &choices,
                                     const ServerSet *subset, VolumeID vol_id,
                                     const IODesc *iod) override {
-    return read_sched_.SelectReadServer(weights, subset, vol_id, iod);
+    return read_sched_.SelectReadServer(choices, subset, vol_id, iod);
   }
 
-  Status<ServerReplicaList> SelectWriteReplicas(const ServerWeights &weights,
-                                                VolumeID vol_id,
-                                                const IODesc *iod) override {
-    return write_sched_.SelectWriteReplicas(weights, vol_id, iod);
+  Status<void> SelectWriteServers(const ServerChoices &choices,
+                                  VolumeID vol_id, const IODesc *iod,
+                                  std::span<ServerID> servers) override {
+    return write_sched_.SelectWriteServers(choices, vol_id, iod, servers);
   }
 
  private:
@@ -2,21 +2,25 @@
 
 #include <algorithm>
 #include <cassert>
-#include <random>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
 
 #include "sandook/base/constants.h"
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
+#include "sandook/base/random.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/scheduler/data_plane/base_write_scheduler.h"
-#include "sandook/scheduler/data_plane/common.h"
+#include "sandook/scheduler/data_plane/server_table.h"
 
 namespace sandook::schedulers::data_plane {
 
 class RandomWrite : public BaseWriteScheduler {
  public:
-  RandomWrite() : rand_gen_(rand_dev_()) {}
+  RandomWrite() = default;
   ~RandomWrite() override = default;
 
   /* No copying. */
@@ -27,36 +31,57 @@ class RandomWrite : public BaseWriteScheduler {
   RandomWrite(RandomWrite &&other) = delete;
   RandomWrite &operator=(RandomWrite &&other) = delete;
 
-  Status<ServerReplicaList> SelectWriteReplicas(
-      const ServerWeights &weights, [[maybe_unused]] VolumeID vol_id,
-      [[maybe_unused]] const IODesc *iod) override {
-    const auto servers = GetValidServers(weights);
-    assert(!servers.empty());
+  Status<void> SelectWriteServers(const ServerChoices &choices,
+                                  [[maybe_unused]] VolumeID vol_id,
+                                  [[maybe_unused]] const IODesc *iod,
+                                  std::span<ServerID> servers) override {
+    const auto options = choices.servers();
+    assert(!options.empty());
 
-    ServerReplicaList replicas{};
-    if (servers.size() == kNumReplicas) {
-      /* Just copy all servers as the replicas. */
-      std::copy(servers.begin(), servers.end(), replicas.begin());
+    if (options.size() == servers.size()) {
+      /* Just copy all options as the servers. */
+      std::ranges::copy(options, servers.begin());
     } else {
-      /* First shuffle them all. */
-      const auto n_servers = static_cast<int>(servers.size());
-      const auto n_samples = std::min(n_servers, kNumReplicas);
-      std::ranges::sample(servers, replicas.begin(), n_samples, rand_gen_);
-      if (n_samples < kNumReplicas) {
-        /* If not all kNumReplicas were found, use a default option to fill in
-         * the remaining ones.
+      /* Uniform selection (without replacement, across failure domains). */
+      const auto n_samples = std::min(options.size(), servers.size());
+      for (size_t i = 0; i < n_samples; i++) {
+        servers[i] = DrawReplica(choices, servers.first(i));
+      }
+      if (n_samples < servers.size()) {
+        /* If not all servers were found, use a default option to fill in the
+         * remaining ones.
          */
-        const auto def = replicas.at(0);
-        std::ranges::fill(replicas.begin() + n_samples, replicas.end(), def);
+        const auto def = servers.front();
+        std::ranges::fill(servers.subspan(n_samples), def);
       }
     }
 
-    return replicas;
+    return {};
   }
 
  private:
-  std::random_device rand_dev_;
-  std::mt19937 rand_gen_;
+  CoreLocalRandom rand_;
+
+  /* Draws a server for the block after the chosen ones, away from them (see
+   * ServerChoices::GetReplicaExclusion).
+   */
+  ServerID DrawReplica(const ServerChoices &choices,
+                       std::span<const ServerID> chosen) {
+    const auto is_excluded = choices.GetReplicaExclusion(chosen);
+    const auto n_left = std::ranges::count_if(
+        choices.servers(),
+        [&](ServerID server_id) { return !is_excluded(server_id); });
+    assert(n_left > 0);
+
+    auto idx = rand_.Below(static_cast<uint64_t>(n_left));
+    for (const auto server_id : choices.servers()) {
+      if (!is_excluded(server_id) && idx-- == 0) {
+        return server_id;
+      }
+    }
+
+    std::unreachable();
+  }
 };
 
 }  // namespace sandook::schedulers::data_plane
@@ -1,17 +1,33 @@
 #pragma once
 
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <stdexcept>
 
+#include "sandook/base/constants.h"
+#include "sandook/base/counter.h"
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
+#include "sandook/base/location.h"
+#include "sandook/base/qos.h"
 #include "sandook/base/server_stats.h"
+#include "sandook/base/time.h"
 #include "sandook/base/types.h"
+#include "sandook/bindings/rcu.h"
+#include "sandook/bindings/sync.h"
+#include "sandook/bindings/timer.h"
 #include "sandook/config/config.h"
 #include "sandook/scheduler/data_plane/base_scheduler.h"
+#include "sandook/scheduler/data_plane/p2c_read_weighted_write.h"
 #include "sandook/scheduler/data_plane/random_read_hash_write.h"
 #include "sandook/scheduler/data_plane/random_read_write.h"
+#include "sandook/scheduler/data_plane/server_load.h"
 #include "sandook/scheduler/data_plane/server_stats_manager.h"
+#include "sandook/scheduler/data_plane/token_bucket.h"
 #include "sandook/scheduler/data_plane/weighted_read_hash_write.h"
 #include "sandook/scheduler/data_plane/weighted_read_write.h"
 
@@ -25,9 +41,14 @@ class Scheduler {
   explicit Scheduler(Config::DataPlaneSchedulerType sched_type)
       : Scheduler(sched_type, kInvalidVolumeID) {}
 
-  explicit Scheduler(Config::DataPlaneSchedulerType sched_type, VolumeID vol_id)
-      : vol_id_(vol_id) {
-    stats_mgr_ = std::make_unique<ServerStatsManager>(vol_id_);
+  explicit Scheduler(Config::DataPlaneSchedulerType sched_type, VolumeID vol_id,
+                     size_t num_replicas = kDefaultNumReplicas,
+                     bool is_erasure_coded = false)
+      : vol_id_(vol_id),
+        num_replicas_(num_replicas),
+        is_erasure_coded_(is_erasure_coded) {
+    stats_mgr_ = std::make_unique<ServerStatsManager>(
+        vol_id_, Config::kLocation, num_replicas_);
 
     switch (sched_type) {
       case Config::DataPlaneSchedulerType::kWeightedReadWrite:
@@ -39,11 +60,15 @@ class Scheduler {
         break;
 
       case Config::DataPlaneSchedulerType::kWeightedReadHashWrite:
-        sched_ = std::make_unique<WeightedReadHashWrite>();
+        sched_ = std::make_unique<WeightedReadHashWrite>(&load_);
         break;
 
       case Config::DataPlaneSchedulerType::kRandomReadHashWrite:
-        sched_ = std::make_unique<RandomReadHashWrite>();
+        sched_ = std::make_unique<RandomReadHashWrite>(&load_);
+        break;
+
+      case Config::DataPlaneSchedulerType::kP2CReadWeightedWrite:
+        sched_ = std::make_unique<P2CReadWeightedWrite>(&load_);
         break;
 
       default:
@@ -59,8 +84,8 @@ class Scheduler {
   Scheduler(Scheduler &&other) = delete;
   Scheduler &operator=(Scheduler &&other) = delete;
 
-  Status<void> AddServer(ServerID server_id) {
-    return stats_mgr_->AddServer(server_id);
+  Status<void> AddServer(ServerID server_id, Location location = {}) {
+    return stats_mgr_->AddServer(server_id, location);
   }
 
   Status<void> SetServerStats(const ServerStatsList &servers) {
@@ -69,42 +94,153 @@ class Scheduler {
 
   Status<ServerID> SelectReadServer(const ServerSet *subset, VolumeID vol_id,
                                     const IODesc *iod) {
-    auto weights = stats_mgr_->GetReadOnlyWeights();
-    if (weights) {
-      const auto srv = sched_->SelectReadServer(*weights, subset, vol_id, iod);
+    rt::RCURead l;
+    rt::RCUReadGuard g(l);
+    const auto *table = stats_mgr_->GetTable();
+
+    if (!table->read_only.servers().empty()) {
+      const auto srv =
+          sched_->SelectReadServer(table->read_only, subset, vol_id, iod);
       if (srv) {
+        CountOp(*srv);
         return *srv;
       }
     }
 
-    /* Either read-only weights were not found or a selection could not be made
+    /* Either read-only servers were not found or a selection could not be made
      * from read-only servers for the current request; try among all servers. */
-    weights = stats_mgr_->GetAllReadWeights();
-    if (!weights) {
-      return MakeError(weights);
+    if (table->all_reads.servers().empty()) {
+      return MakeError(ENOENT);
     }
 
-    return sched_->SelectReadServer(*weights, subset, vol_id, iod);
+    const auto srv =
+        sched_->SelectReadServer(table->all_reads, subset, vol_id, iod);
+    if (srv) {
+      CountOp(*srv);
+    }
+    return srv;
   }
 
   Status<ServerReplicaList> SelectWriteReplicas(VolumeID vol_id,
                                                 const IODesc *iod) {
-    const auto weights = stats_mgr_->GetWriteWeights();
-    if (!weights) {
-      return MakeError(weights);
+    rt::RCURead l;
+    rt::RCUReadGuard g(l);
+    const auto *table = stats_mgr_->GetTable();
+    if (table->writes.servers().empty()) {
+      return MakeError(ENOENT);
     }
 
-    return sched_->SelectWriteReplicas(*weights, vol_id, iod);
+    const auto replicas =
+        sched_->SelectWriteReplicas(table->writes, vol_id, iod, num_replicas_);
+    if (replicas) {
+      for (const auto server_id : *replicas) {
+        CountOp(server_id);
+      }
+    }
+    return replicas;
   }
 
+  /* Selects a distinct server for each of the blocks of a write (e.g., the
+   * blocks of a stripe), or fails if fewer servers take writes.
+   */
+  Status<void> SelectWriteServers(VolumeID vol_id, const IODesc *iod,
+                                  std::span<ServerID> servers) {
+    rt::RCURead l;
+    rt::RCUReadGuard g(l);
+    const auto *table = stats_mgr_->GetTable();
+    if (table->writes.servers().size() < servers.size()) {
+      return MakeError(ENOENT);
+    }
+
+    const auto ret =
+        sched_->SelectWriteServers(table->writes, vol_id, iod, servers);
+    if (ret) {
+      for (const auto server_id : servers) {
+        CountOp(server_id);
+      }
+    }
+    return ret;
+  }
+
+  /* Tracks a request sent to the server (see ServerLoad). */
+  void StartOp(ServerID server_id) { load_.Start(server_id); }
+
+  void CompleteOp(ServerID server_id, uint64_t latency_us) {
+    load_.Complete(server_id, latency_us);
+  }
+
+  void AbortOp(ServerID server_id) { load_.Abort(server_id); }
+
   void SignalCongested(ServerID server_id) {
     stats_mgr_->SignalCongested(server_id);
   }
 
+  /* Sets the rate limits that the controller allocated to this volume at
+   * congested servers (0 where the local congestion control applies).
+   */
+  void SetCoordinatedRateLimits(const ServerRateLimits &limits) {
+    stats_mgr_->SetCoordinatedRateLimits(limits);
+  }
+
+  /* Returns the ops sent so far to each server. */
+  [[nodiscard]] ServerOps GetServerOps() const {
+    ServerOps ops{};
+    for (const auto &core : server_ops_) {
+      for (size_t i = 0; i < kNumMaxServers; i++) {
+        ops.at(i) += core.ops.at(i);
+      }
+    }
+    return ops;
+  }
+
+  /* Sets the rate allocated to the QoS class of this volume (0 if unlimited).
+   */
+  void SetQoSRate(uint64_t rate) { qos_bucket_.SetRate(rate); }
+
+  /* Blocks until the request fits within the QoS rate of this volume. */
+  void Throttle(const IODesc *iod) {
+    const auto cost = GetQoSCost(IODesc::get_op(iod), iod->num_sectors,
+                                 num_replicas_, is_erasure_coded_);
+    qos_demand_.inc_local(static_cast<int64_t>(cost));
+
+    const auto wait_us = qos_bucket_.Take(cost);
+    if (wait_us > 0) {
+      rt::Sleep(Duration(static_cast<int64_t>(wait_us)));
+    }
+  }
+
+  /* Returns the tokens requested so far, which the controller uses to
+   * redistribute the reservations that volumes do not use.
+   */
+  [[nodiscard]] uint64_t GetQoSDemand() {
+    return static_cast<uint64_t>(qos_demand_.get_sum());
+  }
+
  private:
   std::unique_ptr<ServerStatsManager> stats_mgr_;
+  ServerLoad load_;
   std::unique_ptr<BaseScheduler> sched_;
   VolumeID vol_id_{kInvalidVolumeID};
+  /* Replication factor of the volume, i.e., the servers each write goes to. */
+  size_t num_replicas_{kDefaultNumReplicas};
+  /* Whether writes of the volume are striped (see GetQoSCost). */
+  bool is_erasure_coded_{false};
+
+  TokenBucket qos_bucket_;
+  ThreadSafeCounter qos_demand_;
+
+  /* Ops sent to each server, counted per core. */
+  struct alignas(kCacheLineSizeBytes) CoreServerOps {
+    ServerOps ops;
+  };
+  std::array<CoreServerOps, kMaxNumCores> server_ops_{};
+
+  void CountOp(ServerID server_id) {
+    rt::Preempt p;
+    rt::PreemptGuard g(p);
+
+    server_ops_.at(p.get_cpu()).ops.at(server_id)++;
+  }
 };
 
 }  // namespace sandook::schedulers::data_plane
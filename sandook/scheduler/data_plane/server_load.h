@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/types.h"
+
+namespace sandook::schedulers::data_plane {
+
+/* Load of each server as observed by this client: the requests in flight to
+ * it and the latency of the requests it completed. Unlike the server stats
+ * pulled from the controller, it is updated by every request and so reflects
+ * a stalling server right away.
+ */
+class ServerLoad {
+ public:
+  /* Weight of the latest sample in the (EWMA) latency. */
+  constexpr static auto kLatencyEWMAWeight = 0.125;
+
+  ServerLoad() = default;
+  ~ServerLoad() = default;
+
+  /* No copying. */
+  ServerLoad(const ServerLoad &) = delete;
+  ServerLoad &operator=(const ServerLoad &) = delete;
+
+  /* No moving. */
+  ServerLoad(ServerLoad &&) noexcept;
+  ServerLoad &operator=(ServerLoad &&) noexcept;
+
+  void Start(ServerID server_id) {
+    servers_.at(server_id).inflight.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /* Completes a request that the server served in latency_us. */
+  void Complete(ServerID server_id, uint64_t latency_us) {
+    auto &srv = servers_.at(server_id);
+    srv.inflight.fetch_sub(1, std::memory_order_relaxed);
+
+    /* Concurrent updates may lose a sample, which is fine for an estimate. */
+    const auto prev = srv.latency_us.load(std::memory_order_relaxed);
+    const auto sample = static_cast<double>(latency_us);
+    const auto next = (prev == 0)
+                          ? sample
+                          : prev + kLatencyEWMAWeight * (sample - prev);
+    srv.latency_us.store(next, std::memory_order_relaxed);
+  }
+
+  /* Completes a request that the server did not serve (e.g., rejected it). */
+  void Abort(ServerID server_id) {
+    servers_.at(server_id).inflight.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] int64_t inflight(ServerID server_id) const {
+    return servers_.at(server_id).inflight.load(std::memory_order_relaxed);
+  }
+
+  /* Returns the latency (in us) of the server, or 0 if it is not known yet. */
+  [[nodiscard]] double latency_us(ServerID server_id) const {
+    return servers_.at(server_id).latency_us.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct alignas(kCacheLineSizeBytes) Server {
+    std::atomic<int64_t> inflight{0};
+    std::atomic<double> latency_us{0};
+  };
+
+  std::array<Server, kNumMaxServers> servers_{};
+};
+
+}  // namespace sandook::schedulers::data_plane
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstddef>
 #include <memory>
 #include <ranges>
@@ -10,12 +11,14 @@
 
 #include "sandook/base/constants.h"
 #include "sandook/base/error.h"
+#include "sandook/base/location.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/time.h"
 #include "sandook/base/types.h"
 #include "sandook/bindings/rcu.h"
 #include "sandook/bindings/sync.h"
 #include "sandook/scheduler/data_plane/congestion_control.h"
+#include "sandook/scheduler/data_plane/server_table.h"
 
 constexpr static auto kMinReadServers = 1;
 
@@ -23,13 +26,23 @@ namespace sandook::schedulers::data_plane {
 
 constexpr static auto kDataPlaneLoggingIntervalUs = 1 * kOneSecond;
 
+/* Share of the read weight of a server that is kept per unit of network cost
+ * from this client to it (see GetNetworkCost).
+ */
+constexpr static auto kNetworkCostReadDiscount = 0.25;
+
 class ServerStatsManager {
  public:
-  ServerStatsManager(VolumeID vol_id)
-      : vol_id_(vol_id), th_stats_logger_([this]() { StatsLogger(); }) {
+  ServerStatsManager(VolumeID vol_id, Location location = {},
+                     size_t num_replicas = kDefaultNumReplicas)
+      : vol_id_(vol_id),
+        location_(location),
+        num_replicas_(num_replicas),
+        th_stats_logger_([this]() { StatsLogger(); }) {
     cc_ = std::make_unique<CongestionControl>(vol_id);
     InitServerWeights(read_weights_);
     InitServerWeights(write_weights_);
+    PublishTable();
   }
 
   ~ServerStatsManager() {
@@ -45,11 +58,12 @@ class ServerStatsManager {
   ServerStatsManager(ServerStatsManager &&) noexcept;
   ServerStatsManager &operator=(ServerStatsManager &&) noexcept;
 
-  Status<void> AddServer(ServerID server_id) {
+  Status<void> AddServer(ServerID server_id, Location location = {}) {
     const auto ret = servers_.insert(server_id);
     if (!ret.second) {
       return MakeError(EALREADY);
     }
+    locations_.at(server_id) = location;
     return cc_->AddServer(server_id);
   }
 
@@ -59,6 +73,12 @@ class ServerStatsManager {
     cc_->SetCongestionState(server_id, state);
   }
 
+  void SetCoordinatedRateLimits(const ServerRateLimits &limits) {
+    for (auto server_id : servers_) {
+      cc_->SetCoordinatedRateLimit(server_id, limits.at(server_id));
+    }
+  }
+
   Status<void> SetServerStats(const ServerStatsList &servers) {
     std::ranges::for_each(servers, [&](const auto &srv) {
       assert(servers_.find(srv.server_id) != servers_.end());
@@ -67,76 +87,90 @@ class ServerStatsManager {
       write_weights_.at(srv.server_id) = srv.write_weight;
       SetCongestionState(srv.server_id, srv.congestion_state);
     });
+    PublishTable();
     return {};
   }
 
-  [[nodiscard]] Status<ServerWeights> GetReadOnlyWeights() const {
-    auto all_read_weights = GetRateLimitedReadWeights();
+  /* Returns the table to select servers from, as of the last update of the
+   * server stats (including the rate limits at that time). Preemption must be
+   * disabled while the table is used (see rt::RCUPtr).
+   */
+  [[nodiscard]] const ServerTable *GetTable() const { return table_.get(); }
 
-    /* 1) Find servers that are in read mode. */
-    ServerWeights filtered_read_weights;
-    InitServerWeights(filtered_read_weights);
+ private:
+  VolumeID vol_id_;
+  Location location_;
+  size_t num_replicas_;
+  ServerSet servers_;
+  ServerLocations locations_{};
+  ServerModes modes_;
+  ServerWeights read_weights_;
+  ServerWeights write_weights_;
+  std::unique_ptr<CongestionControl> cc_;
 
-    size_t n_found = 0;
-    for (auto server_id : servers_) {
-      if (modes_.at(server_id) != ServerMode::kRead) {
-        continue;
-      }
-      n_found++;
-      filtered_read_weights.at(server_id) = all_read_weights.at(server_id);
-    }
-    if (n_found >= kMinReadServers) {
-      return filtered_read_weights;
-    }
+  /* Serializes the writers of the table. */
+  rt::Mutex table_lock_;
+  std::unique_ptr<ServerTable> owned_table_;
+  rt::RCUPtr<ServerTable> table_;
 
-    /* 2) If all servers were filtered out, then just return all servers and
-     * hope that the request lands on a server accepting reads.
-     * Otherwise this will be tried again.
-     */
-    return all_read_weights;
-  }
+  bool stop_{false};
+  rt::Thread th_stats_logger_;
 
-  [[nodiscard]] Status<ServerWeights> GetAllReadWeights() const {
-    return GetRateLimitedReadWeights();
-  }
+  void PublishTable() {
+    auto table = std::make_unique<ServerTable>();
 
-  [[nodiscard]] Status<ServerWeights> GetWriteWeights() const {
-    auto all_write_weights = GetRateLimitedWriteWeights();
+    const auto read_weights = GetLocalReadWeights(GetRateLimitedReadWeights());
+    table->all_reads.Build(read_weights, locations_);
 
-    /* 1) Find servers that are not in read mode. */
-    ServerWeights filtered_write_weights;
-    InitServerWeights(filtered_write_weights);
+    /* Prefer servers that are in read mode; if too few of them are, then
+     * just use all servers and hope that the request lands on a server
+     * accepting reads. Otherwise this will be tried again.
+     */
+    const auto read_only_weights = FilterWeights(
+        read_weights,
+        [](ServerMode mode) { return mode == ServerMode::kRead; },
+        kMinReadServers);
+    table->read_only.Build(read_only_weights, locations_);
+
+    /* Likewise, prefer servers that are not in read mode for writes. */
+    const auto write_weights = FilterWeights(
+        GetRateLimitedWriteWeights(),
+        [](ServerMode mode) { return mode != ServerMode::kRead; },
+        num_replicas_);
+    table->writes.Build(write_weights, locations_);
+
+    const rt::MutexGuard lock(table_lock_);
+    table_.set(table.get());
+    if (owned_table_) {
+      rt::RCUFree(std::move(owned_table_));
+    }
+    owned_table_ = std::move(table);
+  }
+
+  /* Returns the weights of the servers whose mode matches, unless fewer than
+   * min_servers match, in which case all the weights are returned.
+   */
+  template <typename F>
+  [[nodiscard]] ServerWeights FilterWeights(const ServerWeights &weights,
+                                            F is_match,
+                                            size_t min_servers) const {
+    ServerWeights filtered_weights;
+    InitServerWeights(filtered_weights);
 
     size_t n_found = 0;
     for (auto server_id : servers_) {
-      if (modes_.at(server_id) == ServerMode::kRead) {
+      if (!is_match(modes_.at(server_id))) {
         continue;
       }
       n_found++;
-      filtered_write_weights.at(server_id) = all_write_weights.at(server_id);
+      filtered_weights.at(server_id) = weights.at(server_id);
     }
-    if (n_found >= kNumReplicas) {
-      return filtered_write_weights;
+    if (n_found >= min_servers) {
+      return filtered_weights;
     }
-
-    /* 2) If all servers were filtered out, then just return all servers and
-     * hope that the request lands on a server accepting writes.
-     * Otherwise this will be tried again.
-     */
-    return all_write_weights;
+    return weights;
   }
 
- private:
-  VolumeID vol_id_;
-  ServerSet servers_;
-  ServerModes modes_;
-  ServerWeights read_weights_;
-  ServerWeights write_weights_;
-  std::unique_ptr<CongestionControl> cc_;
-
-  bool stop_{false};
-  rt::Thread th_stats_logger_;
-
   [[nodiscard]] ServerWeights GetRateLimitedReadWeights() const {
     ServerWeights weights = read_weights_;
     for (auto server_id : servers_) {
@@ -145,6 +179,18 @@ class ServerStatsManager {
     return weights;
   }
 
+  /* Discounts the read weights of servers by the network cost to them, so that
+   * reads prefer the closest replica. Congestion is already priced in by the
+   * rate limits that the weights are scaled by.
+   */
+  [[nodiscard]] ServerWeights GetLocalReadWeights(ServerWeights weights) const {
+    for (auto server_id : servers_) {
+      const auto cost = GetNetworkCost(location_, locations_.at(server_id));
+      weights.at(server_id) *= std::pow(kNetworkCostReadDiscount, cost);
+    }
+    return weights;
+  }
+
   [[nodiscard]] ServerWeights GetRateLimitedWriteWeights() const {
     ServerWeights weights = write_weights_;
     for (auto server_id : servers_) {
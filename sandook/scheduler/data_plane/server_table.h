@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/location.h"
+#include "sandook/base/server_stats.h"
+#include "sandook/base/types.h"
+#include "sandook/bindings/rcu.h"
+
+namespace sandook::schedulers::data_plane {
+
+using ServerLocations = std::array<Location, kNumMaxServers>;
+
+/* Servers to choose from for one kind of selection, with their weights. */
+class ServerChoices {
+ public:
+  ServerChoices() { InitServerWeights(weights_); }
+
+  void Build(const ServerWeights &weights, const ServerLocations &locations) {
+    weights_ = weights;
+    locations_ = locations;
+    n_servers_ = 0;
+    total_weight_ = 0;
+    for (size_t i = kInvalidServerID + 1; i < weights.size(); i++) {
+      if (weights.at(i) == kInvalidServerWeight) {
+        continue;
+      }
+      total_weight_ += weights.at(i);
+      servers_.at(n_servers_) = static_cast<ServerID>(i);
+      cumulative_weights_.at(n_servers_) = total_weight_;
+      n_servers_++;
+    }
+  }
+
+  /* Valid servers in increasing order of their IDs. */
+  [[nodiscard]] std::span<const ServerID> servers() const {
+    return {servers_.data(), n_servers_};
+  }
+
+  [[nodiscard]] bool is_valid(ServerID server_id) const {
+    return weights_.at(server_id) != kInvalidServerWeight;
+  }
+
+  [[nodiscard]] ServerWeight weight(ServerID server_id) const {
+    return weights_.at(server_id);
+  }
+
+  [[nodiscard]] ServerWeight total_weight() const { return total_weight_; }
+
+  [[nodiscard]] const Location &location(ServerID server_id) const {
+    return locations_.at(server_id);
+  }
+
+  /* Returns a predicate of the servers that may not take the next replica of a
+   * write, given the servers chosen for its replicas so far: the chosen
+   * servers, and the servers in the failure domains of the chosen ones while
+   * servers in other failure domains are left, or else the servers in their
+   * racks while servers in other racks are left.
+   */
+  [[nodiscard]] auto GetReplicaExclusion(
+      std::span<const ServerID> chosen) const {
+    const auto is_any_far = [&](auto is_near) {
+      return std::ranges::any_of(servers(), [&](ServerID server_id) {
+        return !IsNear(server_id, chosen, is_near);
+      });
+    };
+    const bool is_domain_spread = is_any_far(IsSameFailureDomain);
+    const bool is_rack_spread = !is_domain_spread && is_any_far(IsSameRack);
+    return [this, chosen, is_domain_spread,
+            is_rack_spread](ServerID server_id) {
+      if (is_domain_spread) {
+        return IsNear(server_id, chosen, IsSameFailureDomain);
+      }
+      if (is_rack_spread) {
+        return IsNear(server_id, chosen, IsSameRack);
+      }
+      return std::ranges::find(chosen, server_id) != chosen.end();
+    };
+  }
+
+  /* Returns the server at the given fraction (in [0, 1)) of the total weight,
+   * i.e., a server drawn in proportion to its weight for a uniform fraction.
+   * Falls back to a uniform choice if no server has a weight. There must be
+   * at least one server.
+   */
+  [[nodiscard]] ServerID Draw(double fraction) const {
+    if (total_weight_ <= 0) {
+      const auto idx = static_cast<size_t>(fraction * n_servers_);
+      return servers_.at(std::min(idx, n_servers_ - 1));
+    }
+
+    const auto cumulative = std::span(cumulative_weights_.data(), n_servers_);
+    const auto it =
+        std::ranges::upper_bound(cumulative, fraction * total_weight_);
+    const auto idx = static_cast<size_t>(it - cumulative.begin());
+    return servers_.at(std::min(idx, n_servers_ - 1));
+  }
+
+ private:
+  ServerWeights weights_;
+  ServerLocations locations_{};
+  std::array<ServerID, kNumMaxServers> servers_{};
+  std::array<ServerWeight, kNumMaxServers> cumulative_weights_{};
+  size_t n_servers_{0};
+  ServerWeight total_weight_{0};
+
+  /* Returns true if the server is one of the chosen ones or is_near (a
+   * location predicate) holds for it and one of them.
+   */
+  template <typename F>
+  [[nodiscard]] bool IsNear(ServerID server_id,
+                            std::span<const ServerID> chosen,
+                            F is_near) const {
+    return std::ranges::any_of(chosen, [&](ServerID other) {
+      return other == server_id ||
+             is_near(locations_.at(other), locations_.at(server_id));
+    });
+  }
+};
+
+/* Everything the data plane selects servers from, built whenever the server
+ * stats are updated and published via RCU, so that selections neither lock
+ * nor allocate.
+ */
+struct ServerTable : public rt::RCUObject {
+  /* Servers in read mode (or all servers if there are too few of them). */
+  ServerChoices read_only;
+  /* All servers for reads. */
+  ServerChoices all_reads;
+  /* Servers not in read mode (or all servers if there are too few of them). */
+  ServerChoices writes;
+};
+
+}  // namespace sandook::schedulers::data_plane
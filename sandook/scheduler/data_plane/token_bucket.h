@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/time.h"
+#include "sandook/bindings/sync.h"
+
+namespace sandook::schedulers::data_plane {
+
+/* Paces requests to a rate of tokens per second.
+ *
+ * Implemented as a virtual scheduling (GCRA) token bucket: every request
+ * advances the time at which the bucket is next empty by the time it takes to
+ * refill its tokens, and waits until that time is within a burst of now. Idle
+ * periods do not accumulate more than kBurstUs worth of tokens.
+ */
+class TokenBucket {
+ public:
+  constexpr static uint64_t kBurstUs = 1 * kOneMilliSecond;
+
+  TokenBucket() = default;
+  ~TokenBucket() = default;
+
+  /* No copying. */
+  TokenBucket(const TokenBucket &) = delete;
+  TokenBucket &operator=(const TokenBucket &) = delete;
+
+  /* No moving. */
+  TokenBucket(TokenBucket &&) noexcept;
+  TokenBucket &operator=(TokenBucket &&) noexcept;
+
+  /* Sets the rate in tokens per second (0 if unlimited). */
+  void SetRate(uint64_t rate) { rate_ = rate; }
+
+  [[nodiscard]] uint64_t rate() const { return rate_; }
+
+  /* Takes the tokens and returns how long (in us) the caller must wait before
+   * using them.
+   */
+  [[nodiscard]] uint64_t Take(uint64_t tokens) {
+    const uint64_t rate = rate_;
+    if (rate == 0) {
+      return 0;
+    }
+
+    const auto now = static_cast<double>(MicroTime());
+    const auto refill_us =
+        static_cast<double>(tokens) * kOneSecond / static_cast<double>(rate);
+
+    rt::SpinGuard g(lock_);
+    empty_at_us_ = std::max(empty_at_us_, now) + refill_us;
+    const auto wait_us = empty_at_us_ - now - kBurstUs;
+    return (wait_us > 0) ? static_cast<uint64_t>(wait_us) : 0;
+  }
+
+ private:
+  std::atomic<uint64_t> rate_{0};
+
+  rt::Spin lock_;
+  /* Time at which all the tokens taken so far are refilled. */
+  double empty_at_us_{0};
+};
+
+}  // namespace sandook::schedulers::data_plane
@@ -1,25 +1,21 @@
 #pragma once
 
-#include <algorithm>
 #include <cassert>
 #include <cerrno>
-#include <iterator>
-#include <random>
-#include <ranges>
-#include <vector>
 
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
+#include "sandook/base/random.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/scheduler/data_plane/base_read_scheduler.h"
-#include "sandook/scheduler/data_plane/common.h"
+#include "sandook/scheduler/data_plane/server_table.h"
 
 namespace sandook::schedulers::data_plane {
 
 class WeightedRead : public BaseReadScheduler {
  public:
-  WeightedRead() : rand_gen_(rand_dev_()) {}
+  WeightedRead() = default;
   ~WeightedRead() override = default;
 
   /* No copying. */
@@ -31,37 +27,43 @@ class WeightedRead : public BaseReadScheduler {
   WeightedRead &operator=(WeightedRead &&other) = delete;
 
   Status<ServerID> SelectReadServer(
-      const ServerWeights &weights, const ServerSet *subset,
+      const ServerChoices &choices, const ServerSet *subset,
       [[maybe_unused]] VolumeID vol_id,
       [[maybe_unused]] const IODesc *iod) override {
     assert(subset != nullptr);
 
-    const auto servers = GetValidServers(weights);
-    assert(!servers.empty());
-
-    std::vector<ServerID> choices;
-    std::ranges::set_intersection(servers, *subset,
-                                  std::back_inserter(choices));
-    if (choices.empty()) {
+    /* The subset is small (the replicas of a block), so the weights of its
+     * valid servers are summed on the fly.
+     */
+    ServerWeight total_weight = 0;
+    ServerID last_valid = kInvalidServerID;
+    for (const auto server_id : *subset) {
+      if (choices.is_valid(server_id)) {
+        total_weight += choices.weight(server_id);
+        last_valid = server_id;
+      }
+    }
+    if (last_valid == kInvalidServerID) {
       return MakeError(ENOENT);
     }
 
-    auto t_weights = std::views::all(choices) |
-                     std::views::transform([&](const auto &choice) {
-                       assert(choice != kInvalidServerID);
-                       return weights.at(choice);
-                     });
-
-    std::discrete_distribution<> dist(t_weights.cbegin(), t_weights.cend());
-    const auto idx = dist(rand_gen_);
-    const auto chosen = choices.at(idx);
+    auto target = rand_.Uniform() * total_weight;
+    for (const auto server_id : *subset) {
+      if (!choices.is_valid(server_id)) {
+        continue;
+      }
+      target -= choices.weight(server_id);
+      if (target < 0) {
+        return server_id;
+      }
+    }
 
-    return chosen;
+    /* Rounding (or all weights being zero). */
+    return last_valid;
   }
 
  private:
-  std::random_device rand_dev_;
-  std::mt19937 rand_gen_;
+  CoreLocalRandom rand_;
 };
 
 }  // namespace sandook::schedulers::data_plane
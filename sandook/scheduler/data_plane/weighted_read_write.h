@@ -1,5 +1,7 @@
 #pragma once
 
+#include <span>
+
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
 #include "sandook/base/server_stats.h"
@@ -23,16 +25,16 @@ class WeightedReadWrite : public BaseScheduler {
   WeightedReadWrite(WeightedReadWrite &&other) = delete;
   WeightedReadWrite &operator=(WeightedReadWrite &&other) = delete;
 
-  Status<ServerID> SelectReadServer(const ServerWeights &weights,
+  Status<ServerID> SelectReadServer(const ServerChoices &choices,
                                     const ServerSet *subset, VolumeID vol_id,
                                     const IODesc *iod) override {
-    return read_sched_.SelectReadServer(weights, subset, vol_id, iod);
+    return read_sched_.SelectReadServer(choices, subset, vol_id, iod);
   }
 
-  Status<ServerReplicaList> SelectWriteReplicas(const ServerWeights &weights,
-                                                VolumeID vol_id,
-                                                const IODesc *iod) override {
-    return write_sched_.SelectWriteReplicas(weights, vol_id, iod);
+  Status<void> SelectWriteServers(const ServerChoices &choices,
+                                  VolumeID vol_id, const IODesc *iod,
+                                  std::span<ServerID> servers) override {
+    return write_sched_.SelectWriteServers(choices, vol_id, iod, servers);
   }
 
  private:
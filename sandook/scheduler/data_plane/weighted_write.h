@@ -2,23 +2,28 @@
 
 #include <algorithm>
 #include <cassert>
-#include <iterator>
-#include <random>
-#include <ranges>
+#include <cstddef>
+#include <span>
 
 #include "sandook/base/constants.h"
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
+#include "sandook/base/random.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/scheduler/data_plane/base_write_scheduler.h"
-#include "sandook/scheduler/data_plane/common.h"
+#include "sandook/scheduler/data_plane/server_table.h"
 
 namespace sandook::schedulers::data_plane {
 
 class WeightedWrite : public BaseWriteScheduler {
  public:
-  WeightedWrite() : rand_gen_(rand_dev_()) {}
+  /* Draws of a server that land on an excluded server before drawing among
+   * the servers left instead.
+   */
+  constexpr static auto kMaxRedraws = 4;
+
+  WeightedWrite() = default;
   ~WeightedWrite() override = default;
 
   /* No copying. */
@@ -29,53 +34,80 @@ class WeightedWrite : public BaseWriteScheduler {
   WeightedWrite(WeightedWrite &&other) = delete;
   WeightedWrite &operator=(WeightedWrite &&other) = delete;
 
-  Status<ServerReplicaList> SelectWriteReplicas(
-      const ServerWeights &weights, [[maybe_unused]] VolumeID vol_id,
-      [[maybe_unused]] const IODesc *iod) override {
+  Status<void> SelectWriteServers(const ServerChoices &choices,
+                                  [[maybe_unused]] VolumeID vol_id,
+                                  [[maybe_unused]] const IODesc *iod,
+                                  std::span<ServerID> servers) override {
     assert(iod != nullptr);
 
-    const auto servers = GetValidServers(weights);
-    assert(!servers.empty());
+    const auto options = choices.servers();
+    assert(!options.empty());
 
-    const auto n_servers = static_cast<int>(servers.size());
-    ServerReplicaList replicas{};
-    if (n_servers == kNumReplicas) {
-      /* Just copy all servers as the replicas. */
-      std::copy(servers.begin(), servers.end(), replicas.begin());
-    } else if (n_servers < kNumReplicas) {
+    if (options.size() == servers.size()) {
+      /* Just copy all options as the servers. */
+      std::ranges::copy(options, servers.begin());
+    } else if (options.size() < servers.size()) {
       /* First shuffle them all. */
-      const auto n_samples = std::min(n_servers, kNumReplicas);
-      std::ranges::sample(servers, replicas.begin(), n_samples, rand_gen_);
+      rand_.Apply([&](WyRand &gen) {
+        const auto n = static_cast<std::ptrdiff_t>(options.size());
+        return std::ranges::sample(options, servers.begin(), n, gen);
+      });
       /* Use a default option to fill in the remaining ones. */
-      const auto def = replicas.at(0);
-      std::ranges::fill(replicas.begin() + n_samples, replicas.end(), def);
+      const auto def = servers.front();
+      std::ranges::fill(servers.subspan(options.size()), def);
     } else {
-      /* Weighted selection. */
-      int i = 0;
-      ServerSet unique_servers(servers.begin(), servers.end());
-      while (i < kNumReplicas) {
-        auto t_weights = std::views::all(unique_servers) |
-                         std::views::transform([&](const auto &choice) {
-                           assert(choice != kInvalidServerID);
-                           return weights.at(choice);
-                         });
-
-        std::discrete_distribution<> dist(t_weights.cbegin(), t_weights.cend());
-        const auto idx = dist(rand_gen_);
-
-        auto it = unique_servers.begin();
-        std::advance(it, idx);
-        replicas.at(i++) = *it;
-        unique_servers.erase(it);
+      /* Weighted selection (without replacement, across failure domains). */
+      for (size_t i = 0; i < servers.size(); i++) {
+        servers[i] = DrawReplica(choices, servers.first(i));
       }
     }
 
-    return replicas;
+    return {};
   }
 
  private:
-  std::random_device rand_dev_;
-  std::mt19937 rand_gen_;
+  CoreLocalRandom rand_;
+
+  /* Draws a server for the block after the chosen ones, away from them (see
+   * ServerChoices::GetReplicaExclusion). Redrawing when a draw lands
+   * on an excluded server keeps the distribution the same as drawing among the
+   * servers left, which is only done (in linear time) if the redraws keep
+   * failing.
+   */
+  ServerID DrawReplica(const ServerChoices &choices,
+                       std::span<const ServerID> chosen) {
+    const auto is_excluded = choices.GetReplicaExclusion(chosen);
+
+    for (int i = 0; i < kMaxRedraws; i++) {
+      const auto server_id = choices.Draw(rand_.Uniform());
+      if (!is_excluded(server_id)) {
+        return server_id;
+      }
+    }
+
+    ServerWeight total_weight = 0;
+    ServerID last_left = kInvalidServerID;
+    for (const auto server_id : choices.servers()) {
+      if (!is_excluded(server_id)) {
+        total_weight += choices.weight(server_id);
+        last_left = server_id;
+      }
+    }
+
+    auto target = rand_.Uniform() * total_weight;
+    for (const auto server_id : choices.servers()) {
+      if (is_excluded(server_id)) {
+        continue;
+      }
+      target -= choices.weight(server_id);
+      if (target < 0) {
+        return server_id;
+      }
+    }
+
+    /* Rounding (or all weights being zero). */
+    return last_left;
+  }
 };
 
 }  // namespace sandook::schedulers::data_plane
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include <time.h>  // NOLINT
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <map>
@@ -8,6 +10,7 @@
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "sandook/base/constants.h"
 #include "sandook/base/io_desc.h"
@@ -16,6 +19,8 @@
 #include "sandook/base/types.h"
 #include "sandook/bindings/timer.h"
 #include "sandook/config/config.h"
+#include "sandook/scheduler/control_plane/load_forecaster.h"
+#include "sandook/scheduler/control_plane/rw_isolation_base.h"
 #include "sandook/scheduler/control_plane/scheduler.h"
 #include "sandook/scheduler/control_plane/server_stats_manager.h"
 #include "sandook/test/utils/gtest/assertion.h"     // NOLINT
@@ -55,6 +60,86 @@ void CreateServers(sandook::schedulers::control_plane::Scheduler *sched,
   }
 }
 
+/* Adds n servers without models to the scheduler and returns their stats. */
+sandook::ServerStatsList AddServers(
+    sandook::schedulers::control_plane::RWIsolationBase *sched, size_t n) {
+  sandook::ServerStatsList stats;
+  for (size_t i = 0; i < n; i++) {
+    const auto server_id =
+        static_cast<sandook::ServerID>(sandook::kInvalidServerID + 1 + i);
+    EXPECT_TRUE(sched->AddServer(server_id, kTestDiskName, nullptr));
+    stats.push_back(
+        {.server_id = server_id, .mode = sandook::ServerMode::kMix});
+  }
+  return stats;
+}
+
+/* Computes an initial allocation, then changes the write load by write_step
+ * every forecaster period and returns how long it takes until the write
+ * servers are rotated.
+ */
+sandook::Duration GetTimeToRotation(
+    sandook::schedulers::control_plane::RWIsolationBase *sched,
+    const sandook::ServerStatsList &stats, int64_t write_step) {
+  using sandook::schedulers::control_plane::LoadForecaster;
+  constexpr uint64_t kReadOps = 300000;
+  int64_t write_ops = 150000;
+
+  const auto load = [&]() {
+    return sandook::SystemLoad{kReadOps, static_cast<uint64_t>(write_ops)};
+  };
+  EXPECT_TRUE(sched->ComputeModes(stats, load()));
+
+  const auto start = sandook::Time::Now();
+  while (sandook::Duration::Since(start).Microseconds() <
+         3 * sandook::kModeSwitchIntervalUs) {
+    sandook::rt::Sleep(sandook::Duration(LoadForecaster::kPeriodUs));
+    write_ops += write_step;
+    if (sched->ComputeModes(stats, load())) {
+      break;
+    }
+  }
+  return sandook::Duration::Since(start);
+}
+
+/* Peak IOPS of a class of SSDs. */
+struct SSDProfile {
+  uint64_t read_iops;
+  uint64_t write_iops;
+};
+
+/* RWIsolationBase over servers of the given profiles (in order of their IDs).
+ */
+class ProfiledRWIsolation
+    : public sandook::schedulers::control_plane::RWIsolationBase {
+ public:
+  explicit ProfiledRWIsolation(std::vector<SSDProfile> profiles)
+      : RWIsolationBase(sandook::Config::RWIsolationAllocatorType::kReactive),
+        profiles_(std::move(profiles)) {}
+
+  uint64_t GetPeakIOPS(sandook::ServerID server_id,
+                       sandook::ServerMode mode) override {
+    const auto &profile = profiles_.at(server_id - 1);
+    return (mode == sandook::ServerMode::kRead) ? profile.read_iops
+                                                : profile.write_iops;
+  }
+
+ private:
+  std::vector<SSDProfile> profiles_;
+};
+
+/* Returns the IDs of the servers that the modes put in write mode. */
+std::vector<sandook::ServerID> GetWriteServers(
+    const sandook::ServerModes &modes) {
+  std::vector<sandook::ServerID> servers;
+  for (size_t i = 0; i < modes.size(); i++) {
+    if (modes.at(i) == sandook::ServerMode::kWrite) {
+      servers.push_back(static_cast<sandook::ServerID>(i));
+    }
+  }
+  return servers;
+}
+
 }  // namespace
 
 class CreateControlPlaneSchedulerTests
@@ -215,6 +300,49 @@ INSTANTIATE_TEST_SUITE_P(
                           ServerModeTestParam(8, 0, 8, 0),
                           ServerModeTestParam(7, 1, 6, 2))));
 
+class MinWriteServerTests
+    : public ::testing::TestWithParam<
+          sandook::Config::ControlPlaneSchedulerType> {
+ protected:
+  static void SetUpTestSuite() {
+    model = std::make_shared<sandook::DiskModel>(kTestDiskName);
+  }
+
+  static void TearDownTestSuite() { model.reset(); }
+
+  static std::shared_ptr<sandook::DiskModel> model;  // NOLINT
+};
+
+std::shared_ptr<sandook::DiskModel> MinWriteServerTests::model;  // NOLINT
+
+TEST_P(MinWriteServerTests, TestMinWriteServers) {
+  /* One write server (plus one to spare) would do for the writes, but a
+   * volume with three replicas needs three.
+   */
+  constexpr size_t kNumReplicas = 3;
+
+  auto sched = sandook::schedulers::control_plane::Scheduler(GetParam());
+  sched.FreezeLoad();
+  sched.SetMinWriteServers(kNumReplicas);
+  CreateServers(&sched, model.get(), 7, 1);
+
+  sandook::rt::Sleep(sandook::Duration(2 * sandook::kModeSwitchIntervalUs));
+  sched.Stop();
+
+  const auto stats = sched.GetServerStats();
+  ASSERT_TRUE(stats);
+  const auto n_write_mode = static_cast<size_t>(std::ranges::count(
+      *stats, sandook::ServerMode::kWrite, &sandook::ServerStats::mode));
+  EXPECT_EQ(kNumReplicas, n_write_mode);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    RWIsolationSchedulers, MinWriteServerTests,
+    ::testing::Values(
+        sandook::Config::ControlPlaneSchedulerType::kProfileGuidedRWIsolation,
+        sandook::Config::ControlPlaneSchedulerType::kRWIsolationWeak,
+        sandook::Config::ControlPlaneSchedulerType::kRWIsolationStrict));
+
 struct ServerWeightTestParam {
   sandook::OpType op;
   double total_read_mops;
@@ -396,3 +524,207 @@ INSTANTIATE_TEST_SUITE_P(
                                {"S39WNA0KC02074",
                                 sandook::ServerMode::kRead}})));
 // NOLINTEND
+
+TEST(LoadForecasterTests, TestRamp) {
+  using sandook::schedulers::control_plane::LoadForecaster;
+  constexpr uint64_t kReadOps = 100000;
+  constexpr uint64_t kWriteOps = 200000;
+  constexpr uint64_t kWriteStep = 5000;
+  constexpr auto kNumPeriods = 10;
+  LoadForecaster forecaster;
+
+  /* Until the first period completes, the forecast is the last sample. */
+  forecaster.Update({kReadOps, kWriteOps});
+  auto [read_ops, write_ops] =
+      forecaster.Forecast(sandook::kModeSwitchIntervalUs);
+  EXPECT_DOUBLE_EQ(read_ops, kReadOps);
+  EXPECT_DOUBLE_EQ(write_ops, kWriteOps);
+
+  /* Steady reads and a write load that drops every period. */
+  for (uint64_t i = 1; i <= kNumPeriods; i++) {
+    sandook::rt::Sleep(sandook::Duration(LoadForecaster::kPeriodUs));
+    forecaster.Update({kReadOps, kWriteOps - (i * kWriteStep)});
+  }
+  const auto last_write_ops =
+      static_cast<double>(kWriteOps - (kNumPeriods * kWriteStep));
+
+  std::tie(read_ops, write_ops) = forecaster.Forecast(0);
+  EXPECT_DOUBLE_EQ(read_ops, kReadOps);
+  EXPECT_NEAR(write_ops, last_write_ops, kWriteStep / 2);
+
+  /* The trend is extrapolated over the horizon... */
+  std::tie(read_ops, write_ops) =
+      forecaster.Forecast(kNumPeriods * LoadForecaster::kPeriodUs);
+  EXPECT_DOUBLE_EQ(read_ops, kReadOps);
+  EXPECT_NEAR(write_ops, last_write_ops - (kNumPeriods * kWriteStep),
+              kWriteStep);
+
+  /* ...but the load never goes below zero. */
+  std::tie(read_ops, write_ops) =
+      forecaster.Forecast(100 * sandook::kModeSwitchIntervalUs);
+  EXPECT_DOUBLE_EQ(write_ops, 0.0);
+}
+
+TEST(PredictiveAllocatorTests, TestWriteRotationDeferred) {
+  using sandook::Config;
+  using sandook::schedulers::control_plane::LoadForecaster;
+  using sandook::schedulers::control_plane::RWIsolationBase;
+  constexpr auto kInterval =
+      static_cast<int64_t>(sandook::kModeSwitchIntervalUs);
+  constexpr auto kPeriod = static_cast<int64_t>(LoadForecaster::kPeriodUs);
+  /* 2% of the initial write load per period. */
+  constexpr int64_t kWriteStep = 3000;
+
+  /* The reactive allocator rotates the write servers every interval. */
+  {
+    RWIsolationBase sched(Config::RWIsolationAllocatorType::kReactive);
+    const auto stats = AddServers(&sched, 3);
+    const auto t = GetTimeToRotation(&sched, stats, -kWriteStep);
+    EXPECT_GE(t.Microseconds(), kInterval - kPeriod);
+    EXPECT_LT(t.Microseconds(), 2 * kInterval - kPeriod);
+  }
+
+  /* The predictive one defers it for as long as it may while the write load
+   * is expected to keep dropping...
+   */
+  {
+    RWIsolationBase sched(Config::RWIsolationAllocatorType::kPredictive);
+    const auto stats = AddServers(&sched, 3);
+    const auto t = GetTimeToRotation(&sched, stats, -kWriteStep);
+    EXPECT_GE(t.Microseconds(), 2 * kInterval - kPeriod);
+    EXPECT_LT(t.Microseconds(), 3 * kInterval);
+  }
+
+  /* ...but not while it is rising. */
+  {
+    RWIsolationBase sched(Config::RWIsolationAllocatorType::kPredictive);
+    const auto stats = AddServers(&sched, 3);
+    const auto t = GetTimeToRotation(&sched, stats, kWriteStep);
+    EXPECT_GE(t.Microseconds(), kInterval - kPeriod);
+    EXPECT_LT(t.Microseconds(), 2 * kInterval - kPeriod);
+  }
+}
+
+TEST(WriteDebtTests, TestDebtBuildsUpAndIsPaidDown) {
+  using sandook::ServerMode;
+  using sandook::schedulers::control_plane::kGCRecoveryBytesPerSec;
+  constexpr auto is_override = true;
+  constexpr auto is_update_load = true;
+  constexpr uint32_t kWrites = 100000;
+  constexpr auto kWriteBytes = static_cast<uint64_t>(kWrites)
+                               << sandook::kSectorShift;
+  constexpr auto kReadInterval =
+      sandook::Duration(10 * sandook::kOneMilliSecond);
+  constexpr auto kRecoveredBytes = kGCRecoveryBytesPerSec *
+                                   kReadInterval.Microseconds() /
+                                   sandook::kOneSecond;
+
+  sandook::schedulers::control_plane::ServerStatsManager manager;
+  const sandook::ServerID busy = sandook::kInvalidServerID + 1;
+  const sandook::ServerID idle = busy + 1;
+  manager.AddServer(busy, kTestDiskName);
+  manager.AddServer(idle, kTestDiskName);
+  const auto update = [&](sandook::ServerID server_id, ServerMode mode,
+                          uint32_t writes) {
+    const sandook::ServerStats stats{
+        .server_id = server_id, .mode = mode, .completed_writes = writes};
+    manager.UpdateServerStats(server_id, stats, is_override, is_update_load);
+    return manager.GetServerStats(server_id).write_debt;
+  };
+
+  /* Every byte written adds to the debt. */
+  EXPECT_EQ(update(busy, ServerMode::kWrite, kWrites), kWriteBytes);
+  EXPECT_EQ(update(busy, ServerMode::kWrite, kWrites), 2 * kWriteBytes);
+  EXPECT_EQ(update(idle, ServerMode::kWrite, 1), 1 << sandook::kSectorShift);
+
+  /* It is only paid down over the time spent in read mode, and no further
+   * than zero.
+   */
+  EXPECT_EQ(update(busy, ServerMode::kRead, 0), 2 * kWriteBytes);
+  EXPECT_EQ(update(idle, ServerMode::kRead, 0), 1 << sandook::kSectorShift);
+  sandook::rt::Sleep(kReadInterval);
+  const auto debt = update(busy, ServerMode::kRead, 0);
+  EXPECT_LE(debt, (2 * kWriteBytes) - kRecoveredBytes);
+  EXPECT_GT(debt, 0);
+  EXPECT_EQ(update(idle, ServerMode::kRead, 0), 0);
+}
+
+TEST(WriteDebtTests, TestWriteOrder) {
+  using sandook::ServerMode;
+  using sandook::schedulers::control_plane::RWIsolationBase;
+  constexpr uint64_t kGiB = 1ULL << 30;
+  constexpr sandook::SystemLoad kLoad{300000, 100000};
+
+  /* The servers with the least debt take the writes. */
+  {
+    RWIsolationBase sched(sandook::Config::RWIsolationAllocatorType::kReactive);
+    auto stats = AddServers(&sched, 4);
+    stats.at(0).write_debt = 5 * kGiB;
+    stats.at(2).write_debt = 3 * kGiB;
+    /* Within the same unit of debt as no debt at all. */
+    stats.at(3).write_debt = kGiB / 2;
+
+    const auto modes = sched.ComputeModes(stats, kLoad);
+    ASSERT_TRUE(modes);
+    EXPECT_EQ(modes->at(stats.at(0).server_id), ServerMode::kRead);
+    EXPECT_EQ(modes->at(stats.at(1).server_id), ServerMode::kWrite);
+    EXPECT_EQ(modes->at(stats.at(2).server_id), ServerMode::kRead);
+    EXPECT_EQ(modes->at(stats.at(3).server_id), ServerMode::kWrite);
+  }
+
+  /* The debt of a fuller disk weighs more. */
+  {
+    RWIsolationBase sched(sandook::Config::RWIsolationAllocatorType::kReactive);
+    auto stats = AddServers(&sched, 4);
+    stats.at(0).write_debt = 5 * kGiB;
+    stats.at(2).write_debt = 3 * kGiB;
+    stats.at(3).write_debt = kGiB / 2;
+    stats.at(3).fill_level = 0.9;
+
+    const auto modes = sched.ComputeModes(stats, kLoad);
+    ASSERT_TRUE(modes);
+    EXPECT_EQ(modes->at(stats.at(0).server_id), ServerMode::kRead);
+    EXPECT_EQ(modes->at(stats.at(1).server_id), ServerMode::kWrite);
+    EXPECT_EQ(modes->at(stats.at(2).server_id), ServerMode::kWrite);
+    EXPECT_EQ(modes->at(stats.at(3).server_id), ServerMode::kRead);
+  }
+}
+
+TEST(WriteServerSelectionTests, TestHeterogeneousProfiles) {
+  /* Fast disks read twice as much as they write; slow disks read 2.5 times
+   * as much, but two of them absorb the writes for less read capacity than a
+   * fast one.
+   */
+  constexpr SSDProfile kFast{.read_iops = 600000, .write_iops = 300000};
+  constexpr SSDProfile kSlow{.read_iops = 100000, .write_iops = 40000};
+  constexpr sandook::SystemLoad kLoad{500000, 80000};
+  using Servers = std::vector<sandook::ServerID>;
+
+  /* With few classes, the cheapest set is found exactly: two slow disks,
+   * plus a fast one to spare.
+   */
+  {
+    ProfiledRWIsolation sched({kFast, kFast, kSlow, kSlow, kSlow});
+    const auto stats = AddServers(&sched, 5);
+    const auto modes = sched.ComputeModes(stats, kLoad);
+    ASSERT_TRUE(modes);
+    EXPECT_EQ(GetWriteServers(*modes), (Servers{1, 3, 4}));
+  }
+
+  /* With more classes than kMaxExactServerClasses, the disks that write best
+   * relative to how they read are taken greedily.
+   */
+  {
+    std::vector<SSDProfile> profiles{kFast, kFast};
+    for (uint64_t i = 0;
+         i < sandook::schedulers::control_plane::kMaxExactServerClasses; i++) {
+      profiles.push_back(
+          {.read_iops = kSlow.read_iops + i, .write_iops = kSlow.write_iops});
+    }
+    ProfiledRWIsolation sched(profiles);
+    const auto stats = AddServers(&sched, profiles.size());
+    const auto modes = sched.ComputeModes(stats, kLoad);
+    ASSERT_TRUE(modes);
+    EXPECT_EQ(GetWriteServers(*modes), (Servers{1, 2}));
+  }
+}
@@ -1,17 +1,34 @@
 #include <gtest/gtest.h>
 #include <time.h>  // NOLINT
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 
+#include "sandook/base/constants.h"
+#include "sandook/base/qos.h"
 #include "sandook/base/server_stats.h"
+#include "sandook/base/time.h"
+#include "sandook/base/types.h"
+#include "sandook/bindings/timer.h"
+#include "sandook/config/config.h"
+#include "sandook/controller/congestion_allocator.h"
 #include "sandook/controller/controller_agent.h"
+#include "sandook/controller/qos_allocator.h"
+#include "sandook/scheduler/control_plane/server_stats_manager.h"
 #include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
 
 inline constexpr auto kMockIP = "192.168.127.3";
 inline constexpr auto kMockPort = 7777;
 inline constexpr auto kMockSectors = 1ULL << 20;
 inline constexpr auto kMockName = "mock_server";
+inline constexpr sandook::VolumeQoS kMockQoS{
+    .reservation = 0, .limit = 0, .weight = 1};
+/* A disk with a profile to schedule by. */
+inline constexpr auto kModelName = "S39WNA0KB01161";
 
 class ControllerAgentTests : public ::testing::Test {
  protected:
@@ -20,6 +37,54 @@ class ControllerAgentTests : public ::testing::Test {
 
   void SetUp() override {}
   void TearDown() override {}
+
+  static bool IsRWIsolation() {
+    using Type = sandook::Config::ControlPlaneSchedulerType;
+    const auto type = sandook::Config::kControlPlaneSchedulerType;
+    return type != Type::kNoOp && type != Type::kProfileGuided;
+  }
+
+  /* Registers a volume on a few servers and returns how many servers are in
+   * write mode under a read-heavy load.
+   */
+  static size_t GetNumWriteServers(uint32_t num_replicas,
+                                   bool is_erasure_coded) {
+    constexpr auto kNumServers = 8;
+
+    auto agent = std::make_unique<sandook::ControllerAgent>();
+    for (int i = 0; i < kNumServers; i++) {
+      EXPECT_TRUE(agent->RegisterServer(kMockIP, kMockPort + i, kModelName,
+                                        kMockSectors));
+    }
+    EXPECT_TRUE(agent->RegisterVolume(kMockIP, kMockPort, kMockSectors,
+                                      kMockQoS, num_replicas,
+                                      is_erasure_coded));
+
+    /* A load that one write server (plus one to spare) would take, reported
+     * until the modes are switched.
+     */
+    const auto start = sandook::Time::Now();
+    while (sandook::Duration::Since(start).Microseconds() <
+           2 * sandook::kModeSwitchIntervalUs) {
+      for (sandook::ServerID id = 1; id <= kNumServers; id++) {
+        const bool is_writer = id == kNumServers;
+        const sandook::ServerStats stats{
+            .server_id = id,
+            .mode = sandook::ServerMode::kMix,
+            .completed_reads = is_writer ? 0U : 70U,
+            .completed_writes = is_writer ? 10U : 0U};
+        EXPECT_TRUE(agent->UpdateServerStats(id, stats));
+      }
+      sandook::rt::Sleep(sandook::Duration(
+          sandook::schedulers::control_plane::kLoadCalculationIntervalUs / 2));
+    }
+    agent->StopScheduler();
+
+    const auto servers = agent->GetServerStats();
+    EXPECT_TRUE(servers);
+    return static_cast<size_t>(std::ranges::count(
+        *servers, sandook::ServerMode::kWrite, &sandook::ServerStats::mode));
+  }
 };
 
 TEST_F(ControllerAgentTests, TestRegisterServer) {
@@ -38,6 +103,61 @@ TEST_F(ControllerAgentTests, TestRegisterVolume) {
   EXPECT_EQ(1, *ret);
 }
 
+TEST_F(ControllerAgentTests, TestRegisterVolumeReplicas) {
+  auto agent = std::make_unique<sandook::ControllerAgent>();
+
+  const auto rf1 =
+      agent->RegisterVolume(kMockIP, kMockPort, kMockSectors, kMockQoS, 1);
+  ASSERT_TRUE(rf1);
+  EXPECT_EQ(1, agent->get_volumes().at(*rf1).num_replicas());
+
+  const auto rf3 =
+      agent->RegisterVolume(kMockIP, kMockPort, kMockSectors, kMockQoS, 3);
+  ASSERT_TRUE(rf3);
+  EXPECT_EQ(3, agent->get_volumes().at(*rf3).num_replicas());
+
+  EXPECT_FALSE(agent->RegisterVolume(kMockIP, kMockPort, kMockSectors,
+                                     kMockQoS, sandook::kMinNumReplicas - 1));
+  EXPECT_FALSE(agent->RegisterVolume(kMockIP, kMockPort, kMockSectors,
+                                     kMockQoS, sandook::kMaxNumReplicas + 1));
+}
+
+TEST_F(ControllerAgentTests, TestRejectedVolumeKeepsID) {
+  auto agent = std::make_unique<sandook::ControllerAgent>();
+
+  constexpr sandook::VolumeQoS kBadQoS{
+      .reservation = 2, .limit = 1, .weight = 1};
+  EXPECT_FALSE(agent->RegisterVolume(kMockIP, kMockPort, kMockSectors,
+                                     kBadQoS));
+  EXPECT_FALSE(agent->RegisterVolume(kMockIP, kMockPort, kMockSectors,
+                                     kMockQoS, sandook::kMaxNumReplicas + 1));
+
+  /* Rejected registrations do not take an ID. */
+  const auto ret = agent->RegisterVolume(kMockIP, kMockPort, kMockSectors);
+  ASSERT_TRUE(ret);
+  EXPECT_EQ(1, *ret);
+}
+
+TEST_F(ControllerAgentTests, TestWriteServersForReplicas) {
+  if (!IsRWIsolation()) {
+    GTEST_SKIP() << "Scheduler does not isolate reads from writes";
+  }
+
+  /* Every replica of a write needs a server that takes writes. */
+  constexpr uint32_t kNumReplicas = 3;
+  EXPECT_LE(kNumReplicas, GetNumWriteServers(kNumReplicas, false));
+}
+
+TEST_F(ControllerAgentTests, TestWriteServersForErasureCoding) {
+  if (!IsRWIsolation()) {
+    GTEST_SKIP() << "Scheduler does not isolate reads from writes";
+  }
+
+  /* Every block of a stripe needs a server that takes writes. */
+  EXPECT_LE(static_cast<size_t>(sandook::kECStripeBlocks),
+            GetNumWriteServers(sandook::kDefaultNumReplicas, true));
+}
+
 TEST_F(ControllerAgentTests, TestUpdateServerStats) {
   auto agent = std::make_unique<sandook::ControllerAgent>();
 
@@ -50,3 +170,161 @@ TEST_F(ControllerAgentTests, TestUpdateServerStats) {
   auto update = agent->UpdateServerStats(server_id, stats);
   EXPECT_TRUE(update);
 }
+
+TEST_F(ControllerAgentTests, TestQoSAllocation) {
+  constexpr auto kCapacity = 100000;
+  constexpr sandook::VolumeID kLatencySensitive = 1;
+  constexpr sandook::VolumeID kBatch = 2;
+
+  sandook::controller::QoSAllocator alloc;
+  EXPECT_TRUE(alloc.AddVolume(
+      kLatencySensitive, {.reservation = 60000, .limit = 0, .weight = 1}));
+  EXPECT_TRUE(
+      alloc.AddVolume(kBatch, {.reservation = 0, .limit = 0, .weight = 1}));
+
+  /* The batch volume borrows what the other volume does not use of its
+   * reservation, which stays guaranteed.
+   */
+  std::array<double, sandook::kNumMaxVolumes> demands{};
+  demands.at(kLatencySensitive) = 10000;
+  demands.at(kBatch) = 200000;
+  alloc.Allocate(kCapacity, demands);
+  EXPECT_EQ(60000, alloc.GetRate(kLatencySensitive));
+  EXPECT_EQ(87500, alloc.GetRate(kBatch));
+
+  /* Under contention, the batch volume is held to the spare capacity. */
+  demands.at(kLatencySensitive) = 200000;
+  alloc.Allocate(kCapacity, demands);
+  EXPECT_EQ(80000, alloc.GetRate(kLatencySensitive));
+  EXPECT_EQ(20000, alloc.GetRate(kBatch));
+}
+
+TEST_F(ControllerAgentTests, TestQoSCostOfStripes) {
+  using sandook::GetQoSCost;
+  using sandook::OpType;
+  constexpr uint64_t kNumReplicas = 3;
+
+  /* A stripe writes 1.5 blocks per sector rather than one per replica. */
+  const auto sector_cost = GetQoSCost(OpType::kWrite, 1, 1);
+  EXPECT_EQ(sandook::kECStripeBlocks * sector_cost,
+            GetQoSCost(OpType::kWrite, sandook::kECDataBlocks, kNumReplicas,
+                       true /* is_erasure_coded */));
+  EXPECT_EQ(sandook::kECDataBlocks * kNumReplicas * sector_cost,
+            GetQoSCost(OpType::kWrite, sandook::kECDataBlocks, kNumReplicas));
+
+  /* Sectors that do not fill a stripe are replicated. */
+  EXPECT_EQ((sandook::kECStripeBlocks + kNumReplicas) * sector_cost,
+            GetQoSCost(OpType::kWrite, sandook::kECDataBlocks + 1,
+                       kNumReplicas, true /* is_erasure_coded */));
+
+  /* Reads are not amplified. */
+  EXPECT_EQ(sandook::kECDataBlocks,
+            GetQoSCost(OpType::kRead, sandook::kECDataBlocks, kNumReplicas,
+                       true /* is_erasure_coded */));
+}
+
+TEST_F(ControllerAgentTests, TestCongestionAllocation) {
+  constexpr sandook::ServerID kCongested = 1;
+  constexpr sandook::ServerID kUnCongested = 2;
+  constexpr sandook::VolumeID kHeavy = 1;
+  constexpr sandook::VolumeID kLight = 2;
+
+  sandook::controller::CongestionAllocator alloc;
+  EXPECT_TRUE(alloc.AddVolume(kHeavy, 1));
+  EXPECT_TRUE(alloc.AddVolume(kLight, 1));
+
+  sandook::ServerStatsList servers{
+      {.server_id = kCongested,
+       .read_mops = 0.1,
+       .congestion_state = sandook::ServerCongestionState::kCongested},
+      {.server_id = kUnCongested,
+       .read_mops = 0.1,
+       .congestion_state = sandook::ServerCongestionState::kUnCongested}};
+
+  std::array<sandook::ServerDemands, sandook::kNumMaxVolumes> demands{};
+  demands.at(kHeavy).at(kCongested) = 80000;
+  demands.at(kHeavy).at(kUnCongested) = 80000;
+  demands.at(kLight).at(kCongested) = 20000;
+  alloc.Allocate(servers, demands);
+
+  /* 90% of the throughput of the congested server is split max-min fair: the
+   * light volume is left alone and the heavy one gets the rest.
+   */
+  const auto heavy = alloc.GetRateLimits(kHeavy);
+  const auto light = alloc.GetRateLimits(kLight);
+  EXPECT_TRUE(heavy && light);
+  EXPECT_DOUBLE_EQ(0.875, heavy->at(kCongested));
+  EXPECT_DOUBLE_EQ(1.0, light->at(kCongested));
+  EXPECT_DOUBLE_EQ(0, heavy->at(kUnCongested));
+
+  /* Volumes ramp back up on their own once the congestion subsides. */
+  servers.at(0).congestion_state =
+      sandook::ServerCongestionState::kCongestedUnstable;
+  alloc.Allocate(servers, demands);
+  EXPECT_DOUBLE_EQ(0, alloc.GetRateLimits(kHeavy)->at(kCongested));
+}
+
+TEST_F(ControllerAgentTests, TestCongestionAllocationConverges) {
+  using sandook::controller::CongestionAllocator;
+  constexpr sandook::ServerID kServer = 1;
+  constexpr std::array<sandook::VolumeID, 2> kVolumes{1, 2};
+  constexpr std::array<uint64_t, 2> kWeights{3, 1};
+  /* Ops per second that each volume would send without limits. */
+  constexpr auto kDemand = 100000.0;
+  constexpr auto kNumIntervals = 5;
+  constexpr auto kTolerance = 0.02;
+
+  CongestionAllocator alloc;
+  for (size_t v = 0; v < kVolumes.size(); v++) {
+    EXPECT_TRUE(alloc.AddVolume(kVolumes.at(v), kWeights.at(v)));
+  }
+
+  /* A server that sustains half the total demand. */
+  const sandook::ServerStatsList servers{
+      {.server_id = kServer,
+       .read_mops = kDemand / sandook::kMillion,
+       .congestion_state = sandook::ServerCongestionState::kCongestedStable}};
+
+  std::array<sandook::ServerOps, 2> ops{};
+  const auto report_ops = [&]() {
+    bool is_due = false;
+    for (size_t v = 0; v < kVolumes.size(); v++) {
+      const auto ret = alloc.UpdateOps(kVolumes.at(v), ops.at(v));
+      EXPECT_TRUE(ret);
+      is_due |= *ret;
+    }
+    return is_due;
+  };
+
+  /* Starts the first interval. */
+  sandook::rt::Sleep(
+      sandook::Duration(CongestionAllocator::kAllocationIntervalUs));
+  ASSERT_TRUE(report_ops());
+  alloc.Allocate(servers);
+  auto start = sandook::Time::Now();
+
+  /* Each interval, the volumes send what they are allocated of their demand,
+   * and the allocation holds steady at the weighted split of the throughput.
+   */
+  for (int i = 0; i < kNumIntervals; i++) {
+    sandook::rt::Sleep(
+        sandook::Duration(CongestionAllocator::kAllocationIntervalUs));
+    const auto now = sandook::Time::Now();
+    const auto elapsed = (now - start).Seconds();
+    start = now;
+
+    for (size_t v = 0; v < kVolumes.size(); v++) {
+      auto rate_limit = alloc.GetRateLimits(kVolumes.at(v))->at(kServer);
+      rate_limit = (rate_limit > 0) ? rate_limit : 1.0;
+      ops.at(v).at(kServer) +=
+          static_cast<uint64_t>(kDemand * rate_limit * elapsed);
+    }
+    ASSERT_TRUE(report_ops());
+    alloc.Allocate(servers);
+
+    EXPECT_NEAR(0.75, alloc.GetRateLimits(kVolumes.at(0))->at(kServer),
+                kTolerance);
+    EXPECT_NEAR(0.25, alloc.GetRateLimits(kVolumes.at(1))->at(kServer),
+                kTolerance);
+  }
+}
@@ -1,14 +1,20 @@
 #include <gtest/gtest.h>
 #include <time.h>  // NOLINT
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 extern "C" {
 #include "base/assert.h"  // NOLINT
 }
 
+#include "sandook/base/constants.h"
 #include "sandook/base/io_desc.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
@@ -40,7 +46,222 @@ INSTANTIATE_TEST_SUITE_P(
         sandook::Config::DataPlaneSchedulerType::kWeightedReadWrite,
         sandook::Config::DataPlaneSchedulerType::kRandomReadWrite,
         sandook::Config::DataPlaneSchedulerType::kWeightedReadHashWrite,
-        sandook::Config::DataPlaneSchedulerType::kRandomReadHashWrite));
+        sandook::Config::DataPlaneSchedulerType::kRandomReadHashWrite,
+        sandook::Config::DataPlaneSchedulerType::kP2CReadWeightedWrite));
+
+TEST(SelectReadServerP2CTests, TestAvoidLoadedServer) {
+  const auto kIterations = 1000;
+
+  auto sched = sandook::schedulers::data_plane::Scheduler(
+      sandook::Config::DataPlaneSchedulerType::kP2CReadWeightedWrite);
+
+  const sandook::ServerID fast = sandook::kInvalidServerID + 1;
+  const sandook::ServerID slow = fast + 1;
+
+  sandook::ServerStatsList server_stats_list;
+  sandook::ServerSet subset;
+  for (const auto server_id : {fast, slow}) {
+    const sandook::ServerStats server_stats{.server_id = server_id,
+                                            .mode = sandook::ServerMode::kRead,
+                                            .read_weight = 0.5};
+    server_stats_list.emplace_back(server_stats);
+    subset.insert(server_id);
+  }
+
+  const auto set_servers = sched.SetServerStats(server_stats_list);
+  EXPECT_TRUE(set_servers);
+
+  /* Both servers have the same weight but the slow one has reads queued. */
+  sched.StartOp(fast);
+  sched.CompleteOp(fast, 100);
+  for (int i = 0; i < 4; i++) {
+    sched.StartOp(slow);
+  }
+  sched.CompleteOp(slow, 1000);
+
+  const sandook::VolumeID vol_id = sandook::kInvalidVolumeID;
+  const sandook::IODesc *iod = nullptr;
+
+  for (int i = 0; i < kIterations; i++) {
+    const auto selection = sched.SelectReadServer(&subset, vol_id, iod);
+    EXPECT_TRUE(selection);
+    EXPECT_EQ(*selection, fast);
+  }
+}
+
+TEST(SelectWriteReplicasHashTests, TestStablePlacement) {
+  const auto kNumServers = 6;
+  const auto kNumSectors = 10000;
+
+  auto sched = sandook::schedulers::data_plane::Scheduler(
+      sandook::Config::DataPlaneSchedulerType::kWeightedReadHashWrite);
+
+  const sandook::ServerID leaving = sandook::kInvalidServerID + kNumServers;
+  const auto set_servers = [&](bool is_leaving) {
+    sandook::ServerStatsList server_stats_list;
+    for (int i = 1; i <= kNumServers; i++) {
+      const sandook::ServerID server_id = sandook::kInvalidServerID + i;
+      const auto mode = (is_leaving && server_id == leaving)
+                            ? sandook::ServerMode::kRead
+                            : sandook::ServerMode::kWrite;
+      const sandook::ServerStats server_stats{.server_id = server_id,
+                                              .mode = mode,
+                                              .committed_mode = mode,
+                                              .write_weight = 1.0};
+      server_stats_list.emplace_back(server_stats);
+    }
+    EXPECT_TRUE(sched.SetServerStats(server_stats_list));
+  };
+
+  const sandook::VolumeID vol_id = sandook::kInvalidVolumeID;
+  const auto select = [&](uint64_t sector) {
+    const sandook::IODesc iod{.start_sector = sector};
+    const auto replicas = sched.SelectWriteReplicas(vol_id, &iod);
+    EXPECT_TRUE(replicas);
+    return *replicas;
+  };
+
+  set_servers(false);
+  std::vector<sandook::ServerReplicaList> placements;
+  for (int i = 0; i < kNumSectors; i++) {
+    placements.emplace_back(select(i));
+    EXPECT_EQ(select(i), placements.back());
+  }
+
+  /* Only the writes placed on the server that stops taking writes move. */
+  set_servers(true);
+  for (int i = 0; i < kNumSectors; i++) {
+    const auto &before = placements.at(i);
+    if (std::ranges::find(before, leaving) == before.end()) {
+      EXPECT_EQ(select(i), before);
+    }
+  }
+}
+
+TEST(SelectWriteServersTests, TestStripeUnderRWIsolation) {
+  const auto kNumServers = 8;
+
+  auto sched = sandook::schedulers::data_plane::Scheduler(
+      sandook::Config::DataPlaneSchedulerType::kWeightedReadWrite);
+  for (int i = 1; i <= kNumServers; i++) {
+    EXPECT_TRUE(sched.AddServer(sandook::kInvalidServerID + i));
+  }
+
+  /* The first n_write servers take writes and the rest only reads. */
+  const auto set_servers = [&](int n_write) {
+    sandook::ServerStatsList server_stats_list;
+    for (int i = 1; i <= kNumServers; i++) {
+      const auto mode = (i <= n_write) ? sandook::ServerMode::kWrite
+                                       : sandook::ServerMode::kRead;
+      const sandook::ServerID server_id = sandook::kInvalidServerID + i;
+      server_stats_list.push_back({.server_id = server_id,
+                                   .mode = mode,
+                                   .committed_mode = mode,
+                                   .read_weight = 1.0,
+                                   .write_weight = 1.0});
+    }
+    EXPECT_TRUE(sched.SetServerStats(server_stats_list));
+  };
+
+  const sandook::VolumeID vol_id = sandook::kInvalidVolumeID;
+  const sandook::IODesc iod{.num_sectors = sandook::kECDataBlocks};
+  std::array<sandook::ServerID, sandook::kECStripeBlocks> servers{};
+
+  /* As few write servers as replicas leave no room for a stripe. */
+  set_servers(sandook::kDefaultNumReplicas + 1);
+  EXPECT_FALSE(sched.SelectWriteServers(vol_id, &iod, servers));
+
+  /* With a server in write mode for each of its blocks (as the controller
+   * keeps for erasure-coded volumes), the stripe is placed on them only.
+   */
+  set_servers(sandook::kECStripeBlocks);
+  ASSERT_TRUE(sched.SelectWriteServers(vol_id, &iod, servers));
+  const auto last_write_server =
+      sandook::kInvalidServerID + sandook::kECStripeBlocks;
+  std::ranges::sort(servers);
+  EXPECT_EQ(servers.end(), std::ranges::adjacent_find(servers));
+  EXPECT_LE(servers.back(), last_write_server);
+}
+
+class SelectWriteReplicasRackTests
+    : public ::testing::TestWithParam<sandook::Config::DataPlaneSchedulerType> {
+ protected:
+  constexpr static auto kNumServers = 6;
+  constexpr static auto kNumReplicas = 3;
+  constexpr static auto kNumSectors = 1000;
+
+  /* Racks of the replicas that the writes of kNumSectors sectors are placed
+   * on, with servers that are all in one failure domain and where server i
+   * is in rack (i - 1) / servers_per_rack + 1.
+   */
+  static std::vector<std::vector<uint32_t>> GetReplicaRacks(
+      int servers_per_rack) {
+    auto sched = sandook::schedulers::data_plane::Scheduler(
+        GetParam(), sandook::kInvalidVolumeID, kNumReplicas);
+    const auto get_rack = [&](sandook::ServerID server_id) {
+      return static_cast<uint32_t>(((server_id - sandook::kInvalidServerID -
+                                     1) / servers_per_rack) + 1);
+    };
+
+    const auto mode = sandook::ServerMode::kWrite;
+    sandook::ServerStatsList server_stats_list;
+    for (int i = 1; i <= kNumServers; i++) {
+      const sandook::ServerID server_id = sandook::kInvalidServerID + i;
+      EXPECT_TRUE(sched.AddServer(
+          server_id, {.rack = get_rack(server_id), .failure_domain = 1}));
+      server_stats_list.push_back({.server_id = server_id,
+                                   .mode = mode,
+                                   .committed_mode = mode,
+                                   .read_weight = 1.0,
+                                   .write_weight = 1.0});
+    }
+    EXPECT_TRUE(sched.SetServerStats(server_stats_list));
+
+    std::vector<std::vector<uint32_t>> racks;
+    for (int i = 0; i < kNumSectors; i++) {
+      const sandook::IODesc iod{.start_sector = static_cast<uint64_t>(i)};
+      const auto replicas =
+          sched.SelectWriteReplicas(sandook::kInvalidVolumeID, &iod);
+      EXPECT_TRUE(replicas);
+      if (!replicas) {
+        continue;
+      }
+      EXPECT_EQ(kNumReplicas, replicas->size());
+      std::vector<sandook::ServerID> servers(replicas->begin(),
+                                             replicas->end());
+      std::ranges::sort(servers);
+      EXPECT_EQ(servers.end(), std::ranges::adjacent_find(servers));
+
+      auto &replica_racks = racks.emplace_back();
+      for (const auto server_id : servers) {
+        replica_racks.push_back(get_rack(server_id));
+      }
+    }
+    return racks;
+  }
+};
+
+TEST_P(SelectWriteReplicasRackTests, TestSpreadAcrossRacks) {
+  /* All servers share a failure domain, but there is a rack per replica. */
+  for (auto replica_racks : GetReplicaRacks(kNumServers / kNumReplicas)) {
+    std::ranges::sort(replica_racks);
+    EXPECT_EQ(replica_racks.end(), std::ranges::adjacent_find(replica_racks));
+  }
+}
+
+TEST_P(SelectWriteReplicasRackTests, TestFallbackWhenRacksRunOut) {
+  /* Two racks for three replicas: both racks are used before one repeats. */
+  for (const auto &replica_racks : GetReplicaRacks(kNumServers / 2)) {
+    EXPECT_EQ(2, std::set(replica_racks.begin(), replica_racks.end()).size());
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    SelectWriteReplicasRackTests, SelectWriteReplicasRackTests,
+    ::testing::Values(
+        sandook::Config::DataPlaneSchedulerType::kWeightedReadWrite,
+        sandook::Config::DataPlaneSchedulerType::kRandomReadWrite,
+        sandook::Config::DataPlaneSchedulerType::kWeightedReadHashWrite));
 
 struct SelectReadServerTestParam {
   sandook::Config::DataPlaneSchedulerType scheduler_type;
@@ -4,6 +4,8 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -14,7 +16,10 @@
 #include "sandook/base/io_desc.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
+#include "sandook/config/config.h"
 #include "sandook/disk_model/disk_model.h"
+#include "sandook/disk_model/disk_model_learner.h"
+#include "sandook/disk_model/model_bundle.h"
 #include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
 
 constexpr auto kTestModelName = "test";
@@ -57,6 +62,163 @@ TEST_P(DiskModelTests, TestLatencySelection) {
   EXPECT_EQ(latency, expected_latency);
 }
 
+TEST_P(DiskModelTests, TestLoadInversion) {
+  const auto param = GetParam();
+  const auto op = param.op;
+  const auto mode = param.mode;
+  const auto write_ratio = param.write_ratio;
+  const auto expected_latency = param.expected_latency;
+
+  const auto load = static_cast<uint64_t>(model->GetLoad(
+      static_cast<double>(expected_latency), op, mode, write_ratio));
+  const auto latency = model->GetLatency(load, op, mode, write_ratio);
+
+  EXPECT_LE(latency, expected_latency);
+  if (expected_latency < kSaturationLatencyUs) {
+    EXPECT_GE(latency + 1, expected_latency);
+  }
+}
+
+TEST(DiskModelInterpolationTests, TestMixInterpolation) {
+  const sandook::DiskModel rounded(kTestModelName, false);
+  const sandook::DiskModel interpolated(kTestModelName, true);
+  constexpr uint64_t load = 300000;
+  constexpr auto op = sandook::OpType::kWrite;
+  constexpr auto mode = sandook::ServerMode::kMix;
+
+  /* Exactly at a bucket there is nothing to interpolate. */
+  EXPECT_EQ(interpolated.GetLatency(load, op, mode, 0.5),
+            rounded.GetLatency(load, op, mode, 0.5));
+
+  /* In between two buckets the latency lies in between theirs. */
+  const auto lo = rounded.GetLatency(load, op, mode, 0.3);
+  const auto hi = rounded.GetLatency(load, op, mode, 0.5);
+  const auto mid = interpolated.GetLatency(load, op, mode, 0.4);
+  EXPECT_GE(mid + 1, std::min(lo, hi));
+  EXPECT_LE(mid, std::max(lo, hi));
+
+  /* Inverse of the interpolated curve. */
+  const auto inv_load = static_cast<uint64_t>(
+      interpolated.GetLoad(static_cast<double>(mid), op, mode, 0.4));
+  EXPECT_LE(interpolated.GetLatency(inv_load, op, mode, 0.4), mid);
+}
+
+TEST(DiskModelFillLevelTests, TestFillInterpolation) {
+  const sandook::DiskModel model(kTestModelName);
+  constexpr uint64_t load = 200000;
+  constexpr auto op = sandook::OpType::kWrite;
+  constexpr auto mode = sandook::ServerMode::kWrite;
+
+  /* The write profile of the test disk is also available at 80% fill. */
+  const auto empty = model.GetLatency(load, op, mode, 1.0, 0.0);
+  const auto half = model.GetLatency(load, op, mode, 1.0, 0.4);
+  const auto full = model.GetLatency(load, op, mode, 1.0, 0.8);
+  EXPECT_LT(empty, half);
+  EXPECT_LT(half, full);
+
+  /* Clamped beyond the highest profiled fill level. */
+  EXPECT_EQ(model.GetLatency(load, op, mode, 1.0, 1.0), full);
+  EXPECT_LE(model.GetPeakIOPS(mode, 1.0, 0.8), model.GetPeakIOPS(mode, 1.0));
+
+  /* Reads were only profiled on an empty disk. */
+  EXPECT_EQ(model.GetLatency(load, sandook::OpType::kRead,
+                             sandook::ServerMode::kRead, 0.0, 0.8),
+            model.GetLatency(load, sandook::OpType::kRead,
+                             sandook::ServerMode::kRead, 0.0));
+
+  /* Inverse of the interpolated curve. */
+  const auto inv_load = static_cast<uint64_t>(
+      model.GetLoad(static_cast<double>(half), op, mode, 1.0, 0.4));
+  EXPECT_LE(model.GetLatency(inv_load, op, mode, 1.0, 0.4), half);
+}
+
+TEST(DiskModelLearnerTests, TestRefinement) {
+  using Learner = sandook::DiskModelLearner;
+  const sandook::DiskModel model(kTestModelName);
+  Learner learner(model);
+  /* A sample of the read profile of the test disk. */
+  constexpr uint64_t load = 548922;
+  constexpr auto op = sandook::OpType::kRead;
+  constexpr auto mode = sandook::ServerMode::kRead;
+  const auto profiled = model.GetLatency(load, op, mode, 0.0);
+
+  /* The disk serves reads at that load twice as slowly as profiled. */
+  sandook::ServerStats stats{};
+  stats.mode = mode;
+  stats.read_mops = static_cast<double>(load) / sandook::kMillion;
+  stats.completed_reads = 1;
+  stats.signal_read_latency = 2 * profiled;
+  const auto observe = [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      learner.Observe(stats);
+    }
+  };
+
+  /* A bin with fewer than kMinSamples observations is only partly trusted. */
+  observe(Learner::kMinSamples / 2);
+  const auto partial = learner.GetModel().GetLatency(load, op, mode, 0.0);
+  EXPECT_GT(partial, profiled * 13 / 10);
+  EXPECT_LT(partial, profiled * 16 / 10);
+
+  observe(Learner::kMinSamples * 2);
+  const auto refined = learner.GetModel();
+  const auto latency = refined.GetLatency(load, op, mode, 0.0);
+  EXPECT_GE(latency, profiled * 195 / 100);
+  EXPECT_LE(latency, profiled * 2);
+
+  /* Other bins and the write profile are left as profiled. */
+  constexpr uint64_t other_load = 109741;
+  EXPECT_EQ(refined.GetLatency(other_load, op, mode, 0.0),
+            model.GetLatency(other_load, op, mode, 0.0));
+  EXPECT_EQ(refined.GetLatency(load, sandook::OpType::kWrite,
+                               sandook::ServerMode::kWrite, 1.0),
+            model.GetLatency(load, sandook::OpType::kWrite,
+                             sandook::ServerMode::kWrite, 1.0));
+
+  /* Outliers only move a bin as far as the bounds on the correction. */
+  stats.signal_read_latency = 100 * profiled;
+  observe(Learner::kMinSamples * 4);
+  EXPECT_LE(learner.GetModel().GetLatency(load, op, mode, 0.0),
+            static_cast<uint64_t>(profiled * Learner::kMaxCorrection));
+}
+
+TEST(ModelBundleTests, TestRoundTrip) {
+  const auto dir = std::filesystem::temp_directory_path();
+  const auto fpath = dir / "test_disk_model.bundle";
+  const auto model = sandook::DiskModel::LoadModel(
+      sandook::Config::kSSDModelsDirPath /
+      (std::string(kTestModelName) + kReadOnlyModelSuffix));
+  const sandook::ModelBundle::Curve curves[] = {
+      {.suffix = "_100r", .loads = model.first, .latencies = model.second}};
+  ASSERT_TRUE(sandook::ModelBundle::Write(fpath, curves));
+
+  {
+    const auto bundle = sandook::ModelBundle::Open(fpath);
+    ASSERT_TRUE(bundle);
+    const auto *entry = (*bundle)->Find("_100r");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ((*bundle)->Find("_1000w"), nullptr);
+
+    const auto loads =
+        (*bundle)->loads().subspan(entry->offset, entry->num_points);
+    const auto latencies =
+        (*bundle)->latencies().subspan(entry->offset, entry->num_points);
+    EXPECT_TRUE(std::ranges::equal(loads, model.first));
+    EXPECT_TRUE(std::ranges::equal(latencies, model.second));
+  }
+
+  /* A corrupted bundle is rejected. */
+  {
+    std::fstream f(fpath, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(sizeof(sandook::ModelBundle::Header) +
+            sizeof(sandook::ModelBundle::Entry));
+    f.put('\xff');
+  }
+  EXPECT_FALSE(sandook::ModelBundle::Open(fpath));
+
+  std::filesystem::remove(fpath);
+}
+
 // NOLINTBEGIN
 INSTANTIATE_TEST_SUITE_P(
     LatencySelection, DiskModelTests,
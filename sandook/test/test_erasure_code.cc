@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/erasure_code.h"
+#include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
+
+using sandook::GF256;
+using sandook::kECDataBlocks;
+using sandook::kECParityBlocks;
+using sandook::kECStripeBlocks;
+
+using ErasureCode = sandook::ReedSolomon<kECDataBlocks, kECParityBlocks>;
+
+/* Not a multiple of the SIMD width, to cover the tail of the kernels. */
+constexpr static size_t kBlockSize = 4096 + 37;
+
+TEST(GF256Tests, TestMulAdd) {
+  std::mt19937 gen(0);
+  std::vector<std::byte> src(kBlockSize);
+  for (auto &b : src) {
+    b = static_cast<std::byte>(gen());
+  }
+
+  for (unsigned c = 0; c < 256; c++) {
+    std::vector<std::byte> dst(kBlockSize);
+    GF256::MulAdd(dst.data(), src.data(), static_cast<uint8_t>(c), kBlockSize);
+    for (size_t i = 0; i < kBlockSize; i++) {
+      EXPECT_EQ(static_cast<uint8_t>(dst.at(i)),
+                GF256::Mul(static_cast<uint8_t>(c),
+                           static_cast<uint8_t>(src.at(i))));
+    }
+  }
+}
+
+TEST(ErasureCodeTests, TestReconstructAnyDataBlocks) {
+  std::mt19937 gen(0);
+  std::array<std::vector<std::byte>, kECStripeBlocks> stripe;
+  for (auto &blk : stripe) {
+    blk.resize(kBlockSize);
+  }
+  for (size_t i = 0; i < kECDataBlocks; i++) {
+    for (auto &b : stripe.at(i)) {
+      b = static_cast<std::byte>(gen());
+    }
+  }
+
+  std::array<const std::byte *, kECDataBlocks> data{};
+  std::array<std::byte *, kECParityBlocks> parity{};
+  for (size_t i = 0; i < kECDataBlocks; i++) {
+    data.at(i) = stripe.at(i).data();
+  }
+  for (size_t i = 0; i < kECParityBlocks; i++) {
+    parity.at(i) = stripe.at(kECDataBlocks + i).data();
+  }
+  ErasureCode::Encode(data, parity, kBlockSize);
+
+  /* Lose every pair of blocks and reconstruct each data block. */
+  for (size_t lost1 = 0; lost1 < kECStripeBlocks; lost1++) {
+    for (size_t lost2 = lost1 + 1; lost2 < kECStripeBlocks; lost2++) {
+      std::array<const std::byte *, kECStripeBlocks> blocks{};
+      for (size_t i = 0; i < kECStripeBlocks; i++) {
+        const bool is_lost = i == lost1 || i == lost2;
+        blocks.at(i) = is_lost ? nullptr : stripe.at(i).data();
+      }
+
+      for (size_t idx = 0; idx < kECDataBlocks; idx++) {
+        std::vector<std::byte> out(kBlockSize);
+        const auto ret =
+            ErasureCode::Reconstruct(blocks, idx, out.data(), kBlockSize);
+        ASSERT_TRUE(ret);
+        EXPECT_EQ(out, stripe.at(idx));
+      }
+    }
+  }
+}
+
+TEST(ErasureCodeTests, TestTooFewBlocks) {
+  std::vector<std::byte> blk(kBlockSize);
+  std::array<const std::byte *, kECStripeBlocks> blocks{};
+  for (size_t i = 0; i < kECDataBlocks - 1; i++) {
+    blocks.at(kECStripeBlocks - 1 - i) = blk.data();
+  }
+
+  std::vector<std::byte> out(kBlockSize);
+  EXPECT_FALSE(ErasureCode::Reconstruct(blocks, 0, out.data(), kBlockSize));
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/histogram.h"
+#include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
+
+using sandook::LatencyHistogram;
+
+TEST(LatencyHistogramTests, TestBucketsAreContiguous) {
+  size_t prev = 0;
+  for (uint64_t v = 1; v <= LatencyHistogram::kMaxValue; v++) {
+    const auto bucket = LatencyHistogram::GetBucket(v);
+    EXPECT_TRUE(bucket == prev || bucket == prev + 1);
+    prev = bucket;
+  }
+  EXPECT_EQ(prev, LatencyHistogram::kNumBuckets - 1);
+}
+
+TEST(LatencyHistogramTests, TestRelativeError) {
+  for (uint64_t v = 0; v <= LatencyHistogram::kMaxValue; v += 7) {
+    const auto approx =
+        LatencyHistogram::GetBucketValue(LatencyHistogram::GetBucket(v));
+    const auto err = approx > v ? approx - v : v - approx;
+    EXPECT_LE(err * LatencyHistogram::kSubBuckets, v);
+  }
+}
+
+TEST(LatencyHistogramTests, TestQuantiles) {
+  LatencyHistogram hist;
+  for (uint64_t v = 1; v <= 1000; v++) {
+    hist.Record(v);
+  }
+
+  const auto snapshot = hist.Collect();
+  EXPECT_EQ(snapshot.count(), 1000);
+  EXPECT_NEAR(snapshot.Quantile(sandook::kP50), 500, 500 / 16);
+  EXPECT_NEAR(snapshot.Quantile(sandook::kP99), 990, 990 / 16);
+}
+
+TEST(LatencyHistogramTests, TestCollectResets) {
+  LatencyHistogram hist;
+  hist.Record(10);
+  EXPECT_EQ(hist.Collect().count(), 1);
+
+  const auto empty = hist.Collect();
+  EXPECT_EQ(empty.count(), 0);
+  EXPECT_EQ(empty.Quantile(sandook::kP99), 0);
+
+  hist.Record(LatencyHistogram::kMaxValue + 1);
+  EXPECT_EQ(hist.Collect().count(), 1);
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sandook/base/mpsc_ring.h"
+#include "sandook/bindings/thread.h"
+#include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
+
+constexpr static size_t kCapacity = 8;
+
+using Ring = sandook::MPSCRing<uint64_t, kCapacity>;
+
+TEST(MPSCRingTests, TestPopInOrder) {
+  Ring ring;
+  std::array<uint64_t, kCapacity> items{};
+
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(0, ring.PopBatch(items));
+
+  /* Wrap around the ring a few times. */
+  uint64_t next = 0;
+  for (int lap = 0; lap < 3; lap++) {
+    for (size_t i = 0; i < 5; i++) {
+      EXPECT_TRUE(ring.TryPush(next + i));
+    }
+    EXPECT_FALSE(ring.empty());
+
+    EXPECT_EQ(5, ring.PopBatch(items));
+    for (size_t i = 0; i < 5; i++) {
+      EXPECT_EQ(next + i, items.at(i));
+    }
+    next += 5;
+    EXPECT_TRUE(ring.empty());
+  }
+}
+
+TEST(MPSCRingTests, TestFull) {
+  Ring ring;
+  for (uint64_t i = 0; i < kCapacity; i++) {
+    EXPECT_TRUE(ring.TryPush(i));
+  }
+  EXPECT_FALSE(ring.TryPush(kCapacity));
+
+  /* Popping some frees as many slots. */
+  std::array<uint64_t, 2> items{};
+  EXPECT_EQ(2, ring.PopBatch(items));
+  EXPECT_TRUE(ring.TryPush(kCapacity));
+  EXPECT_TRUE(ring.TryPush(kCapacity + 1));
+  EXPECT_FALSE(ring.TryPush(kCapacity + 2));
+}
+
+TEST(MPSCRingTests, TestManyProducers) {
+  constexpr static size_t kNumProducers = 4;
+  constexpr static uint64_t kNumItems = 10000;
+
+  Ring ring;
+  std::vector<sandook::rt::Thread> producers;
+  for (uint64_t p = 0; p < kNumProducers; p++) {
+    producers.emplace_back([&ring, p] {
+      for (uint64_t i = 0; i < kNumItems; i++) {
+        while (!ring.TryPush((p << 32) | i)) {
+          sandook::rt::Yield();
+        }
+      }
+    });
+  }
+
+  /* Each producer's items are popped exactly once and in order. */
+  std::array<uint64_t, kNumProducers> next{};
+  std::array<uint64_t, kCapacity> items{};
+  uint64_t n_popped = 0;
+  while (n_popped < kNumProducers * kNumItems) {
+    const auto n = ring.PopBatch(items);
+    for (size_t i = 0; i < n; i++) {
+      const auto p = items.at(i) >> 32;
+      ASSERT_LT(p, kNumProducers);
+      EXPECT_EQ(next.at(p)++, items.at(i) & 0xffffffff);
+    }
+    n_popped += n;
+    if (n == 0) {
+      sandook::rt::Yield();
+    }
+  }
+
+  for (auto &t : producers) {
+    t.Join();
+  }
+  EXPECT_TRUE(ring.empty());
+}
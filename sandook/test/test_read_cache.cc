@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sandook/base/constants.h"
+#include "sandook/disk_server/read_cache.h"
+#include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
+
+class ReadCacheTests : public ::testing::Test {
+ protected:
+  constexpr static auto kBlockSize = sandook::ReadCache::kBlockSize;
+  constexpr static uint64_t kSlotsPerShard = 10;
+  constexpr static uint64_t kCapacity =
+      kSlotsPerShard * kBlockSize * sandook::kMaxNumCores;
+
+  /* Returns the i-th LBA that maps to the first shard of the cache. */
+  static uint64_t GetLBA(uint64_t i) { return i * sandook::kMaxNumCores; }
+
+  static std::vector<std::byte> MakeBlock(uint8_t val) {
+    return std::vector<std::byte>(kBlockSize, static_cast<std::byte>(val));
+  }
+};
+
+TEST_F(ReadCacheTests, TestDisabled) {
+  sandook::ReadCache cache(0);
+  EXPECT_FALSE(cache.is_enabled());
+}
+
+TEST_F(ReadCacheTests, TestFillAndLookup) {
+  sandook::ReadCache cache(kCapacity);
+  ASSERT_TRUE(cache.is_enabled());
+
+  const auto lba = GetLBA(1);
+  const auto blk = MakeBlock(0xab);
+  auto buf = MakeBlock(0);
+
+  EXPECT_FALSE(cache.Lookup(lba, buf));
+  cache.Fill(lba, blk, cache.GetEpoch(lba));
+  EXPECT_TRUE(cache.Lookup(lba, buf));
+  EXPECT_EQ(buf, blk);
+}
+
+TEST_F(ReadCacheTests, TestWriteInvalidatesCachedBlock) {
+  sandook::ReadCache cache(kCapacity);
+
+  const auto lba = GetLBA(1);
+  auto buf = MakeBlock(0);
+
+  cache.Fill(lba, MakeBlock(0xab), cache.GetEpoch(lba));
+  ASSERT_TRUE(cache.Lookup(lba, buf));
+
+  /* Reads miss as soon as the write is issued. */
+  cache.Invalidate(lba, 1);
+  EXPECT_FALSE(cache.Lookup(lba, buf));
+}
+
+TEST_F(ReadCacheTests, TestStaleFillIsDropped) {
+  sandook::ReadCache cache(kCapacity);
+
+  const auto lba = GetLBA(1);
+  auto buf = MakeBlock(0);
+
+  /* A write is issued while the read is in-flight. */
+  const auto epoch = cache.GetEpoch(lba);
+  cache.Invalidate(lba, 1);
+  cache.Fill(lba, MakeBlock(0xab), epoch);
+  EXPECT_FALSE(cache.Lookup(lba, buf));
+}
+
+TEST_F(ReadCacheTests, TestFillDuringWriteIsDropped) {
+  sandook::ReadCache cache(kCapacity);
+
+  const auto lba = GetLBA(1);
+  auto buf = MakeBlock(0);
+
+  /* The read misses while the write is in flight, so it may see the old data
+   * on the device; the write drops the fill when it completes.
+   */
+  cache.Invalidate(lba, 1);
+  const auto epoch = cache.GetEpoch(lba);
+  cache.Invalidate(lba, 1);
+  cache.Fill(lba, MakeBlock(0xab), epoch);
+  EXPECT_FALSE(cache.Lookup(lba, buf));
+
+  /* Reads after the write completed are cached again. */
+  const auto new_blk = MakeBlock(0xcd);
+  cache.Fill(lba, new_blk, cache.GetEpoch(lba));
+  EXPECT_TRUE(cache.Lookup(lba, buf));
+  EXPECT_EQ(buf, new_blk);
+}
+
+TEST_F(ReadCacheTests, TestScanResistance) {
+  sandook::ReadCache cache(kCapacity);
+
+  const auto hot_lba = GetLBA(0);
+  const auto hot_blk = MakeBlock(0xab);
+  auto buf = MakeBlock(0);
+
+  cache.Fill(hot_lba, hot_blk, cache.GetEpoch(hot_lba));
+  EXPECT_TRUE(cache.Lookup(hot_lba, buf));
+
+  /* One-hit wonders must not evict the re-accessed block. */
+  for (uint64_t i = 1; i <= 10 * kSlotsPerShard; i++) {
+    const auto lba = GetLBA(i);
+    cache.Fill(lba, MakeBlock(0), cache.GetEpoch(lba));
+  }
+
+  EXPECT_TRUE(cache.Lookup(hot_lba, buf));
+  EXPECT_EQ(buf, hot_blk);
+  EXPECT_FALSE(cache.Lookup(GetLBA(1), buf));
+}
@@ -0,0 +1,344 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/time.h"
+#include "sandook/base/types.h"
+#include "sandook/bindings/thread.h"
+#include "sandook/bindings/timer.h"
+#include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
+#include "sandook/virtual_disk/block_resolver.h"
+#include "sandook/virtual_disk/replica_writes.h"
+
+using sandook::kECDataBlocks;
+using sandook::kECStripeBlocks;
+using sandook::ServerReplicaBlockInfoList;
+using sandook::virtual_disk::BlockResolver;
+using sandook::virtual_disk::GetRunLength;
+using sandook::virtual_disk::MakePendingReplicas;
+using sandook::virtual_disk::ReplicaWrites;
+using sandook::virtual_disk::Stripe;
+using sandook::virtual_disk::WriteAckWindow;
+
+namespace {
+
+/* Long enough for a spawned waiter to block. */
+constexpr auto kWaitDelay = sandook::Duration(100);
+
+/* Dirty blocks at block_addr of the given servers, one per replica. */
+ServerReplicaBlockInfoList MakeBlocks(const std::vector<sandook::ServerID> &ids,
+                                      sandook::ServerBlockAddr block_addr) {
+  ServerReplicaBlockInfoList blks;
+  for (const auto id : ids) {
+    blks.push_back({{.server_id = id, .block_addr = block_addr}, true});
+  }
+  return blks;
+}
+
+std::vector<sandook::ServerID> GetServerIDs(
+    const ServerReplicaBlockInfoList &blks) {
+  std::vector<sandook::ServerID> ids;
+  for (const auto &[info, _] : blks) {
+    ids.push_back(info.server_id);
+  }
+  return ids;
+}
+
+}  // namespace
+
+TEST(ReplicaWritesTests, TestAckAfterKOfN) {
+  auto pending = MakePendingReplicas(3);
+  ReplicaWrites writes(3, 2, pending);
+
+  std::atomic_bool is_acked{false};
+  sandook::rt::Thread th([&] {
+    /* The write is acknowledged with a replica still being written. */
+    EXPECT_TRUE(writes.WaitForAck());
+    is_acked = true;
+  });
+
+  EXPECT_FALSE(writes.Done(0, true));
+  sandook::rt::Sleep(kWaitDelay);
+  EXPECT_FALSE(is_acked);
+
+  EXPECT_FALSE(writes.Done(2, true));
+  th.Join();
+  EXPECT_TRUE(is_acked);
+  EXPECT_EQ(0b010U, pending->in_flight.load());
+
+  EXPECT_TRUE(writes.Done(1, true));
+  EXPECT_EQ(0U, pending->in_flight.load());
+}
+
+TEST(ReplicaWritesTests, TestFailedReplicasDoNotCount) {
+  ReplicaWrites writes(3, 2, MakePendingReplicas(3));
+
+  std::atomic_bool is_acked{false};
+  sandook::rt::Thread th([&] {
+    /* All replicas are done by the time the write is acknowledged. */
+    EXPECT_FALSE(writes.WaitForAck());
+    is_acked = true;
+  });
+
+  EXPECT_FALSE(writes.Done(0, true));
+  EXPECT_FALSE(writes.Done(1, false));
+  sandook::rt::Sleep(kWaitDelay);
+  EXPECT_FALSE(is_acked);
+
+  EXPECT_TRUE(writes.Done(2, false));
+  th.Join();
+  EXPECT_TRUE(is_acked);
+}
+
+TEST(ReplicaWritesTests, TestAllReplicasWithoutEarlyAck) {
+  ReplicaWrites writes(2, 2);
+
+  EXPECT_FALSE(writes.Done(0, true));
+  EXPECT_TRUE(writes.Done(1, true));
+  EXPECT_FALSE(writes.WaitForAck());
+}
+
+TEST(ReplicaWritesTests, TestRemapHoldsAck) {
+  ReplicaWrites writes(2, 1, MakePendingReplicas(2));
+
+  /* Only the first rejected replica rewrites the block elsewhere. */
+  EXPECT_EQ(ReplicaWrites::Retry::kRemap, writes.OnRejected());
+  EXPECT_EQ(ReplicaWrites::Retry::kAbort, writes.OnRejected());
+
+  std::atomic_bool is_acked{false};
+  sandook::rt::Thread th([&] {
+    EXPECT_TRUE(writes.WaitForAck());
+    is_acked = true;
+  });
+
+  /* Enough replicas are durable, but the block is being remapped. */
+  EXPECT_FALSE(writes.Done(1, true));
+  sandook::rt::Sleep(kWaitDelay);
+  EXPECT_FALSE(is_acked);
+
+  writes.FinishRemap(true);
+  th.Join();
+  EXPECT_TRUE(is_acked);
+
+  EXPECT_TRUE(writes.Done(0, true));
+}
+
+TEST(ReplicaWritesTests, TestLaggingReplicasDoNotRemap) {
+  ReplicaWrites writes(3, 1, MakePendingReplicas(3));
+
+  EXPECT_FALSE(writes.Done(0, true));
+  EXPECT_TRUE(writes.WaitForAck());
+
+  /* A newer write may have remapped the block since the acknowledgement. */
+  EXPECT_EQ(ReplicaWrites::Retry::kInPlace, writes.OnRejected());
+  EXPECT_EQ(ReplicaWrites::Retry::kInPlace, writes.OnRejected());
+}
+
+TEST(WriteAckWindowTests, TestWindowSize) {
+  WriteAckWindow window(2);
+
+  EXPECT_TRUE(window.TryAcquire());
+  EXPECT_TRUE(window.TryAcquire());
+  EXPECT_FALSE(window.TryAcquire());
+
+  window.Release();
+  EXPECT_TRUE(window.TryAcquire());
+
+  std::atomic_bool is_drained{false};
+  sandook::rt::Thread th([&] {
+    window.Drain();
+    is_drained = true;
+  });
+
+  window.Release();
+  sandook::rt::Sleep(kWaitDelay);
+  EXPECT_FALSE(is_drained);
+
+  window.Release();
+  th.Join();
+  EXPECT_TRUE(is_drained);
+}
+
+TEST(BlockResolverTests, TestReadsAvoidPendingReplicas) {
+  BlockResolver resolver(16);
+  auto pending = MakePendingReplicas(3);
+  ASSERT_TRUE(resolver.AddMapping(1, MakeBlocks({1, 2, 3}, 10), pending));
+
+  /* Reads may go anywhere until some replica is written. */
+  auto mapping = resolver.ResolveBlock(1);
+  ASSERT_TRUE(mapping);
+  EXPECT_EQ(std::vector<sandook::ServerID>({1, 2, 3}),
+            GetServerIDs(mapping->readable_replicas()));
+
+  pending->in_flight.fetch_and(~0b010U);
+  EXPECT_EQ(std::vector<sandook::ServerID>({2}),
+            GetServerIDs(mapping->readable_replicas()));
+
+  pending->in_flight.fetch_and(~0b100U);
+  EXPECT_EQ(std::vector<sandook::ServerID>({2, 3}),
+            GetServerIDs(mapping->readable_replicas()));
+
+  pending->in_flight.fetch_and(~0b001U);
+  EXPECT_EQ(std::vector<sandook::ServerID>({1, 2, 3}),
+            GetServerIDs(mapping->readable_replicas()));
+}
+
+TEST(BlockResolverTests, TestDiscardWaitsForPendingWrites) {
+  BlockResolver resolver(16);
+  auto pending = MakePendingReplicas(2);
+  ASSERT_TRUE(resolver.AddMapping(1, MakeBlocks({1, 2}, 10), pending));
+  EXPECT_TRUE(resolver.IsMappedTo(1, pending));
+
+  /* Overwriting the block discards its replicas, but not while the previous
+   * write is still in flight to one of them.
+   */
+  ASSERT_TRUE(resolver.AddMapping(1, MakeBlocks({3, 4}, 20)));
+  EXPECT_FALSE(resolver.IsMappedTo(1, pending));
+
+  pending->in_flight.fetch_and(~0b01U);
+  auto discarded = resolver.GetAndResetDiscardedBlocks();
+  ASSERT_FALSE(discarded);
+  EXPECT_EQ(ENOENT, discarded.error());
+
+  pending->in_flight.fetch_and(~0b10U);
+  discarded = resolver.GetAndResetDiscardedBlocks();
+  ASSERT_TRUE(discarded);
+  ASSERT_EQ(1, discarded->size());
+  EXPECT_EQ(std::vector<sandook::ServerID>({1, 2}),
+            GetServerIDs(discarded->front()));
+
+  /* Blocks are discarded once. */
+  EXPECT_FALSE(resolver.GetAndResetDiscardedBlocks());
+}
+
+TEST(BlockResolverTests, TestFailedReplicasStayUnreadable) {
+  BlockResolver resolver(16);
+  auto pending = MakePendingReplicas(3);
+  ReplicaWrites writes(3, 2, pending);
+  ASSERT_TRUE(resolver.AddMapping(1, MakeBlocks({1, 2, 3}, 10), pending));
+
+  writes.Done(0, true);
+  writes.Done(1, false);
+  writes.Done(2, true);
+  EXPECT_EQ(0U, pending->in_flight.load());
+
+  auto mapping = resolver.ResolveBlock(1);
+  ASSERT_TRUE(mapping);
+  EXPECT_EQ(std::vector<sandook::ServerID>({1, 3}),
+            GetServerIDs(mapping->readable_replicas()));
+}
+
+TEST(BlockResolverTests, TestReplaceMappingOnlyWhileMapped) {
+  BlockResolver resolver(16);
+  auto pending = MakePendingReplicas(2);
+  ASSERT_TRUE(resolver.AddMapping(1, MakeBlocks({1, 2}, 10), pending));
+  pending->in_flight.store(0);
+
+  /* The lagging write still owns the block, so its rewrite replaces it. */
+  EXPECT_TRUE(resolver.ReplaceMapping(1, pending, MakeBlocks({3, 4}, 20)));
+  auto mapping = resolver.ResolveBlock(1);
+  ASSERT_TRUE(mapping);
+  EXPECT_EQ(std::vector<sandook::ServerID>({3, 4}),
+            GetServerIDs(mapping->replicas));
+  EXPECT_FALSE(resolver.IsMappedTo(1, pending));
+
+  auto discarded = resolver.GetAndResetDiscardedBlocks();
+  ASSERT_TRUE(discarded);
+  ASSERT_EQ(1, discarded->size());
+  EXPECT_EQ(std::vector<sandook::ServerID>({1, 2}),
+            GetServerIDs(discarded->front()));
+
+  /* Once remapped, a rewrite never overwrites the newer mapping. */
+  EXPECT_FALSE(resolver.ReplaceMapping(1, pending, MakeBlocks({5, 6}, 30)));
+  mapping = resolver.ResolveBlock(1);
+  ASSERT_TRUE(mapping);
+  EXPECT_EQ(std::vector<sandook::ServerID>({3, 4}),
+            GetServerIDs(mapping->replicas));
+
+  discarded = resolver.GetAndResetDiscardedBlocks();
+  ASSERT_TRUE(discarded);
+  ASSERT_EQ(1, discarded->size());
+  EXPECT_EQ(std::vector<sandook::ServerID>({5, 6}),
+            GetServerIDs(discarded->front()));
+}
+
+TEST(BlockResolverTests, TestConcurrentRemapsDiscardOnce) {
+  constexpr static size_t kNumThreads = 4;
+  constexpr static size_t kNumRemaps = 1000;
+  constexpr static sandook::ServerID kStripeServerID = 100;
+
+  BlockResolver resolver(kECDataBlocks);
+  auto stripe = std::make_shared<Stripe>();
+  for (size_t i = 0; i < kECStripeBlocks; i++) {
+    stripe->blocks.at(i) = {.server_id = kStripeServerID,
+                            .block_addr = static_cast<uint64_t>(i)};
+  }
+  for (size_t i = 0; i < kECDataBlocks; i++) {
+    ASSERT_TRUE(resolver.AddStripeMapping(i, stripe, i));
+  }
+
+  /* Every block is remapped by all threads at once. */
+  std::vector<sandook::rt::Thread> threads;
+  for (size_t t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&resolver, t] {
+      const auto server_id = static_cast<sandook::ServerID>(t + 1);
+      for (size_t i = 0; i < kNumRemaps; i++) {
+        const auto blk_addr = i % kECDataBlocks;
+        EXPECT_TRUE(resolver.AddMapping(blk_addr, MakeBlocks({server_id}, i)));
+      }
+    });
+  }
+  for (auto &th : threads) {
+    th.Join();
+  }
+  EXPECT_EQ(0, stripe->n_mapped);
+
+  /* Each replaced mapping is discarded exactly once. */
+  auto discarded = resolver.GetAndResetDiscardedBlocks();
+  ASSERT_TRUE(discarded);
+  size_t n_stripe_blocks = 0;
+  size_t n_replica_blocks = 0;
+  for (const auto &blks : *discarded) {
+    ASSERT_EQ(1, blks.size());
+    if (blks.front().first.server_id == kStripeServerID) {
+      n_stripe_blocks++;
+    } else {
+      n_replica_blocks++;
+    }
+  }
+  EXPECT_EQ(kECStripeBlocks, n_stripe_blocks);
+  EXPECT_EQ((kNumThreads * kNumRemaps) - kECDataBlocks, n_replica_blocks);
+}
+
+TEST(WriteRunTests, TestRunAcrossReplicas) {
+  const std::vector<ServerReplicaBlockInfoList> blks{
+      MakeBlocks({1, 2}, 10), MakeBlocks({1, 2}, 11), MakeBlocks({1, 2}, 12)};
+  EXPECT_EQ(3, GetRunLength(blks));
+  EXPECT_EQ(2, GetRunLength(std::span(blks).subspan(1)));
+  EXPECT_EQ(1, GetRunLength(std::span(blks).last(1)));
+}
+
+TEST(WriteRunTests, TestRunEndsAtGap) {
+  /* The blocks of one replica do not follow each other. */
+  auto gap = MakeBlocks({1, 2}, 12);
+  gap[1].first.block_addr = 20;
+  const std::vector<ServerReplicaBlockInfoList> blks{
+      MakeBlocks({1, 2}, 10), MakeBlocks({1, 2}, 11), gap,
+      MakeBlocks({1, 2}, 13)};
+  EXPECT_EQ(2, GetRunLength(blks));
+  EXPECT_EQ(1, GetRunLength(std::span(blks).subspan(2)));
+}
+
+TEST(WriteRunTests, TestRunEndsAtOtherServer) {
+  const std::vector<ServerReplicaBlockInfoList> blks{
+      MakeBlocks({1, 2}, 10), MakeBlocks({1, 3}, 11), MakeBlocks({1, 3}, 12)};
+  EXPECT_EQ(1, GetRunLength(blks));
+  EXPECT_EQ(2, GetRunLength(std::span(blks).subspan(1)));
+}
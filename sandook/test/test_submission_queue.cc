@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+
+#include "sandook/base/io_desc.h"
+#include "sandook/base/time.h"
+#include "sandook/bindings/thread.h"
+#include "sandook/bindings/timer.h"
+#include "sandook/disk_server/submission_queue.h"
+#include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
+
+using sandook::OpType;
+using sandook::SubmissionQueue;
+
+class SubmissionQueueTests : public ::testing::Test {
+ protected:
+  /* Long enough for a spawned request to queue up, well within deadlines. */
+  constexpr static auto kQueueDelay = sandook::Duration(100);
+
+  /* Takes every slot of the device with reads. */
+  static void FillDevice(SubmissionQueue *sq) {
+    for (uint32_t i = 0; i < SubmissionQueue::kMaxDeviceDepth; i++) {
+      ASSERT_TRUE(sq->Acquire(OpType::kRead));
+    }
+  }
+};
+
+TEST_F(SubmissionQueueTests, TestWriteDepthCap) {
+  SubmissionQueue sq;
+  sq.SetWriteDepth(2);
+  ASSERT_TRUE(sq.Acquire(OpType::kWrite));
+  ASSERT_TRUE(sq.Acquire(OpType::kWrite));
+
+  /* Reads are not held back by the writes. */
+  ASSERT_TRUE(sq.Acquire(OpType::kRead));
+  sq.Release(OpType::kRead);
+
+  std::atomic_bool is_admitted{false};
+  sandook::rt::Thread th([&] {
+    EXPECT_TRUE(sq.Acquire(OpType::kWrite));
+    is_admitted = true;
+  });
+
+  sandook::rt::Sleep(kQueueDelay);
+  EXPECT_FALSE(is_admitted);
+
+  sq.Release(OpType::kWrite);
+  th.Join();
+  EXPECT_TRUE(is_admitted);
+
+  /* Raising the depth admits writes right away. */
+  sq.SetWriteDepth(3);
+  EXPECT_TRUE(sq.Acquire(OpType::kWrite));
+}
+
+TEST_F(SubmissionQueueTests, TestWriteDepthIsClamped) {
+  SubmissionQueue sq;
+  EXPECT_EQ(SubmissionQueue::kMaxDeviceDepth, sq.write_depth());
+
+  sq.SetWriteDepth(0);
+  EXPECT_EQ(SubmissionQueue::kMinWriteDepth, sq.write_depth());
+
+  sq.SetWriteDepth(SubmissionQueue::kMaxDeviceDepth + 1);
+  EXPECT_EQ(SubmissionQueue::kMaxDeviceDepth, sq.write_depth());
+}
+
+TEST_F(SubmissionQueueTests, TestWriteDepthInSectors) {
+  SubmissionQueue sq;
+  sq.SetWriteDepth(4);
+
+  /* A run longer than the depth is admitted, but only alone. */
+  ASSERT_TRUE(sq.Acquire(OpType::kWrite, 8));
+
+  std::atomic_bool is_admitted{false};
+  sandook::rt::Thread th([&] {
+    EXPECT_TRUE(sq.Acquire(OpType::kWrite, 3));
+    is_admitted = true;
+  });
+
+  sandook::rt::Sleep(kQueueDelay);
+  EXPECT_FALSE(is_admitted);
+
+  sq.Release(OpType::kWrite, 8);
+  th.Join();
+  EXPECT_TRUE(is_admitted);
+
+  /* Otherwise writes are admitted while their sectors fit the depth. */
+  EXPECT_TRUE(sq.Acquire(OpType::kWrite));
+
+  is_admitted = false;
+  sandook::rt::Thread th2([&] {
+    EXPECT_TRUE(sq.Acquire(OpType::kWrite));
+    is_admitted = true;
+  });
+
+  sandook::rt::Sleep(kQueueDelay);
+  EXPECT_FALSE(is_admitted);
+
+  sq.Release(OpType::kWrite, 3);
+  th2.Join();
+  EXPECT_TRUE(is_admitted);
+}
+
+TEST_F(SubmissionQueueTests, TestReadsAdmittedFirst) {
+  SubmissionQueue sq;
+  FillDevice(&sq);
+
+  std::atomic_int n_admitted{0};
+  int write_order = -1;
+  int read_order = -1;
+
+  sandook::rt::Thread writer([&] {
+    EXPECT_TRUE(sq.Acquire(OpType::kWrite));
+    write_order = n_admitted++;
+  });
+  sandook::rt::Sleep(kQueueDelay);
+  sandook::rt::Thread reader([&] {
+    EXPECT_TRUE(sq.Acquire(OpType::kRead));
+    read_order = n_admitted++;
+  });
+  sandook::rt::Sleep(kQueueDelay);
+
+  /* The read queued last takes the first free slot. */
+  sq.Release(OpType::kRead);
+  reader.Join();
+  EXPECT_EQ(1, n_admitted);
+
+  sq.Release(OpType::kRead);
+  writer.Join();
+  EXPECT_EQ(0, read_order);
+  EXPECT_EQ(1, write_order);
+}
+
+TEST_F(SubmissionQueueTests, TestDeadlineExpiry) {
+  SubmissionQueue sq;
+  FillDevice(&sq);
+
+  /* Nothing completes, yet the requests come back at their deadlines. */
+  auto start = sandook::Time::Now();
+  auto ret = sq.Acquire(OpType::kRead);
+  ASSERT_FALSE(ret);
+  EXPECT_EQ(EBUSY, ret.error());
+  EXPECT_GE(sandook::Duration::Since(start).Microseconds(),
+            SubmissionQueue::kReadDeadlineUs);
+
+  start = sandook::Time::Now();
+  ret = sq.Acquire(OpType::kWrite);
+  ASSERT_FALSE(ret);
+  EXPECT_EQ(EBUSY, ret.error());
+  EXPECT_GE(sandook::Duration::Since(start).Microseconds(),
+            SubmissionQueue::kWriteDeadlineUs);
+
+  /* Expired requests do not hold on to slots. */
+  sq.Release(OpType::kRead);
+  EXPECT_TRUE(sq.Acquire(OpType::kRead));
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "sandook/bindings/storage.h"
+#include "sandook/disk_server/trim_queue.h"
+#include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
+
+using sandook::TrimQueue;
+
+namespace {
+
+/* Pops up to max_ranges ranges as (lba, lba_count) pairs. */
+std::vector<std::pair<uint64_t, uint64_t>> Pop(
+    TrimQueue *q, size_t max_ranges = std::numeric_limits<size_t>::max()) {
+  std::vector<sandook::rt::StorageRange> ranges;
+  q->Pop(max_ranges, &ranges);
+
+  std::vector<std::pair<uint64_t, uint64_t>> ret;
+  for (const auto &range : ranges) {
+    ret.emplace_back(range.lba, range.lba_count);
+  }
+  return ret;
+}
+
+}  // namespace
+
+TEST(TrimQueueTests, TestOldestFirst) {
+  TrimQueue q;
+  q.Push(100, 1);
+  q.Push(10, 1);
+  q.Push(50, 1);
+  q.Push(30, 1);
+  q.Push(70, 1);
+  EXPECT_EQ(5, q.size());
+
+  const std::vector<std::pair<uint64_t, uint64_t>> first{{100, 1}, {10, 1}};
+  EXPECT_EQ(first, Pop(&q, 2));
+  const std::vector<std::pair<uint64_t, uint64_t>> rest{
+      {50, 1}, {30, 1}, {70, 1}};
+  EXPECT_EQ(rest, Pop(&q));
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(TrimQueueTests, TestMergeAdjacent) {
+  TrimQueue q;
+  q.Push(10, 2);
+  q.Push(20, 1);
+  q.Push(0, 1);
+
+  /* Extends the oldest range in its place. */
+  q.Push(12, 3);
+  EXPECT_EQ(3, q.size());
+
+  /* Bridges the two ranges into the place of the older one. */
+  q.Push(15, 5);
+  EXPECT_EQ(2, q.size());
+
+  /* Extends a range backwards. */
+  q.Push(40, 1);
+  q.Push(39, 1);
+  EXPECT_EQ(3, q.size());
+
+  const std::vector<std::pair<uint64_t, uint64_t>> expected{
+      {10, 11}, {0, 1}, {39, 2}};
+  EXPECT_EQ(expected, Pop(&q));
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(TrimQueueTests, TestMergeOverlapping) {
+  TrimQueue q;
+  q.Push(10, 4);
+  q.Push(11, 2);
+  q.Push(8, 3);
+  q.Push(5, 20);
+  EXPECT_EQ(1, q.size());
+
+  const std::vector<std::pair<uint64_t, uint64_t>> expected{{5, 20}};
+  EXPECT_EQ(expected, Pop(&q));
+}
+
+TEST(TrimQueueTests, TestSplitLongRange) {
+  constexpr static uint64_t kMaxRangeBlocks =
+      std::numeric_limits<uint32_t>::max();
+
+  TrimQueue q;
+  q.Push(0, kMaxRangeBlocks + 6);
+  q.Push(kMaxRangeBlocks + 100, 1);
+
+  /* The rest of the range is still trimmed before newer ranges. */
+  const std::vector<std::pair<uint64_t, uint64_t>> first{{0, kMaxRangeBlocks}};
+  EXPECT_EQ(first, Pop(&q, 1));
+  EXPECT_EQ(2, q.size());
+  const std::vector<std::pair<uint64_t, uint64_t>> rest{
+      {kMaxRangeBlocks, 6}, {kMaxRangeBlocks + 100, 1}};
+  EXPECT_EQ(rest, Pop(&q));
+  EXPECT_TRUE(q.empty());
+}
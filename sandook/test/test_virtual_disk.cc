@@ -19,6 +19,7 @@
 #include "sandook/base/constants.h"
 #include "sandook/base/io_desc.h"
 #include "sandook/bindings/sync.h"
+#include "sandook/config/config.h"
 #include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
 #include "sandook/test/utils/virtual_disk_utils.h"
 #include "sandook/virtual_disk/virtual_disk.h"
@@ -364,6 +365,6 @@ TEST_F(VirtualDiskGCTests, TestGCSingleBlock) {
   sandook::rt::Sleep(interval);
 
   /* GC should have occured on that sector. */
-  EXPECT_EQ(payload_size_sectors * sandook::kNumReplicas,
+  EXPECT_EQ(payload_size_sectors * sandook::Config::kVirtualDiskNumReplicas,
             vdisk_->num_gc_blocks());
 }
@@ -0,0 +1,266 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "sandook/base/constants.h"
+#include "sandook/base/error.h"
+#include "sandook/base/io_desc.h"
+#include "sandook/base/time.h"
+#include "sandook/bindings/sync.h"
+#include "sandook/bindings/timer.h"
+#include "sandook/config/config.h"
+#include "sandook/test/utils/gtest/main_wrapper.h"  // NOLINT
+#include "sandook/virtual_disk/virtual_disk_base.h"
+
+using sandook::IODesc;
+using sandook::IOResult;
+using sandook::IOStatus;
+using sandook::OpType;
+
+class VirtualDiskBaseTests : public ::testing::Test {
+ protected:
+  using WriteBatch = sandook::VirtualDiskBase::WriteBatch;
+
+  constexpr static uint64_t kNumSectors = 1024;
+  constexpr static auto kSectorSize = static_cast<size_t>(1)
+                                      << sandook::kSectorShift;
+  constexpr static auto kCompletionTimeout = sandook::Duration(1000000);
+
+  /* Records the requests that reach it instead of processing them. */
+  class FakeDisk : public sandook::VirtualDiskBase {
+   public:
+    struct Request {
+      OpType op;
+      uint64_t start_sector;
+      uint32_t num_sectors;
+      std::vector<std::byte> data;
+    };
+
+    explicit FakeDisk(bool is_failing = false)
+        : VirtualDiskBase(kNumSectors), is_failing_(is_failing) {}
+    ~FakeDisk() override = default;
+
+    /* No copying. */
+    FakeDisk(const FakeDisk &) = delete;
+    FakeDisk &operator=(const FakeDisk &) = delete;
+
+    /* No moving. */
+    FakeDisk(FakeDisk &&) = delete;
+    FakeDisk &operator=(FakeDisk &&) = delete;
+
+    /* Requests in the order they reached the disk. */
+    std::vector<Request> requests() {
+      sandook::rt::MutexGuard lock(lock_);
+      return requests_;
+    }
+
+   protected:
+    sandook::Status<int> ProcessRequest(IODesc iod) override {
+      Request req{.op = IODesc::get_op(&iod),
+                  .start_sector = iod.start_sector,
+                  .num_sectors = iod.num_sectors};
+      if (req.op == OpType::kWrite) {
+        const auto *data = reinterpret_cast<const std::byte *>(iod.addr);
+        req.data.assign(data, data + (iod.num_sectors * kSectorSize));
+      }
+
+      {
+        sandook::rt::MutexGuard lock(lock_);
+        requests_.push_back(std::move(req));
+      }
+
+      if (is_failing_) {
+        return sandook::MakeError(EIO);
+      }
+      return static_cast<int>(iod.num_sectors * kSectorSize);
+    }
+
+    [[nodiscard]] uint32_t write_shard_sectors() const override {
+      return sandook::kMaxWriteBatchSectors;
+    }
+
+   private:
+    const bool is_failing_;
+    sandook::rt::Mutex lock_;
+    std::vector<Request> requests_;
+  };
+
+  /* A write of the sectors, filled with val, that completes into result. */
+  struct Write {
+    std::vector<std::byte> data;
+    std::atomic_bool is_done{false};
+    IOResult result{};
+    IODesc iod{};
+
+    Write(uint64_t sector, uint32_t num_sectors, uint8_t val)
+        : data(num_sectors * kSectorSize, static_cast<std::byte>(val)) {
+      iod = {.op_flags = static_cast<unsigned>(OpType::kWrite),
+             .num_sectors = num_sectors,
+             .start_sector = sector,
+             .addr = reinterpret_cast<uint64_t>(data.data()),
+             .callback_args = this,
+             .callback = Complete};
+    }
+
+    static void Complete(sandook::CallbackArgs args, IOResult io_result) {
+      auto *w = static_cast<Write *>(args);
+      w->result = io_result;
+      w->is_done = true;
+    }
+  };
+
+  static void BatchWrite(sandook::VirtualDiskBase *disk, WriteBatch *batch,
+                         const Write &w) {
+    disk->BatchWrite(batch, w.iod);
+  }
+
+  static void SubmitWriteBatch(sandook::VirtualDiskBase *disk,
+                               WriteBatch *batch) {
+    disk->SubmitWriteBatch(batch);
+  }
+
+  static void ProcessWriteBatch(sandook::VirtualDiskBase *disk,
+                                std::span<const IODesc> iods) {
+    disk->ProcessWriteBatch(iods);
+  }
+
+  /* Waits until all the writes are completed. */
+  static bool WaitForWrites(std::span<const Write *const> writes) {
+    const auto start = sandook::Time::Now();
+    while (!std::ranges::all_of(writes, [](const auto *w) {
+      return w->is_done.load();
+    })) {
+      if (sandook::Duration::Since(start) > kCompletionTimeout) {
+        return false;
+      }
+      sandook::rt::Sleep(sandook::Duration(10));
+    }
+    return true;
+  }
+
+  static std::vector<std::byte> Concat(std::span<const Write *const> writes) {
+    std::vector<std::byte> data;
+    for (const auto *w : writes) {
+      data.insert(data.end(), w->data.begin(), w->data.end());
+    }
+    return data;
+  }
+};
+
+TEST_F(VirtualDiskBaseTests, TestBatchWrite) {
+  FakeDisk disk;
+  WriteBatch batch;
+
+  Write w0(10, 1, 0xa0);
+  Write w1(11, 2, 0xa1);
+  Write w2(13, 1, 0xa2);
+  BatchWrite(&disk, &batch, w0);
+  BatchWrite(&disk, &batch, w1);
+  BatchWrite(&disk, &batch, w2);
+  EXPECT_EQ(3, batch.iods.size());
+  EXPECT_EQ(4, batch.num_sectors);
+  EXPECT_EQ(14, batch.end_sector);
+
+  /* A write that does not extend the batch submits it first. */
+  Write w3(20, 1, 0xa3);
+  BatchWrite(&disk, &batch, w3);
+  ASSERT_EQ(1, batch.iods.size());
+  EXPECT_EQ(1, batch.num_sectors);
+
+  /* So does a write that would make it longer than a run. */
+  Write w4(21, sandook::kMaxWriteBatchSectors, 0xa4);
+  BatchWrite(&disk, &batch, w4);
+  ASSERT_EQ(1, batch.iods.size());
+  EXPECT_EQ(sandook::kMaxWriteBatchSectors, batch.num_sectors);
+  SubmitWriteBatch(&disk, &batch);
+  EXPECT_TRUE(batch.iods.empty());
+
+  const std::array<const Write *, 5> writes{&w0, &w1, &w2, &w3, &w4};
+  ASSERT_TRUE(WaitForWrites(writes));
+
+  auto reqs = disk.requests();
+  std::ranges::sort(reqs, {}, &FakeDisk::Request::start_sector);
+  ASSERT_EQ(3, reqs.size());
+  EXPECT_EQ(10, reqs[0].start_sector);
+  EXPECT_EQ(4, reqs[0].num_sectors);
+  EXPECT_EQ(Concat(std::span(writes).first(3)), reqs[0].data);
+  EXPECT_EQ(20, reqs[1].start_sector);
+  EXPECT_EQ(1, reqs[1].num_sectors);
+  EXPECT_EQ(21, reqs[2].start_sector);
+  EXPECT_EQ(sandook::kMaxWriteBatchSectors, reqs[2].num_sectors);
+}
+
+TEST_F(VirtualDiskBaseTests, TestProcessWriteBatch) {
+  FakeDisk disk;
+
+  Write w0(5, 1, 0xb0);
+  Write w1(6, 2, 0xb1);
+  Write w2(8, 1, 0xb2);
+  const std::array<const Write *, 3> writes{&w0, &w1, &w2};
+  const std::array<IODesc, 3> iods{w0.iod, w1.iod, w2.iod};
+  ProcessWriteBatch(&disk, iods);
+
+  /* The writes go to the disk as one, but each completes on its own. */
+  const auto reqs = disk.requests();
+  ASSERT_EQ(1, reqs.size());
+  EXPECT_EQ(5, reqs[0].start_sector);
+  EXPECT_EQ(4, reqs[0].num_sectors);
+  EXPECT_EQ(Concat(writes), reqs[0].data);
+
+  for (const auto *w : writes) {
+    EXPECT_TRUE(w->is_done);
+    EXPECT_EQ(IOStatus::kOk, w->result.status);
+    EXPECT_EQ(w->iod.num_sectors * kSectorSize, w->result.res);
+  }
+}
+
+TEST_F(VirtualDiskBaseTests, TestProcessWriteBatchFailure) {
+  FakeDisk disk(true /* is_failing */);
+
+  Write w0(5, 1, 0xc0);
+  Write w1(6, 1, 0xc1);
+  const std::array<IODesc, 2> iods{w0.iod, w1.iod};
+  ProcessWriteBatch(&disk, iods);
+
+  EXPECT_EQ(1, disk.requests().size());
+  for (const auto *w : {&w0, &w1}) {
+    EXPECT_TRUE(w->is_done);
+    EXPECT_EQ(IOStatus::kFailed, w->result.status);
+  }
+}
+
+TEST_F(VirtualDiskBaseTests, TestReadsNotHeldByWriteBatch) {
+  /* Too short a window to tell a held back read from a scheduling delay. */
+  constexpr static uint32_t kMinWindowUs = 10 * sandook::kOneMilliSecond;
+  const auto window_us = sandook::Config::kVirtualDiskWriteBatchWindowUs;
+  if (window_us < kMinWindowUs) {
+    GTEST_SKIP() << "Write batching window too short";
+  }
+
+  FakeDisk disk;
+  Write w(0, 1, 0xd0);
+  ASSERT_TRUE(disk.SubmitRequest(w.iod));
+
+  /* The read is dispatched while the write waits for others to join it. */
+  sandook::rt::Sleep(sandook::Duration(window_us / 10));
+  std::vector<std::byte> buf(kSectorSize);
+  const auto start = sandook::Time::Now();
+  const auto ret = disk.Read(100, buf);
+  ASSERT_TRUE(ret);
+  EXPECT_LT(sandook::Duration::Since(start).Microseconds(), window_us / 2);
+  EXPECT_FALSE(w.is_done);
+
+  const std::array<const Write *, 1> writes{&w};
+  ASSERT_TRUE(WaitForWrites(writes));
+  const auto reqs = disk.requests();
+  ASSERT_EQ(2, reqs.size());
+  EXPECT_EQ(OpType::kRead, reqs[0].op);
+  EXPECT_EQ(OpType::kWrite, reqs[1].op);
+}
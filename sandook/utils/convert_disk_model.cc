@@ -0,0 +1,99 @@
+// Converts the CSV model files of disks into model bundles.
+//
+// Usage: SANDOOK_CONFIG=<config.json> convert_disk_model <name>...
+//
+// For every disk name, all "<name>_<pct>*.model" files in kSSDModelsDirPath are
+// packed into "<name>.bundle" in the same directory, which DiskModel then maps
+// instead of parsing the CSV files.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sandook/config/config.h"
+#include "sandook/disk_model/disk_model.h"
+#include "sandook/disk_model/model_bundle.h"
+
+namespace {
+
+/* Whether the file is a model of the disk, i.e., "<name>_<pct>...<extension>"
+ * with a numeric field right after the separator, so that the files of a disk
+ * whose name extends this one (e.g., "ssd_b" for "ssd") are not picked up.
+ */
+bool IsModelFile(std::string_view fname, std::string_view name,
+                 std::string_view extension) {
+  if (fname.size() <= name.size() + extension.size() + 1 ||
+      !fname.starts_with(name) || !fname.ends_with(extension)) {
+    return false;
+  }
+  const auto field = fname.substr(name.size());
+  return field[0] == '_' &&
+         std::isdigit(static_cast<unsigned char>(field[1])) != 0;
+}
+
+bool Convert(const std::filesystem::path &dir, const std::string &name) {
+  const std::string extension(kModelExtension);
+
+  /* Sorted so that the same files always produce the same bundle. */
+  std::vector<std::filesystem::path> files;
+  for (const auto &file : std::filesystem::directory_iterator(dir)) {
+    const auto fname = file.path().filename().string();
+    if (IsModelFile(fname, name, extension)) {
+      files.push_back(file.path());
+    }
+  }
+  std::ranges::sort(files);
+
+  std::vector<std::string> suffixes;
+  std::vector<sandook::LoadLatency> models;
+  for (const auto &file : files) {
+    const auto fname = file.filename().string();
+    suffixes.emplace_back(fname.substr(
+        name.size(), fname.size() - name.size() - extension.size()));
+    models.emplace_back(sandook::DiskModel::LoadModel(file));
+  }
+  if (models.empty()) {
+    std::cerr << "No model files for: " << name << '\n';
+    return false;
+  }
+
+  std::vector<sandook::ModelBundle::Curve> curves;
+  for (size_t i = 0; i < models.size(); i++) {
+    curves.push_back({.suffix = suffixes[i],
+                      .loads = models[i].first,
+                      .latencies = models[i].second});
+  }
+
+  const auto fpath = dir / (name + sandook::ModelBundle::kExtension);
+  if (auto ret = sandook::ModelBundle::Write(fpath, curves); !ret) {
+    std::cerr << "Cannot write " << fpath << ": " << ret.error() << '\n';
+    return false;
+  }
+  if (auto ret = sandook::ModelBundle::Open(fpath); !ret) {
+    std::cerr << "Cannot verify " << fpath << ": " << ret.error() << '\n';
+    return false;
+  }
+
+  std::cout << "Wrote " << fpath << " (" << curves.size() << " curves)\n";
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <name>...\n";
+    return EXIT_FAILURE;
+  }
+
+  bool ok = true;
+  for (int i = 1; i < argc; i++) {
+    ok &= Convert(sandook::Config::kSSDModelsDirPath, argv[i]);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <cassert>
 #include <cerrno>
+#include <cstddef>
 #include <cstdint>
 #include <list>
 #include <memory>
+#include <span>
+#include <utility>
 
 #include "sandook/base/constants.h"
 #include "sandook/base/error.h"
@@ -13,44 +19,207 @@
 
 namespace sandook::virtual_disk {
 
+/* A stripe of an erasure-coded volume: kECDataBlocks blocks of volume data
+ * followed by kECParityBlocks parity blocks, each at a different server.
+ */
+struct Stripe {
+  std::array<ServerBlockInfo, kECStripeBlocks> blocks;
+  /* Data blocks still mapped to volume blocks; the stripe is discarded as a
+   * whole once none is, as the others are needed to reconstruct any of them.
+   */
+  std::atomic_int n_mapped{kECDataBlocks};
+};
+
+/* Replicas of a volume block (a bit per index in its list) that reads avoid:
+ * the ones whose writes are still in flight after the write was acknowledged,
+ * and the ones whose writes failed, which hold stale data.
+ */
+struct PendingReplicas {
+  explicit PendingReplicas(size_t n) : in_flight((1U << n) - 1) {}
+
+  std::atomic_uint32_t in_flight;
+  std::atomic_uint32_t failed{0};
+
+  [[nodiscard]] uint32_t unreadable() const {
+    return in_flight.load() | failed.load();
+  }
+};
+static_assert(kMaxNumReplicas <= 32, "Replicas must fit in PendingReplicas");
+
+inline std::shared_ptr<PendingReplicas> MakePendingReplicas(size_t n) {
+  return std::make_shared<PendingReplicas>(n);
+}
+
+/* Number of the leading volume blocks (at least one) whose blocks follow each
+ * other at the server of every replica, which are written with one request to
+ * each replica.
+ */
+inline size_t GetRunLength(std::span<const ServerReplicaBlockInfoList> blks) {
+  assert(!blks.empty());
+
+  const auto is_next = [](const auto &blk, const auto &next_blk) {
+    return blk.first.server_id == next_blk.first.server_id &&
+           blk.first.block_addr + 1 == next_blk.first.block_addr;
+  };
+  size_t n = 1;
+  while (n < blks.size() && std::ranges::equal(blks[n - 1], blks[n], is_next)) {
+    n++;
+  }
+  return n;
+}
+
+/* Server blocks that a volume block is mapped to: its replicas, or if it is in
+ * a stripe, the data block of the stripe that holds it (as the only replica).
+ * No replicas means that the volume block is not mapped yet.
+ */
+struct BlockMapping {
+  ServerReplicaBlockInfoList replicas;
+  std::shared_ptr<PendingReplicas> pending;
+  std::shared_ptr<Stripe> stripe;
+  size_t stripe_idx{0};
+
+  /* Replicas that reads may go to: the ones that are neither still being
+   * written nor failed to be written, or all of them if none is.
+   */
+  [[nodiscard]] ServerReplicaBlockInfoList readable_replicas() const {
+    const auto mask = (pending != nullptr) ? pending->unreadable() : 0;
+    if (mask == 0) {
+      return replicas;
+    }
+
+    ServerReplicaBlockInfoList readable;
+    for (size_t i = 0; i < replicas.size(); i++) {
+      if ((mask & (1U << i)) == 0) {
+        readable.push_back(replicas[i]);
+      }
+    }
+    return readable.empty() ? replicas : readable;
+  }
+};
+
 class BlockResolver {
  public:
   BlockResolver() = delete;
 
   explicit BlockResolver(uint64_t nsectors) : nsectors_(nsectors) {
-    blk_map_ = std::make_unique<
-        std::atomic<std::shared_ptr<ServerReplicaBlockInfoList>>[]>(nsectors);
+    blk_map_ =
+        std::make_unique<std::atomic<std::shared_ptr<BlockMapping>>[]>(
+            nsectors);
     for (uint64_t i = 0; i < nsectors; i++) {
-      blk_map_[i] = std::make_shared<ServerReplicaBlockInfoList>(
-          ServerReplicaBlockInfoList{{{{kInvalidServerID}, false}}});
+      blk_map_[i] = std::make_shared<BlockMapping>();
     }
   }
 
+  /* Maps the volume block to the replicas, of which the ones in pending (if
+   * any) are still being written.
+   */
   Status<void> AddMapping(VolumeBlockAddr blk_addr,
-                          ServerReplicaBlockInfoList srv_blk) {
+                          ServerReplicaBlockInfoList srv_blk,
+                          std::shared_ptr<PendingReplicas> pending = nullptr) {
     assert(blk_addr < nsectors_);
 
-    DiscardExistingBlocks(blk_addr);
-    blk_map_[blk_addr] = std::make_shared<ServerReplicaBlockInfoList>(srv_blk);
+    auto new_mapping = std::make_shared<BlockMapping>(
+        BlockMapping{.replicas = srv_blk, .pending = std::move(pending)});
+    DiscardBlocks(*blk_map_[blk_addr].exchange(std::move(new_mapping)));
 
     return {};
   }
 
-  [[nodiscard]] Status<ServerReplicaBlockInfoList> ResolveBlock(
+  /* Maps the volume block to the data block stripe_idx of the stripe. */
+  Status<void> AddStripeMapping(VolumeBlockAddr blk_addr,
+                                std::shared_ptr<Stripe> stripe,
+                                size_t stripe_idx) {
+    assert(blk_addr < nsectors_);
+    assert(stripe_idx < kECDataBlocks);
+
+    BlockMapping mapping{.stripe_idx = stripe_idx};
+    mapping.replicas.push_back({stripe->blocks.at(stripe_idx), true});
+    mapping.stripe = std::move(stripe);
+
+    auto new_mapping = std::make_shared<BlockMapping>(std::move(mapping));
+    DiscardBlocks(*blk_map_[blk_addr].exchange(std::move(new_mapping)));
+
+    return {};
+  }
+
+  [[nodiscard]] Status<BlockMapping> ResolveBlock(
       VolumeBlockAddr blk_addr) const {
     assert(blk_addr < nsectors_);
 
-    const auto blocks = blk_map_[blk_addr].load();
-    if (blocks->front().first.server_id == kInvalidServerID) {
+    const auto mapping = blk_map_[blk_addr].load();
+    if (mapping->replicas.empty()) {
       return MakeError(ENOENT);
     }
 
-    return *blocks;
+    return *mapping;
+  }
+
+  /* Maps the volume block to the replicas if it is still mapped to the
+   * replicas whose writes are tracked by pending (see IsMappedTo). Otherwise,
+   * a newer write has remapped it and the replicas are discarded instead.
+   * Returns true if the block was remapped.
+   */
+  bool ReplaceMapping(VolumeBlockAddr blk_addr,
+                      const std::shared_ptr<PendingReplicas> &pending,
+                      ServerReplicaBlockInfoList srv_blk) {
+    assert(blk_addr < nsectors_);
+    assert(pending != nullptr);
+
+    auto new_mapping =
+        std::make_shared<BlockMapping>(BlockMapping{.replicas = srv_blk});
+    auto mapping = blk_map_[blk_addr].load();
+    while (mapping->pending == pending) {
+      if (blk_map_[blk_addr].compare_exchange_weak(mapping, new_mapping)) {
+        DiscardBlocks(*mapping);
+        return true;
+      }
+    }
+
+    DiscardBlocks(*new_mapping);
+    return false;
+  }
+
+  /* Marks blocks that were allocated but never mapped as ready to be trimmed
+   * (e.g., after writing them failed).
+   */
+  void DiscardUnmapped(ServerReplicaBlockInfoList srv_blk) {
+    DiscardBlocks(BlockMapping{.replicas = std::move(srv_blk)});
+  }
+
+  /* Whether the volume block is mapped to the replicas whose writes are
+   * tracked by pending (i.e., no newer write has remapped it since).
+   */
+  [[nodiscard]] bool IsMappedTo(
+      VolumeBlockAddr blk_addr,
+      const std::shared_ptr<PendingReplicas> &pending) const {
+    assert(blk_addr < nsectors_);
+
+    return blk_map_[blk_addr].load()->pending == pending;
+  }
+
+  /* Marks all blocks of the stripe as ready to be trimmed. */
+  void DiscardStripe(const Stripe &stripe) {
+    rt::MutexGuard lock(discard_list_lock_);
+
+    for (const auto &block : stripe.blocks) {
+      discard_list_.push_back({{block, true}});
+    }
   }
 
   Status<std::list<ServerReplicaBlockInfoList>> GetAndResetDiscardedBlocks() {
     rt::MutexGuard lock(discard_list_lock_);
 
+    /* Blocks can be trimmed once no write to them is in flight anymore. */
+    for (auto it = pending_discard_list_.begin();
+         it != pending_discard_list_.end();) {
+      if (it->second->in_flight.load() != 0) {
+        ++it;
+        continue;
+      }
+      discard_list_.emplace_back(it->first);
+      it = pending_discard_list_.erase(it);
+    }
+
     if (discard_list_.empty()) {
       return MakeError(ENOENT);
     }
@@ -63,15 +232,32 @@ class BlockResolver {
 
  private:
   uint64_t nsectors_;
-  std::unique_ptr<std::atomic<std::shared_ptr<ServerReplicaBlockInfoList>>[]>
-      blk_map_;
+  std::unique_ptr<std::atomic<std::shared_ptr<BlockMapping>>[]> blk_map_;
 
   std::list<ServerReplicaBlockInfoList> discard_list_;
+  /* Discarded blocks that some writes are still in flight to. */
+  std::list<
+      std::pair<ServerReplicaBlockInfoList, std::shared_ptr<PendingReplicas>>>
+      pending_discard_list_;
   rt::Mutex discard_list_lock_;
 
-  void DiscardExistingBlocks(VolumeBlockAddr blk_addr) {
-    auto blocks = blk_map_[blk_addr].load();
-    auto [info, is_dirty] = blocks->front();
+  /* Discards the blocks of a mapping that was replaced; each mapping is only
+   * returned once by the exchange that replaced it, so concurrent remaps of a
+   * volume block never discard the same blocks twice.
+   */
+  void DiscardBlocks(const BlockMapping &mapping) {
+    if (mapping.stripe != nullptr) {
+      if (mapping.stripe->n_mapped.fetch_sub(1) == 1) {
+        DiscardStripe(*mapping.stripe);
+      }
+      return;
+    }
+
+    const auto &blocks = mapping.replicas;
+    if (blocks.empty()) {
+      return;
+    }
+    auto [info, is_dirty] = blocks.front();
 
     if (is_dirty && info.server_id != kInvalidServerID) {
       /* This VolumeBlockAddr was previously allocated to different set of
@@ -84,7 +270,12 @@ class BlockResolver {
        */
       rt::MutexGuard lock(discard_list_lock_);
 
-      discard_list_.emplace_back(*blocks);
+      if (mapping.pending != nullptr &&
+          mapping.pending->in_flight.load() != 0) {
+        pending_discard_list_.emplace_back(blocks, mapping.pending);
+        return;
+      }
+      discard_list_.emplace_back(blocks);
     }
   }
 };
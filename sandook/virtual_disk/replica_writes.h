@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "sandook/bindings/sync.h"
+#include "sandook/virtual_disk/block_resolver.h"
+
+namespace sandook::virtual_disk {
+
+/* Progress of the writes of the replicas of a block, which is shared with the
+ * writes that complete after the block is acknowledged. The write is
+ * acknowledged once n_ack of its n_replicas replicas are durable, or all of
+ * them are done.
+ */
+class ReplicaWrites {
+ public:
+  /* What a replica does after its server rejects the write. */
+  enum class Retry : uint8_t {
+    /* Rewrite all replicas of the block on other servers. */
+    kRemap,
+    /* Rewrite the same server block. */
+    kInPlace,
+    /* Give up; another replica rewrites the block. */
+    kAbort,
+  };
+
+  ReplicaWrites(size_t n_replicas, size_t n_ack,
+                std::shared_ptr<PendingReplicas> pending = nullptr)
+      : n_replicas_(n_replicas), n_ack_(n_ack), pending_(std::move(pending)) {}
+  ~ReplicaWrites() = default;
+
+  /* No copying. */
+  ReplicaWrites(const ReplicaWrites &) = delete;
+  ReplicaWrites &operator=(const ReplicaWrites &) = delete;
+
+  /* No moving. */
+  ReplicaWrites(ReplicaWrites &&other) = delete;
+  ReplicaWrites &operator=(ReplicaWrites &&other) = delete;
+
+  [[nodiscard]] const std::shared_ptr<PendingReplicas> &pending() const {
+    return pending_;
+  }
+
+  /* Marks the write of the replica at idx as done, which lets reads go to it
+   * unless it failed. Returns true if it was the last replica.
+   */
+  bool Done(size_t idx, bool is_durable) {
+    if (pending_ != nullptr) {
+      /* Marked failed first, so that reads never see it as written. */
+      if (!is_durable) {
+        pending_->failed.fetch_or(1U << idx);
+      }
+      pending_->in_flight.fetch_and(~(1U << idx));
+    }
+
+    rt::MutexGuard lock(lock_);
+    n_durable_ += is_durable ? 1 : 0;
+    const bool is_last = ++n_done_ == n_replicas_;
+    cv_.SignalAll();
+    return is_last;
+  }
+
+  /* Blocks until the write can be acknowledged. Returns true if some replicas
+   * are still being written.
+   */
+  bool WaitForAck() {
+    rt::MutexGuard lock(lock_);
+    cv_.Wait(lock_, [this] { return IsAckable(); });
+    is_acked_ = true;
+    return n_done_ < n_replicas_;
+  }
+
+  /* Decides how a rejected replica retries. Before the write is acknowledged,
+   * one replica rewrites the block on other servers, which remaps it, and the
+   * acknowledgement waits for that. Afterwards, newer writes may have remapped
+   * the block already, so lagging replicas retry in place (and only remap the
+   * sectors still mapped to them; see BlockResolver::ReplaceMapping).
+   */
+  Retry OnRejected() {
+    rt::MutexGuard lock(lock_);
+    if (is_acked_) {
+      return Retry::kInPlace;
+    }
+    if (is_remapping_) {
+      return Retry::kAbort;
+    }
+    is_remapping_ = true;
+    return Retry::kRemap;
+  }
+
+  /* Completes the retry started by OnRejected returning Retry::kRemap. */
+  void FinishRemap(bool is_durable) {
+    rt::MutexGuard lock(lock_);
+    is_remapping_ = false;
+    is_remapped_ = is_durable;
+    cv_.SignalAll();
+  }
+
+ private:
+  const size_t n_replicas_;
+  const size_t n_ack_;
+  /* Replicas still being written or failed, which reads avoid. */
+  const std::shared_ptr<PendingReplicas> pending_;
+
+  rt::Mutex lock_;
+  rt::CondVar cv_;
+  size_t n_durable_{0};
+  size_t n_done_{0};
+  bool is_remapping_{false};
+  bool is_remapped_{false};
+  bool is_acked_{false};
+
+  [[nodiscard]] bool IsAckable() const {
+    if (is_remapping_) {
+      return false;
+    }
+    if (n_done_ == n_replicas_) {
+      return true;
+    }
+    /* Only a write that may be acknowledged early leaves replicas behind. */
+    return n_ack_ < n_replicas_ && (is_remapped_ || n_durable_ >= n_ack_);
+  }
+};
+
+/* Admits at most a fixed number of writes whose replicas are still being
+ * written after they are acknowledged.
+ */
+class WriteAckWindow {
+ public:
+  explicit WriteAckWindow(uint32_t size) : size_(size) {}
+  ~WriteAckWindow() = default;
+
+  /* No copying. */
+  WriteAckWindow(const WriteAckWindow &) = delete;
+  WriteAckWindow &operator=(const WriteAckWindow &) = delete;
+
+  /* No moving. */
+  WriteAckWindow(WriteAckWindow &&other) = delete;
+  WriteAckWindow &operator=(WriteAckWindow &&other) = delete;
+
+  /* Takes a slot of the window, if one is left. */
+  bool TryAcquire() {
+    rt::MutexGuard lock(lock_);
+    if (n_lagging_ >= size_) {
+      return false;
+    }
+    n_lagging_++;
+    return true;
+  }
+
+  void Release() {
+    rt::MutexGuard lock(lock_);
+    n_lagging_--;
+    cv_.SignalAll();
+  }
+
+  /* Blocks until no write is lagging anymore. */
+  void Drain() {
+    rt::MutexGuard lock(lock_);
+    cv_.Wait(lock_, [this] { return n_lagging_ == 0; });
+  }
+
+ private:
+  const uint32_t size_;
+  rt::Mutex lock_;
+  rt::CondVar cv_;
+  uint32_t n_lagging_{0};
+};
+
+}  // namespace sandook::virtual_disk
@@ -1,10 +1,17 @@
 #include "sandook/virtual_disk/virtual_disk_base.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
 #include <span>
+#include <utility>
+#include <vector>
 
 #include "sandook/bindings/runtime.h"
 
@@ -15,9 +22,12 @@ extern "C" {
 #include "sandook/base/constants.h"
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
+#include "sandook/base/time.h"
 #include "sandook/bindings/log.h"
 #include "sandook/bindings/sync.h"
 #include "sandook/bindings/thread.h"
+#include "sandook/bindings/timer.h"
+#include "sandook/config/config.h"
 
 constexpr static uint32_t kMaxPerRequestConcurrency = 4;
 constexpr static uint32_t kMaxPerWriteRequestConcurrency = 1;
@@ -126,13 +136,13 @@ void VirtualDiskBase::SubmitRequestAndPark(IODesc iod,
   rt::Preempt p;
   rt::PreemptGuard g(p);
   auto cpu_id = rt::Preempt::get_cpu();
-  auto &[_, waker, reqs, lock] = work_queue_ths_.at(cpu_id);
+  auto *work_queue_th = &work_queue_ths_.at(cpu_id);
 
-  {
-    const rt::SpinGuard guard(lock);
-
-    reqs.emplace(iod);
-    waker.Wake();
+  if (likely(work_queue_th->reqs.TryPush(iod))) {
+    WakeWorker(work_queue_th);
+  } else {
+    /* The queue is full; dispatch the request right away instead. */
+    ProcessRequestAsync(iod);
   }
 
   if (requestor_waker != nullptr) {
@@ -141,31 +151,146 @@ void VirtualDiskBase::SubmitRequestAndPark(IODesc iod,
 }
 
 void VirtualDiskBase::RequestWorker(WorkQueueThread *work_queue_th) {
-  auto &[_, waker, reqs, lock] = *work_queue_th;
+  const bool is_batching = Config::kVirtualDiskWriteBatchWindowUs > 0;
+  WriteBatch batch;
+  std::array<IODesc, kWorkQueueDequeueBatch> iods{};
 
   while (true) {
-    bool stop = false;
-
-    {
-      rt::SpinGuard guard(lock);
-
-      while (!stop_ && reqs.empty()) {
-        guard.Park(waker);
+    /* Requests are dispatched without holding any lock. */
+    const auto n = work_queue_th->reqs.PopBatch(iods);
+    for (const auto &iod : std::span(iods).first(n)) {
+      if (is_batching && IODesc::get_op(&iod) == OpType::kWrite &&
+          iod.num_sectors < kMaxWriteBatchSectors) {
+        BatchWrite(&batch, iod);
+      } else {
+        ProcessRequestAsync(iod);
       }
+    }
 
-      while (!reqs.empty()) {
-        auto iod = reqs.front();
-        reqs.pop();
+    if (!batch.iods.empty() && (stop_ || Time::Now() >= batch.deadline)) {
+      SubmitWriteBatch(&batch);
+    }
 
-        ProcessRequestAsync(iod);
-      }
+    if (n > 0) {
+      continue;
+    }
 
-      stop = stop_ && reqs.empty();
+    /* Let more writes join the batch, but wake up for any request that
+     * arrives meanwhile so that reads are not held back by the window.
+     */
+    if (!batch.iods.empty()) {
+      ParkWorker(work_queue_th, batch.deadline);
+      continue;
     }
 
-    if (unlikely(stop)) {
+    if (unlikely(stop_)) {
       break;
     }
+
+    ParkWorker(work_queue_th);
+  }
+}
+
+void VirtualDiskBase::ParkWorker(WorkQueueThread *work_queue_th,
+                                 std::optional<Time> deadline) {
+  if (deadline) {
+    work_queue_th->batch_timer.StartAt(*deadline);
+  }
+
+  {
+    rt::SpinGuard guard(work_queue_th->lock);
+
+    /* Pairs with the fence in WakeWorker: either the submitter sees that this
+     * thread parks, or this thread sees the request. The timer only wakes the
+     * thread once it fires, which it has if the deadline has passed.
+     */
+    work_queue_th->is_parked.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!work_queue_th->reqs.empty() || stop_ ||
+        (deadline && Time::Now() >= *deadline)) {
+      work_queue_th->is_parked.store(false, std::memory_order_relaxed);
+    } else {
+      guard.Park(work_queue_th->waker);
+    }
+  }
+
+  if (deadline) {
+    work_queue_th->batch_timer.Cancel();
+  }
+}
+
+void VirtualDiskBase::WakeWorker(WorkQueueThread *work_queue_th) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!work_queue_th->is_parked.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  rt::SpinGuard guard(work_queue_th->lock);
+  if (work_queue_th->is_parked.exchange(false, std::memory_order_relaxed)) {
+    work_queue_th->waker.Wake();
+  }
+}
+
+void VirtualDiskBase::BatchWrite(WriteBatch *batch, IODesc iod) {
+  if (!batch->iods.empty() &&
+      (iod.start_sector != batch->end_sector ||
+       batch->num_sectors + iod.num_sectors > kMaxWriteBatchSectors)) {
+    SubmitWriteBatch(batch);
+  }
+
+  if (batch->iods.empty()) {
+    batch->num_sectors = 0;
+    batch->deadline =
+        Time::Now() + Duration(Config::kVirtualDiskWriteBatchWindowUs);
+  }
+  batch->iods.push_back(iod);
+  batch->num_sectors += iod.num_sectors;
+  batch->end_sector = iod.start_sector + iod.num_sectors;
+}
+
+void VirtualDiskBase::SubmitWriteBatch(WriteBatch *batch) {
+  if (batch->iods.size() == 1) {
+    ProcessRequestAsync(batch->iods.front());
+  } else {
+    rt::Spawn([this, iods = std::move(batch->iods)] {
+      ProcessWriteBatch(iods);
+    });
+  }
+  batch->iods.clear();
+}
+
+void VirtualDiskBase::ProcessWriteBatch(std::span<const IODesc> iods) {
+  uint32_t num_sectors = 0;
+  for (const auto &iod : iods) {
+    num_sectors += iod.num_sectors;
+  }
+
+  /* The data of the writes must be contiguous to be written as one. */
+  const auto buf =
+      std::make_unique<std::byte[]>(static_cast<size_t>(num_sectors)
+                                    << kSectorShift);
+  size_t offset = 0;
+  for (const auto &iod : iods) {
+    const auto len = static_cast<size_t>(iod.num_sectors) << kSectorShift;
+    std::memcpy(buf.get() + offset,
+                reinterpret_cast<const std::byte *>(iod.addr), len);
+    offset += len;
+  }
+
+  auto batch_iod = iods.front();
+  batch_iod.num_sectors = num_sectors;
+  batch_iod.addr = reinterpret_cast<uint64_t>(buf.get());
+  const auto ret = ProcessShardedRequests(batch_iod);
+
+  for (const auto &iod : iods) {
+    if (ret.status != IOStatus::kOk) {
+      ProcessCompletion(iod, ret);
+      continue;
+    }
+    ProcessCompletion(iod, {.status = IOStatus::kOk,
+                            .res = static_cast<int>(iod.num_sectors)
+                                   << kSectorShift});
   }
 }
 
@@ -175,6 +300,9 @@ IOResult VirtualDiskBase::ProcessShardedRequests(IODesc iod) {
   IOStatus status = IOStatus::kOk;
 
   const OpType op = IODesc::get_op(&iod);
+  if (op == OpType::kRead || op == OpType::kWrite) {
+    Throttle(&iod);
+  }
 
   const auto max_concurrency = op == OpType::kWrite
                                    ? kMaxPerWriteRequestConcurrency
@@ -185,20 +313,28 @@ IOResult VirtualDiskBase::ProcessShardedRequests(IODesc iod) {
   const uint32_t remaining = iod.num_sectors - (sectors_per_thread * nthreads);
   BUG_ON((sectors_per_thread * nthreads) + remaining != iod.num_sectors);
 
+  const uint32_t shard_sectors =
+      op == OpType::kWrite ? write_shard_sectors() : 1;
+
   std::vector<rt::Thread> threads(nthreads);
   for (uint32_t tid = 0; tid < nthreads; tid++) {
-    threads.at(tid) = [this, tid, sectors_per_thread, remaining, nthreads, iod,
-                       err_code = &err_code, res = &res] mutable {
+    threads.at(tid) = [this, tid, sectors_per_thread, remaining, nthreads,
+                       shard_sectors, iod, err_code = &err_code,
+                       res = &res] mutable {
       const uint32_t cur_thread_start_sector = tid * sectors_per_thread;
       uint32_t cur_thread_nsectors = sectors_per_thread;
       if (tid == nthreads - 1) {
         cur_thread_nsectors += remaining;
       }
 
-      for (uint32_t i = 0; i < cur_thread_nsectors; i++) {
+      for (uint32_t i = 0; i < cur_thread_nsectors;) {
         const uint64_t cur_sector_offset = cur_thread_start_sector + i;
+        const uint32_t cur_nsectors =
+            std::min(cur_thread_nsectors - i, shard_sectors);
+        i += cur_nsectors;
+
         auto iod_cur = iod;
-        iod_cur.num_sectors = 1;
+        iod_cur.num_sectors = cur_nsectors;
         iod_cur.start_sector = iod.start_sector + cur_sector_offset;
         iod_cur.addr = iod.addr + (static_cast<uint64_t>(kDeviceAlignment) *
                                    cur_sector_offset);
@@ -233,14 +369,11 @@ void VirtualDiskBase::ProcessCompletion(IODesc iod, IOResult io_result) {
 }
 
 void VirtualDiskBase::Stop() {
+  stop_ = true;
   for (uint64_t i = 0; i < rt::RuntimeMaxCores(); i++) {
-    auto &[th, waker, _, lock] = work_queue_ths_.at(i);
-    {
-      const rt::SpinGuard guard(lock);
-      stop_ = true;
-      waker.Wake();
-    }
-    th.Join();
+    auto *work_queue_th = &work_queue_ths_.at(i);
+    WakeWorker(work_queue_th);
+    work_queue_th->th.Join();
   }
 }
 
@@ -1,17 +1,25 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
-#include <queue>
+#include <functional>
+#include <optional>
 #include <span>
+#include <vector>
 
 #include "sandook/base/constants.h"
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
+#include "sandook/base/mpsc_ring.h"
+#include "sandook/base/time.h"
 #include "sandook/bindings/runtime.h"
 #include "sandook/bindings/sync.h"
 #include "sandook/bindings/thread.h"
+#include "sandook/bindings/timer.h"
+
+class VirtualDiskBaseTests;  // For testing.
 
 namespace sandook {
 
@@ -63,22 +71,57 @@ class VirtualDiskBase {
   /* Process a given IO request. */
   virtual Status<int> ProcessRequest(IODesc iod) = 0;
 
+  /* Most consecutive sectors that writes are processed in (other requests are
+   * processed per sector).
+   */
+  [[nodiscard]] virtual uint32_t write_shard_sectors() const { return 1; }
+
+  /* Called once for each read or write request before it is processed (not
+   * for its shards or any retries), e.g., to apply the QoS rate of the volume.
+   */
+  virtual void Throttle([[maybe_unused]] const IODesc *iod) {}
+
   void inc_num_gc_blocks(size_t delta) { n_disk_blocks_gc_ += delta; }
 
  private:
+  /* Writes to adjacent sectors that are held back until the batching window
+   * (see Config::kVirtualDiskWriteBatchWindowUs) of the first one passes, to
+   * be submitted as one write.
+   */
+  struct WriteBatch {
+    std::vector<IODesc> iods;
+    uint64_t end_sector{0};
+    uint32_t num_sectors{0};
+    Time deadline;
+  };
+
+  /* Requests that each work queue holds (more are dispatched right away), and
+   * that its thread dequeues at a time.
+   */
+  constexpr static size_t kWorkQueueCapacity = 256;
+  constexpr static size_t kWorkQueueDequeueBatch = 32;
+
   // TODO(zainryan): Wrap code logic into a neat class abstraction.
   struct alignas(kCacheLineSizeBytes) WorkQueueThread {
     rt::Thread th;
+    /* Requests submitted on the core of this queue. */
+    MPSCRing<IODesc, kWorkQueueCapacity> reqs;
+    /* The thread parks while there are no requests; the lock only guards
+     * parking and waking it (see ParkWorker and WakeWorker).
+     */
     rt::ThreadWaker waker;
-    std::queue<IODesc> reqs;
     rt::Spin lock;
+    std::atomic_bool is_parked{false};
+    /* Wakes the thread when the batching window of its writes passes. */
+    rt::Timer<std::function<void()>> batch_timer{
+        [this] { WakeWorker(this); }};
   };
 
   /* Thread to process IO requests. */
   std::array<WorkQueueThread, kMaxNumCores> work_queue_ths_;
 
   /* Indicate if IO threads need to stop. */
-  bool stop_{false};
+  std::atomic_bool stop_{false};
 
   /* Number of sectors in this virtual disk. */
   uint64_t n_sectors_{0};
@@ -93,7 +136,27 @@ class VirtualDiskBase {
   /* Event loop for processing IO requests. */
   void RequestWorker(WorkQueueThread *work_queue_th);
 
-  /* Shard a request into individual sectors and process them all. */
+  /* Park the thread of the queue unless there are requests (or it must stop),
+   * until a request arrives or, if given, the deadline passes.
+   */
+  void ParkWorker(WorkQueueThread *work_queue_th,
+                  std::optional<Time> deadline = std::nullopt);
+
+  /* Wake the thread of the queue if it is parked. */
+  static void WakeWorker(WorkQueueThread *work_queue_th);
+
+  /* Add a write to the batch, submitting the batch first if the write does not
+   * extend it. */
+  void BatchWrite(WriteBatch *batch, IODesc iod);
+
+  /* Submit the writes of the batch (as one write) and empty the batch. */
+  void SubmitWriteBatch(WriteBatch *batch);
+
+  /* Process adjacent writes as one write and complete each of them. */
+  void ProcessWriteBatch(std::span<const IODesc> iods);
+
+  /* Shard a request into individual sectors (or shards of sectors for
+   * writes) and process them all. */
   IOResult ProcessShardedRequests(IODesc iod);
 
   /* Invoke callback on process completion. */
@@ -107,6 +170,8 @@ class VirtualDiskBase {
 
   /* Stop all worker threads processing IO requests and completions. */
   void Stop();
+
+  friend class ::VirtualDiskBaseTests;
 };
 
 }  // namespace sandook
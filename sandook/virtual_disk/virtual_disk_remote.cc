@@ -1,5 +1,6 @@
 #include "sandook/virtual_disk/virtual_disk_remote.h"
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cassert>
@@ -15,6 +16,7 @@
 #include <vector>
 
 #include "sandook/base/constants.h"
+#include "sandook/base/erasure_code.h"
 #include "sandook/base/error.h"
 #include "sandook/base/io.h"
 #include "sandook/base/io_desc.h"
@@ -23,6 +25,7 @@
 #include "sandook/base/time.h"
 #include "sandook/base/types.h"
 #include "sandook/bindings/log.h"
+#include "sandook/bindings/sync.h"
 #include "sandook/bindings/thread.h"
 #include "sandook/bindings/timer.h"
 #include "sandook/rpc/rpc.h"
@@ -32,6 +35,9 @@
 namespace sandook {
 
 VirtualDiskRemote::~VirtualDiskRemote() {
+  /* Writes completing in the background still use this virtual disk. */
+  ack_window_.Drain();
+
   stop_updates_ = true;
   stop_gc_ = true;
 
@@ -41,6 +47,9 @@ VirtualDiskRemote::~VirtualDiskRemote() {
   LOG(INFO) << "num_write_retries: " << num_write_retries_.get_sum();
   LOG(INFO) << "num_reads_submitted: " << num_reads_submitted_.get_sum();
   LOG(INFO) << "num_writes_submitted: " << num_writes_submitted_.get_sum();
+  LOG(INFO) << "num_stripe_writes: " << num_stripe_writes_.get_sum();
+  LOG(INFO) << "num_degraded_reads: " << num_degraded_reads_.get_sum();
+  LOG(INFO) << "num_early_acks: " << num_early_acks_.get_sum();
   LOG(INFO) << "num_gc_blocks: " << num_gc_blocks();
 }
 
@@ -56,21 +65,17 @@ Status<int> VirtualDiskRemote::ProcessRequest(IODesc iod) {
         LOG(WARN) << "Block not resolved: " << iod.start_sector;
         return MakeError(ret);
       }
-      return ProcessReadOp(*ret, iod, req_id);
+      if (ret->stripe != nullptr) {
+        return ProcessStripeReadOp(*ret, iod, req_id);
+      }
+      return ProcessReadOp(ret->readable_replicas(), iod, req_id);
     } break;
 
     case OpType::kWrite: {
-      auto blks = GetBlocks(&iod, true /* set_dirty */);
-      if (!blks) {
-        LOG(WARN) << "Cannot get blocks to write";
-        return MakeError(blks);
-      }
-      const auto ret = blk_res_.AddMapping(iod.start_sector, *blks);
-      if (!ret) {
-        LOG(WARN) << "Cannot add virtual to physical block mapping";
-        return MakeError(ret);
+      if (is_erasure_coded_ && iod.num_sectors == kECDataBlocks) {
+        return ProcessStripeWriteOp(iod, req_id);
       }
-      return ProcessWriteOp(*blks, iod, req_id);
+      return ProcessReplicatedWriteOp(iod, req_id);
     } break;
 
     case OpType::kAllocate: {
@@ -99,7 +104,7 @@ Status<int> VirtualDiskRemote::ProcessRequest(IODesc iod) {
   std::unreachable();
 }
 
-Status<ServerReplicaBlockInfoList> VirtualDiskRemote::ResolveBlock(
+Status<virtual_disk::BlockMapping> VirtualDiskRemote::ResolveBlock(
     const IODesc *iod) {
   return blk_res_.ResolveBlock(iod->start_sector);
 }
@@ -134,17 +139,27 @@ Status<ServerReplicaBlockInfoList> VirtualDiskRemote::GetBlocks(
   }
 
   ServerReplicaBlockInfoList blks;
-  int i = 0;
   for (auto server : *servers) {
-    blks.at(i++) = {*(blk_caches_.at(server)->get()), set_dirty};
+    blks.push_back({*(blk_caches_.at(server)->get()), set_dirty});
   }
 
   return blks;
 }
 
+ServerReplicaBlockInfoList VirtualDiskRemote::GetBlocksAt(
+    const ServerReplicaBlockInfoList &blks, bool set_dirty) {
+  ServerReplicaBlockInfoList next_blks;
+  for (const auto &[blk_info, _] : blks) {
+    next_blks.push_back(
+        {*(blk_caches_.at(blk_info.server_id)->get()), set_dirty});
+  }
+
+  return next_blks;
+}
+
 Status<ServerReplicaBlockInfoList> VirtualDiskRemote::GetBlocksWithAffinity(
     const IODesc *iod, bool set_dirty) {
-  ServerReplicaBlockInfoList blks;
+  ServerReplicaBlockInfoList blks(num_replicas_);
   for (auto &blk : blks) {
     blk = {*(blk_caches_.at(affinity_)->get()), set_dirty};
   }
@@ -349,8 +364,12 @@ Status<int> VirtualDiskRemote::ProcessReadOp(
       iod.start_sector = blk_info.block_addr;
 
       /* Process the request from a remote storage server. */
+      const auto start_us = MicroTime();
+      sched_->StartOp(*server_id);
       auto resp = ProcessStorageOp(*srv, iod, req_id);
+      const auto latency_us = MicroTime() - start_us;
       if (!resp) {
+        sched_->AbortOp(*server_id);
         server_ids.erase(*server_id);
         num_read_retries_.inc_local();
 
@@ -361,6 +380,7 @@ Status<int> VirtualDiskRemote::ProcessReadOp(
       const auto res =
           HandleStorageOpReply(std::move(resp.value()).get_buf(), *server_id);
       if (!res) {
+        sched_->AbortOp(*server_id);
         server_ids.erase(*server_id);
 
         if (res.error() == EBUSY) {
@@ -372,6 +392,7 @@ Status<int> VirtualDiskRemote::ProcessReadOp(
         continue;
       }
 
+      sched_->CompleteOp(*server_id, latency_us);
       return *res;
     }
 
@@ -381,8 +402,10 @@ Status<int> VirtualDiskRemote::ProcessReadOp(
   std::unreachable();
 }
 
-/* Send kNumReplicas request and upon completion of all the requests, invoke the
- * callback function only once.
+/* Send a request per replica and acknowledge the write once write_ack_replicas_
+ * of them complete (or all of them are done). If fewer than all replicas are
+ * waited for, the others complete in the background (see ack_window_) while
+ * reads avoid them (see BlockMapping::readable_replicas).
  *
  * Note:
  * This function will never return a failure and keep on retrying by recursively
@@ -391,88 +414,479 @@ Status<int> VirtualDiskRemote::ProcessReadOp(
  * TODO(girfan): Must put a limit to retries.
  */
 Status<int> VirtualDiskRemote::ProcessWriteOp(
-    const ServerReplicaBlockInfoList servers, IODesc iod, uint64_t req_id) {
+    const ServerReplicaBlockInfoList servers, IODesc iod, uint64_t req_id,
+    std::shared_ptr<virtual_disk::PendingReplicas> pending) {
+  const auto n_replicas = servers.size();
+
+  const bool is_early_ack =
+      write_ack_replicas_ < n_replicas && ack_window_.TryAcquire();
+  const auto n_ack = is_early_ack ? write_ack_replicas_ : n_replicas;
+  auto writes = std::make_shared<virtual_disk::ReplicaWrites>(
+      n_replicas, n_ack, std::move(pending));
+
+  /* Copy of the data if the write is acknowledged early. */
+  std::shared_ptr<std::byte[]> payload;
+  if (is_early_ack) {
+    /* The caller may reuse its buffer once the write is acknowledged. */
+    const auto size = static_cast<size_t>(iod.num_sectors) << kSectorShift;
+    payload = std::make_shared<std::byte[]>(size);
+    std::memcpy(payload.get(), reinterpret_cast<const std::byte *>(iod.addr),
+                size);
+    iod.addr = reinterpret_cast<uint64_t>(payload.get());
+  }
+
   /* Each replica's write is performed on a separate thread. */
-  std::array<sandook::rt::Thread, kNumReplicas> threads;
+  std::array<sandook::rt::Thread, kMaxNumReplicas> threads;
+
+  for (size_t i = 0; i < n_replicas; i++) {
+    threads.at(i) = [this, i, is_early_ack, srv_info = servers.at(i).first,
+                     req_id = req_id, iod = iod, writes = writes,
+                     payload = payload] {
+      const bool is_durable =
+          ProcessReplicaWriteOp(srv_info, iod, req_id, writes.get());
+      if (writes->Done(i, is_durable) && is_early_ack) {
+        ack_window_.Release();
+      }
+    };
+  }
+
+  if (writes->WaitForAck()) {
+    num_early_acks_.inc_local();
+  }
+
+  for (auto &t : std::span(threads).first(n_replicas)) {
+    if (is_early_ack) {
+      t.Detach();
+    } else {
+      t.Join();
+    }
+  }
+
+  auto ret = static_cast<int>(iod.num_sectors) << kSectorShift;
+  return ret;
+}
+
+bool VirtualDiskRemote::ProcessReplicaWriteOp(
+    const ServerBlockInfo &srv_info, IODesc iod, uint64_t req_id,
+    virtual_disk::ReplicaWrites *writes) {
+  auto srv = GetRPCClientForServer(srv_info.server_id);
+  if (!srv) {
+    LOG(ERR) << "Unable to get server info for the request" << srv.error();
+    return false;
+  }
 
-  /* Prevent multiple threads from attempting to retry; if any one gets rejected
-   * we want to submit a single retry.
+  /* Save the volume block address; in the "good" case, this will be resolved
+   * to a server block address. However, if the request is rejected in the
+   * "bad" case, we will replace it back to the volume block address and
+   * attempt to resolve again to a different server.
    */
-  std::atomic_bool is_retrying = false;
+  const VolumeBlockAddr vdisk_start_sector = iod.start_sector;
 
-  for (auto i = 0; i < kNumReplicas; i++) {
-    const auto srv_info = servers.at(i);
+  /* Replace the volume block address with the server block address after
+   * resolving. This will be used for the storage operation sent to the storage
+   * server.
+   */
+  iod.start_sector = srv_info.block_addr;
+
+  for (int n_in_place = 0;; n_in_place++) {
+    const auto start_us = MicroTime();
+    sched_->StartOp(srv_info.server_id);
+    auto ret = ProcessStorageOp(*srv, iod, req_id);
+    const auto latency_us = MicroTime() - start_us;
+    if (!ret) {
+      sched_->AbortOp(srv_info.server_id);
+      LOG(ERR) << "Failed to process storage op: " << ret.error();
+      return false;
+    }
 
-    threads.at(i) = [this, srv_info = srv_info.first, req_id = req_id,
-                     iod = iod, is_retrying = &is_retrying] mutable {
-      auto srv = GetRPCClientForServer(srv_info.server_id);
-      if (!srv) {
-        LOG(ERR) << "Unable to get server info for the request" << srv.error();
-        return;
-      }
+    auto res = HandleStorageOpReply(std::move(ret.value()).get_buf(),
+                                    srv_info.server_id);
+    if (res) {
+      sched_->CompleteOp(srv_info.server_id, latency_us);
+      return true;
+    }
 
-      /* Save the volume block address; in the "good" case, this will be
-       * resolved to a server block address. However, if the request is rejected
-       * in the "bad" case, we will replace it back to the volume block address
-       * and attempt to resolve again to a different server.
-       */
-      const VolumeBlockAddr vdisk_start_sector = iod.start_sector;
+    sched_->AbortOp(srv_info.server_id);
 
-      /* Replace the volume block address with the server block address after
-       * resolving. This will be used for the storage operation sent to the
-       * storage server.
+    if (res.error() == EROFS) {
+      num_write_rejections_.inc_local();
+    } else {
+      num_write_retries_.inc_local();
+    }
+
+    DLOG(WARN) << "Failed to process request on: " << srv_info.server_id
+               << " (" << res.error() << ")";
+
+    const auto retry = writes->OnRejected();
+    if (retry == virtual_disk::ReplicaWrites::Retry::kAbort) {
+      /* Another retry after rejection is already in progress; abort. */
+      return false;
+    }
+    if (retry == virtual_disk::ReplicaWrites::Retry::kRemap) {
+      break;
+    }
+
+    /* The write is acknowledged and newer writes may have remapped the block
+     * since, so retry on the same server block unless no sector is mapped to
+     * this write anymore. A server that keeps rejecting it (e.g., as it stays
+     * in read mode) must not hold the write back, so give up on it after a few
+     * retries and rewrite the sectors elsewhere.
+     */
+    if (!IsWriteMapped(vdisk_start_sector, iod.num_sectors, *writes)) {
+      return false;
+    }
+    if (n_in_place == kMaxLaggingWriteRetries) {
+      iod.start_sector = vdisk_start_sector;
+      return RemapLaggingWrite(iod, req_id, *writes);
+    }
+    rt::Sleep(Duration(kServerStatsPullIntervalUs));
+  }
+
+  /* Replace the block address back to the volume block address to attempt
+   * another resolve operation.
+   */
+  iod.start_sector = vdisk_start_sector;
+
+  /* Retry on other servers, which rewrites all replicas of the block. */
+  const bool is_durable = static_cast<bool>(ProcessRequest(iod));
+  writes->FinishRemap(is_durable);
+  return is_durable;
+}
+
+bool VirtualDiskRemote::RemapLaggingWrite(
+    IODesc iod, uint64_t req_id, const virtual_disk::ReplicaWrites &writes) {
+  bool is_durable = true;
+  for (uint32_t i = 0; i < iod.num_sectors; i++) {
+    const auto sector = iod.start_sector + i;
+    if (!blk_res_.IsMappedTo(sector, writes.pending())) {
+      continue;
+    }
+
+    auto blk_iod = iod;
+    blk_iod.start_sector = sector;
+    blk_iod.num_sectors = 1;
+    blk_iod.addr = iod.addr + (static_cast<uint64_t>(kDeviceAlignment) * i);
+
+    auto blks = GetBlocks(&blk_iod, true /* set_dirty */);
+    if (!blks) {
+      LOG(WARN) << "Cannot get blocks to rewrite a lagging write";
+      is_durable = false;
+      continue;
+    }
+
+    const bool is_written = std::ranges::all_of(*blks, [&](const auto &blk) {
+      return static_cast<bool>(ProcessBlockOp(blk.first, blk_iod, req_id));
+    });
+    if (!is_written) {
+      blk_res_.DiscardUnmapped(*std::move(blks));
+      is_durable = false;
+      continue;
+    }
+
+    /* A newer write that remapped the sector meanwhile takes precedence. */
+    blk_res_.ReplaceMapping(sector, writes.pending(), *std::move(blks));
+  }
+  return is_durable;
+}
+
+bool VirtualDiskRemote::IsWriteMapped(
+    VolumeBlockAddr start_sector, uint32_t num_sectors,
+    const virtual_disk::ReplicaWrites &writes) const {
+  if (writes.pending() == nullptr) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < num_sectors; i++) {
+    if (blk_res_.IsMappedTo(start_sector + i, writes.pending())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Write the sectors to the same newly allocated replicas, up to
+ * kMaxWriteBatchSectors at a time. The sectors whose blocks are consecutive at
+ * every replica too (as the blocks cached at a core usually are) are written
+ * with one request to each replica.
+ */
+Status<int> VirtualDiskRemote::ProcessReplicatedWriteOp(IODesc iod,
+                                                        uint64_t req_id) {
+  int res = 0;
+  std::array<ServerReplicaBlockInfoList, kMaxWriteBatchSectors> blks;
+
+  for (uint32_t chunk = 0; chunk < iod.num_sectors;
+       chunk += kMaxWriteBatchSectors) {
+    auto iod_chunk = iod;
+    iod_chunk.num_sectors =
+        std::min(iod.num_sectors - chunk, kMaxWriteBatchSectors);
+    iod_chunk.start_sector = iod.start_sector + chunk;
+    iod_chunk.addr =
+        iod.addr + (static_cast<uint64_t>(kDeviceAlignment) * chunk);
+
+    auto first_blks = GetBlocks(&iod_chunk, true /* set_dirty */);
+    if (!first_blks) {
+      LOG(WARN) << "Cannot get blocks to write";
+      return MakeError(first_blks);
+    }
+    blks.at(0) = *first_blks;
+    for (uint32_t i = 1; i < iod_chunk.num_sectors; i++) {
+      blks.at(i) = GetBlocksAt(blks.at(0), true /* set_dirty */);
+    }
+
+    for (uint32_t start = 0; start < iod_chunk.num_sectors;) {
+      const auto n_run = virtual_disk::GetRunLength(
+          std::span(blks).first(iod_chunk.num_sectors).subspan(start));
+      const auto end = start + static_cast<uint32_t>(n_run);
+
+      /* Reads avoid the replicas that are still being written after the
+       * write is acknowledged.
        */
-      iod.start_sector = srv_info.block_addr;
-      auto ret = ProcessStorageOp(*srv, iod, req_id);
-      if (!ret) {
-        LOG(ERR) << "Failed to process storage op: " << ret.error();
-        return;
+      std::shared_ptr<virtual_disk::PendingReplicas> pending;
+      if (write_ack_replicas_ < blks.at(start).size()) {
+        pending = virtual_disk::MakePendingReplicas(blks.at(start).size());
+      }
+
+      for (uint32_t i = start; i < end; i++) {
+        const auto ret = blk_res_.AddMapping(iod_chunk.start_sector + i,
+                                             blks.at(i), pending);
+        if (!ret) {
+          LOG(WARN) << "Cannot add virtual to physical block mapping";
+          return MakeError(ret);
+        }
+      }
+
+      auto iod_run = iod_chunk;
+      iod_run.num_sectors = end - start;
+      iod_run.start_sector = iod_chunk.start_sector + start;
+      iod_run.addr =
+          iod_chunk.addr + (static_cast<uint64_t>(kDeviceAlignment) * start);
+      const auto written =
+          ProcessWriteOp(blks.at(start), iod_run, req_id, pending);
+      if (!written) {
+        return MakeError(written);
       }
+      res += *written;
+      start = end;
+    }
+  }
+
+  return res;
+}
+
+/* Encode the parity of the kECDataBlocks sectors and write each block of the
+ * stripe to a different server, which writes each sector once plus the parity
+ * rather than once per replica. The sectors are mapped to the stripe only
+ * once all of its blocks are written.
+ *
+ * Note:
+ * If there are too few servers for a stripe or any of its writes fails, the
+ * stripe is discarded and the sectors are replicated instead.
+ */
+Status<int> VirtualDiskRemote::ProcessStripeWriteOp(IODesc iod,
+                                                    uint64_t req_id) {
+  assert(iod.num_sectors == kECDataBlocks);
+
+  std::array<ServerID, kECStripeBlocks> server_ids{};
+  const auto selected = sched_->SelectWriteServers(vol_id_, &iod, server_ids);
+  if (!selected) {
+    return ProcessReplicatedWriteOp(iod, req_id);
+  }
+
+  auto stripe = std::make_shared<virtual_disk::Stripe>();
+  for (size_t i = 0; i < kECStripeBlocks; i++) {
+    stripe->blocks.at(i) = *(blk_caches_.at(server_ids.at(i))->get());
+  }
+
+  /* Encode the parity of the data in the request. */
+  constexpr static auto kBlockSize = static_cast<size_t>(kDeviceAlignment);
+  const auto parity_buf =
+      std::make_unique<std::byte[]>(kECParityBlocks * kBlockSize);
+  std::array<const std::byte *, kECDataBlocks> data{};
+  std::array<std::byte *, kECParityBlocks> parity{};
+  for (size_t i = 0; i < kECDataBlocks; i++) {
+    data.at(i) = reinterpret_cast<const std::byte *>(iod.addr) + i * kBlockSize;
+  }
+  for (size_t i = 0; i < kECParityBlocks; i++) {
+    parity.at(i) = parity_buf.get() + i * kBlockSize;
+  }
+  ErasureCode::Encode(data, parity, kBlockSize);
 
-      auto res = HandleStorageOpReply(std::move(ret.value()).get_buf(),
-                                      srv_info.server_id);
+  /* Each block's write is performed on a separate thread. */
+  std::array<sandook::rt::Thread, kECStripeBlocks> threads;
+  std::atomic_bool is_failed = false;
+
+  for (size_t i = 0; i < kECStripeBlocks; i++) {
+    auto blk_iod = iod;
+    blk_iod.num_sectors = 1;
+    blk_iod.addr = reinterpret_cast<uint64_t>(
+        i < kECDataBlocks ? data.at(i) : parity.at(i - kECDataBlocks));
+
+    threads.at(i) = [this, blk_info = stripe->blocks.at(i), blk_iod = blk_iod,
+                     req_id = req_id, is_failed = &is_failed] {
+      const auto res = ProcessBlockOp(blk_info, blk_iod, req_id);
       if (!res) {
         if (res.error() == EROFS) {
           num_write_rejections_.inc_local();
         } else {
           num_write_retries_.inc_local();
         }
+        is_failed->store(true);
+      }
+    };
+  }
 
-        if (is_retrying->exchange(true)) {
-          /* Another retry after rejection is already in progress; abort. */
+  for (auto &t : threads) {
+    t.Join();
+  }
+
+  if (is_failed.load()) {
+    DLOG(WARN) << "Failed to write stripe; replicating instead...";
+    blk_res_.DiscardStripe(*stripe);
+    return ProcessReplicatedWriteOp(iod, req_id);
+  }
+
+  for (size_t i = 0; i < kECDataBlocks; i++) {
+    const auto ret =
+        blk_res_.AddStripeMapping(iod.start_sector + i, stripe, i);
+    if (!ret) {
+      LOG(WARN) << "Cannot add virtual to physical block mapping";
+      return MakeError(ret);
+    }
+  }
+  num_stripe_writes_.inc_local();
+
+  return static_cast<int>(iod.num_sectors) << kSectorShift;
+}
+
+/* Read the sector from its data block if the server of the block can take the
+ * read, or otherwise (or if the read fails) reconstruct it from the rest of
+ * the stripe, which reads around a failed, congested or write-mode server.
+ */
+Status<int> VirtualDiskRemote::ProcessStripeReadOp(
+    const virtual_disk::BlockMapping &mapping, IODesc iod, uint64_t req_id) {
+  const auto &blk_info = mapping.stripe->blocks.at(mapping.stripe_idx);
+
+  const ServerSet server_ids{blk_info.server_id};
+  if (sched_->SelectReadServer(&server_ids, vol_id_, &iod)) {
+    const auto res = ProcessBlockOp(blk_info, iod, req_id);
+    if (res) {
+      return *res;
+    }
+
+    if (res.error() == EBUSY) {
+      num_read_rejections_.inc_local();
+    } else {
+      num_read_retries_.inc_local();
+    }
+  }
+
+  num_degraded_reads_.inc_local();
+  return ProcessDegradedReadOp(mapping, iod, req_id);
+}
+
+/* Read kECDataBlocks other blocks of the stripe (in parallel, the data blocks
+ * first) and decode the sector from them. The blocks whose reads fail are
+ * replaced with the remaining ones.
+ *
+ * Note:
+ * If too few blocks can be read, this waits for updated server stats and
+ * retries by recursively calling ProcessRequest.
+ */
+Status<int> VirtualDiskRemote::ProcessDegradedReadOp(
+    const virtual_disk::BlockMapping &mapping, IODesc iod, uint64_t req_id) {
+  constexpr static auto kBlockSize = static_cast<size_t>(kDeviceAlignment);
+  const auto &stripe = *mapping.stripe;
+  const auto bufs = std::make_unique<std::byte[]>(kECStripeBlocks * kBlockSize);
+
+  /* Blocks read so far (nullptr for the ones not read). */
+  std::array<const std::byte *, kECStripeBlocks> blocks{};
+  size_t n_read = 0;
+  size_t next = 0;
+
+  while (n_read < kECDataBlocks) {
+    std::array<sandook::rt::Thread, kECDataBlocks> threads;
+    size_t n_threads = 0;
+
+    for (; n_threads < kECDataBlocks - n_read && next < kECStripeBlocks;
+         next++) {
+      if (next == mapping.stripe_idx) {
+        continue;
+      }
+
+      auto *buf = bufs.get() + next * kBlockSize;
+      auto blk_iod = iod;
+      blk_iod.addr = reinterpret_cast<uint64_t>(buf);
+
+      threads.at(n_threads++) = [this, blk_info = stripe.blocks.at(next),
+                                 blk_iod = blk_iod, req_id = req_id, buf = buf,
+                                 blk = &blocks.at(next)] {
+        const auto res = ProcessBlockOp(blk_info, blk_iod, req_id);
+        if (!res) {
+          if (res.error() == EBUSY) {
+            num_read_rejections_.inc_local();
+          } else {
+            num_read_retries_.inc_local();
+          }
           return;
         }
+        *blk = buf;
+      };
+    }
 
-        DLOG(WARN) << "Failed to process request on: " << srv_info.server_id
-                   << " (" << res.error() << ")";
+    if (n_threads == 0) {
+      DLOG(WARN) << "Failed to read enough blocks of stripe; retrying...";
+      rt::Sleep(Duration(kServerStatsPullIntervalUs));
+      return ProcessRequest(iod);
+    }
 
-        /* Replace the block address back to the volume block address to
-         * attempt another resolve operation.
-         */
-        iod.start_sector = vdisk_start_sector;
+    for (size_t i = 0; i < n_threads; i++) {
+      threads.at(i).Join();
+    }
 
-        // TODO(girfan): Need this?
-        /* The server is in a different mode than what was known to the client
-         * or is congested; wait for updated stats to arrive from the
-         * controller and try again with a more updated view of the servers.
-         */
-        // rt::Sleep(Duration(kServerStatsPullIntervalUs));
+    n_read = static_cast<size_t>(std::ranges::count_if(
+        blocks, [](const std::byte *blk) { return blk != nullptr; }));
+  }
 
-        /* Retry on another server. Also, the control flow should not reach
-         * the callback as the request is not completed.
-         */
-        [[maybe_unused]] const auto _ = ProcessRequest(iod);
-        return;
-      }
-    };
+  const auto ret = ErasureCode::Reconstruct(
+      blocks, mapping.stripe_idx, reinterpret_cast<std::byte *>(iod.addr),
+      kBlockSize);
+  if (!ret) {
+    LOG(ERR) << "Cannot reconstruct block of stripe";
+    return MakeError(ret);
   }
 
-  for (auto &t : threads) {
-    t.Join();
+  return static_cast<int>(iod.num_sectors) << kSectorShift;
+}
+
+Status<int> VirtualDiskRemote::ProcessBlockOp(const ServerBlockInfo &blk_info,
+                                              IODesc iod, uint64_t req_id) {
+  const auto srv = GetRPCClientForServer(blk_info.server_id);
+  if (!srv) {
+    LOG(ERR) << "Failed to get RPC client";
+    return MakeError(srv);
   }
 
-  auto ret = static_cast<int>(iod.num_sectors) << kSectorShift;
-  return ret;
+  /* Replace the volume block address with the server block address. */
+  iod.start_sector = blk_info.block_addr;
+
+  const auto start_us = MicroTime();
+  sched_->StartOp(blk_info.server_id);
+  auto resp = ProcessStorageOp(*srv, iod, req_id);
+  const auto latency_us = MicroTime() - start_us;
+  if (!resp) {
+    sched_->AbortOp(blk_info.server_id);
+    return MakeError(resp);
+  }
+
+  const auto res = HandleStorageOpReply(std::move(resp.value()).get_buf(),
+                                        blk_info.server_id);
+  if (!res) {
+    sched_->AbortOp(blk_info.server_id);
+    return MakeError(res);
+  }
+
+  sched_->CompleteOp(blk_info.server_id, latency_us);
+  return *res;
 }
 
 VolumeID VirtualDiskRemote::Register() {
@@ -482,7 +896,9 @@ VolumeID VirtualDiskRemote::Register() {
   }
   utils::SetControllerTimeCalibration(*delta_us);
 
-  auto msg = CreateRegisterVolumeMsg(ip_, port_, num_sectors());
+  auto msg = CreateRegisterVolumeMsg(ip_, port_, num_sectors(),
+                                     Config::kVirtualDiskQoS, num_replicas_,
+                                     is_erasure_coded_);
   const auto payload_size = GetMsgSize(msg.get());
 
   auto resp = ctrl_->Call(writable_span(msg.get(), payload_size));
@@ -509,8 +925,8 @@ Status<VolumeID> VirtualDiskRemote::HandleRegisterVolumeReply(
 
   const auto sched_type = msg->sched_type;
   const auto vol_id = msg->vol_id;
-  sched_ =
-      std::make_unique<schedulers::data_plane::Scheduler>(sched_type, vol_id);
+  sched_ = std::make_unique<schedulers::data_plane::Scheduler>(
+      sched_type, vol_id, num_replicas_, is_erasure_coded_);
 
   for (int i = 0; i < msg->num_servers; i++) {
     const auto &srv = msg->servers.at(i);
@@ -523,7 +939,7 @@ Status<VolumeID> VirtualDiskRemote::HandleRegisterVolumeReply(
                << srv.port;
       throw std::runtime_error("Cannot add RPC client for server");
     }
-    const auto add = sched_->AddServer(srv.id);
+    const auto add = sched_->AddServer(srv.id, srv.location);
     if (!add) {
       LOG(ERR) << "Cannot add server to scheduler: " << srv.id;
       throw std::runtime_error("Cannot add server to scheduler");
@@ -536,7 +952,8 @@ Status<VolumeID> VirtualDiskRemote::HandleRegisterVolumeReply(
 }
 
 void VirtualDiskRemote::UpdateServerStats() {
-  auto msg = CreateGetServerStatsMsg(vol_id_);
+  auto msg = CreateGetServerStatsMsg(vol_id_, sched_->GetQoSDemand(),
+                                     sched_->GetServerOps());
   const auto payload_size = GetMsgSize(msg.get());
   auto resp = ctrl_->Call(writable_span(msg.get(), payload_size));
   if (!resp) {
@@ -573,12 +990,17 @@ Status<void> VirtualDiskRemote::HandleGetServerStatsReply(
   const ServerStatsList servers(msg->servers.cbegin(),
                                 msg->servers.cbegin() + msg->num_servers);
 
+  /* Set before the stats, which capture the rate limits for selections. */
+  sched_->SetCoordinatedRateLimits(msg->cc_rate_limits);
+
   const auto ret = sched_->SetServerStats(servers);
   if (!ret) {
     LOG(ERR) << "Cannot set servers";
     return MakeError(ret);
   }
 
+  sched_->SetQoSRate(msg->qos_rate);
+
   return {};
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -14,17 +15,20 @@
 #include "sandook/base/constants.h"
 #include "sandook/base/core_local_cache.h"
 #include "sandook/base/counter.h"
+#include "sandook/base/erasure_code.h"
 #include "sandook/base/error.h"
 #include "sandook/base/io_desc.h"
 #include "sandook/base/server_stats.h"
 #include "sandook/base/types.h"
 #include "sandook/bindings/log.h"
 #include "sandook/bindings/runtime.h"
+#include "sandook/bindings/sync.h"
 #include "sandook/bindings/thread.h"
 #include "sandook/config/config.h"
 #include "sandook/rpc/rpc.h"
 #include "sandook/scheduler/data_plane/scheduler.h"
 #include "sandook/virtual_disk/block_resolver.h"
+#include "sandook/virtual_disk/replica_writes.h"
 #include "sandook/virtual_disk/virtual_disk_base.h"
 
 /* Handle to each remote server.
@@ -39,6 +43,14 @@ namespace sandook {
 
 constexpr auto kPerCoreCachedBlocks = kAllocationBatch;
 
+/* Times that a replica still being written after its write was acknowledged
+ * retries in place when its server rejects it, before it rewrites the sectors
+ * on other servers instead.
+ */
+constexpr auto kMaxLaggingWriteRetries = 3;
+
+using ErasureCode = ReedSolomon<kECDataBlocks, kECParityBlocks>;
+
 class VirtualDiskRemote : public VirtualDiskBase {
  public:
   explicit VirtualDiskRemote(uint64_t n_sectors)
@@ -48,6 +60,12 @@ class VirtualDiskRemote : public VirtualDiskBase {
         ip_(Config::kVirtualDiskIP),
         port_(Config::kVirtualDiskPort),
         affinity_(Config::kVirtualDiskServerAffinity),
+        is_erasure_coded_(Config::kVirtualDiskErasureCoding &&
+                          affinity_ == kInvalidServerID),
+        num_replicas_(Config::kVirtualDiskNumReplicas),
+        write_ack_replicas_(Config::kVirtualDiskWriteAckReplicas == 0
+                                ? num_replicas_
+                                : Config::kVirtualDiskWriteAckReplicas),
         vol_id_(Register()),
         blk_res_(n_sectors),
         th_ctrl_stats_([this] { ServerStatsUpdater(); }),
@@ -85,6 +103,15 @@ class VirtualDiskRemote : public VirtualDiskBase {
  protected:
   Status<int> ProcessRequest(IODesc iod) override;
 
+  void Throttle(const IODesc *iod) override { sched_->Throttle(iod); }
+
+  /* Writes of erasure-coded volumes are processed a stripe at a time, and
+   * other writes in runs written with one request to each replica.
+   */
+  [[nodiscard]] uint32_t write_shard_sectors() const override {
+    return is_erasure_coded_ ? kECDataBlocks : kMaxWriteBatchSectors;
+  }
+
  private:
   /* Scheduler for selecting which server to route requests to. */
   std::unique_ptr<schedulers::data_plane::Scheduler> sched_;
@@ -108,6 +135,21 @@ class VirtualDiskRemote : public VirtualDiskBase {
    */
   ServerID affinity_{kInvalidServerID};
 
+  /* Whether writes of whole stripes are erasure-coded (see ErasureCode) rather
+   * than replicated. Not applicable when affinity_ is set.
+   */
+  bool is_erasure_coded_{false};
+
+  /* Replication factor of this volume, i.e., the servers each (non-striped)
+   * block is written to. Sent to the controller upon registration.
+   */
+  uint32_t num_replicas_{kDefaultNumReplicas};
+
+  /* Replicas that a write waits for before it is acknowledged, of the
+   * num_replicas_ it is written to (see ProcessWriteOp).
+   */
+  uint32_t write_ack_replicas_{kDefaultNumReplicas};
+
   /* Volume ID assigned by the controller upon registration. */
   VolumeID vol_id_{0};
 
@@ -136,16 +178,36 @@ class VirtualDiskRemote : public VirtualDiskBase {
   ThreadSafeCounter num_reads_submitted_;
   ThreadSafeCounter num_writes_submitted_;
 
+  /* Track the number of erasure-coded stripes and of reads reconstructed from
+   * them.
+   */
+  ThreadSafeCounter num_stripe_writes_;
+  ThreadSafeCounter num_degraded_reads_;
+
+  /* Track the number of writes acknowledged before all of their replicas
+   * completed.
+   */
+  ThreadSafeCounter num_early_acks_;
+
+  /* Writes that may be acknowledged before all of their replicas complete. */
+  virtual_disk::WriteAckWindow ack_window_{Config::kVirtualDiskWriteAckWindow};
+
   /* Register this virtual disk with the controller. */
   VolumeID Register();
 
   /* Process the request by attempting to resolve the block from local cache. */
-  Status<ServerReplicaBlockInfoList> ResolveBlock(const IODesc *iod);
+  Status<virtual_disk::BlockMapping> ResolveBlock(const IODesc *iod);
 
   /* Get allocated blocks. */
   Status<ServerReplicaBlockInfoList> GetBlocks(const IODesc *iod,
                                                bool set_dirty);
 
+  /* Get allocated blocks at the same servers as the given blocks (e.g., for
+   * the next sector of a write).
+   */
+  ServerReplicaBlockInfoList GetBlocksAt(const ServerReplicaBlockInfoList &blks,
+                                         bool set_dirty);
+
   /* Get allocated blocks at the disk server with affinity to this virtual disk.
    * Only applicable when affinity_ is set.
    */
@@ -164,7 +226,44 @@ class VirtualDiskRemote : public VirtualDiskBase {
                             uint64_t req_id);
 
   /* Submit write requests to multiple servers */
-  Status<int> ProcessWriteOp(ServerReplicaBlockInfoList servers, IODesc iod,
+  Status<int> ProcessWriteOp(
+      ServerReplicaBlockInfoList servers, IODesc iod, uint64_t req_id,
+      std::shared_ptr<virtual_disk::PendingReplicas> pending = nullptr);
+
+  /* Write a replica to its server block, or retry the write if the server
+   * rejects it. Returns true if the data is durable.
+   */
+  bool ProcessReplicaWriteOp(const ServerBlockInfo &srv_info, IODesc iod,
+                             uint64_t req_id,
+                             virtual_disk::ReplicaWrites *writes);
+
+  /* Rewrite the sectors of a lagging replica's write that are still mapped to
+   * the replicas of the write on newly allocated replicas. Returns true if all
+   * of them are durable (or were remapped by newer writes meanwhile).
+   */
+  bool RemapLaggingWrite(IODesc iod, uint64_t req_id,
+                         const virtual_disk::ReplicaWrites &writes);
+
+  /* Whether any of the sectors is still mapped to the replicas of the write. */
+  bool IsWriteMapped(VolumeBlockAddr start_sector, uint32_t num_sectors,
+                     const virtual_disk::ReplicaWrites &writes) const;
+
+  /* Write the sectors of the request to newly allocated replicas. */
+  Status<int> ProcessReplicatedWriteOp(IODesc iod, uint64_t req_id);
+
+  /* Write the sectors of the request as the data blocks of a new stripe. */
+  Status<int> ProcessStripeWriteOp(IODesc iod, uint64_t req_id);
+
+  /* Read a sector from its block in a stripe. */
+  Status<int> ProcessStripeReadOp(const virtual_disk::BlockMapping &mapping,
+                                  IODesc iod, uint64_t req_id);
+
+  /* Read a sector by reconstructing it from other blocks of its stripe. */
+  Status<int> ProcessDegradedReadOp(const virtual_disk::BlockMapping &mapping,
+                                    IODesc iod, uint64_t req_id);
+
+  /* Submit a single-sector request for the given server block. */
+  Status<int> ProcessBlockOp(const ServerBlockInfo &blk_info, IODesc iod,
                              uint64_t req_id);
 
   /* Update server stats periodically. */